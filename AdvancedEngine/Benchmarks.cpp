@@ -0,0 +1,816 @@
+#include "Benchmarks.h"
+#include "PhysicsEngine.h"
+#include "DensityFieldShape.h"
+#include "TerrainGenerator.h"
+#include "MarchingCubesGenerator.h"
+#include "Settings.h"
+#include "ChunkCuller.h"
+#include "Camera.h"
+#include "Engine.h"
+#include "Profiler.h"
+#include "WorldStorage.h"
+#include "TerrainEdit.h"
+#include "VoxelOctree.h"
+#include "VoxelQueries.h"
+#include "WorkerPool.h"
+#include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <Jolt/Physics/Collision/Shape/CapsuleShape.h>
+#include <Jolt/Physics/Collision/CollisionDispatch.h>
+#include <Jolt/Physics/Collision/CollisionCollectorImpl.h>
+#include <Jolt/Physics/Collision/CollideShape.h>
+#include <Jolt/Physics/Collision/RayCast.h>
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "stb_image_write.h"
+
+static bool parseFrameBenchmarkOptions(const std::vector<std::string>& options, FrameBenchmarkConfig& config) {
+	for (size_t i = 0; i < options.size(); i++) {
+		const std::string& option = options[i];
+		const bool hasValue = i + 1 < options.size();
+
+		if (option == "--settle") {
+			config.waitForStreaming = true;
+		}
+		else if (option == "--frames" && hasValue) {
+			config.frames = std::stoul(options[++i]);
+		}
+		else if (option == "--size" && hasValue) {
+			if (std::sscanf(options[++i].c_str(), "%ux%u", &config.width, &config.height) != 2) {
+				std::cerr << "Expected --size <width>x<height>" << std::endl;
+				return false;
+			}
+		}
+		else if (option == "--json" && hasValue) {
+			config.jsonPath = options[++i];
+		}
+		else if (option == "--dump" && hasValue) {
+			config.dumpDirectory = options[++i];
+		}
+		else if (option == "--trace" && hasValue) {
+			config.tracePath = options[++i];
+		}
+		else {
+			std::cerr << "Unknown option: " << option << std::endl;
+			return false;
+		}
+	}
+	return config.frames > 0 && config.width > 0 && config.height > 0;
+}
+
+bool runBenchmark(const std::string& name, const std::vector<std::string>& options) {
+	if (name == "collision") {
+		benchmarkCollisionShapes();
+		return true;
+	}
+	if (name == "culling") {
+		benchmarkChunkCulling();
+		return true;
+	}
+	if (name == "storage") {
+		benchmarkWorldStorage();
+		return true;
+	}
+	if (name == "octree") {
+		benchmarkVoxelOctree();
+		return true;
+	}
+	if (name == "raycast") {
+		benchmarkVoxelQueries();
+		return true;
+	}
+	if (name == "frames") {
+		FrameBenchmarkConfig config;
+		if (!parseFrameBenchmarkOptions(options, config)) return false;
+		benchmarkFrames(config);
+		return true;
+	}
+
+	std::cerr << "Unknown benchmark: " << name << std::endl;
+	return false;
+}
+
+struct CollisionBenchmarkResult {
+	double cookMs = 0.0;
+	size_t memoryBytes = 0;
+	double rayMs = 0.0;
+	unsigned int rayHits = 0;
+	double collideMs = 0.0;
+	unsigned int contacts = 0;
+};
+
+static void printCollisionResult(const char* name, const CollisionBenchmarkResult& result, const unsigned int numRays, const unsigned int numCollides) {
+	std::cout << name
+		<< ": cook " << result.cookMs << " ms"
+		<< ", memory " << result.memoryBytes / 1024 << " KB"
+		<< ", rays " << result.rayMs * 1000000.0 / numRays << " ns/ray (" << result.rayHits << " hits)"
+		<< ", capsule " << result.collideMs * 1000000.0 / numCollides << " ns/query (" << result.contacts << " contacts)"
+		<< std::endl;
+}
+
+void benchmarkCollisionShapes() {
+	constexpr unsigned int MAX_CHUNKS = 32;
+	constexpr unsigned int RAYS_PER_CHUNK = 2000;
+	constexpr unsigned int COLLIDES_PER_CHUNK = 200;
+
+	PhysicsEngine* physicsEngine = new PhysicsEngine();
+	TerrainGenerator terrainGenerator;
+	MarchingCubeGenerator meshGenerator(0.5f);
+
+	// Collect chunks that actually contain terrain surface
+	std::vector<std::shared_ptr<const VoxelBuffer>> chunkDensities;
+	std::vector<JPH::VertexList> chunkVertices;
+
+	for (int x = -4; x <= 4 && chunkDensities.size() < MAX_CHUNKS; x++) {
+		for (int z = -4; z <= 4 && chunkDensities.size() < MAX_CHUNKS; z++) {
+			for (int y = 0; y < 9 && chunkDensities.size() < MAX_CHUNKS; y++) {
+				GeneratedTerrainResult terrain = terrainGenerator.generateTerrain(x, y, z);
+				const std::vector<float> vertices = meshGenerator.generateMesh(terrain.densities, terrain.materials, 1);
+				if (vertices.empty()) continue;
+
+				JPH::VertexList positions;
+				positions.reserve(vertices.size() / N_TERRAIN_VA);
+				for (size_t i = 0; i < vertices.size(); i += N_TERRAIN_VA) {
+					positions.push_back(JPH::Float3(vertices[i], vertices[i + 1], vertices[i + 2]));
+				}
+
+				chunkDensities.push_back(std::make_shared<const VoxelBuffer>(VoxelBuffer{ std::move(terrain.densities), std::move(terrain.materials) }));
+				chunkVertices.push_back(positions);
+			}
+		}
+	}
+
+	std::cout << "Benchmarking collision shapes over " << chunkDensities.size() << " surface chunks" << std::endl;
+
+	CollisionBenchmarkResult meshResult;
+	CollisionBenchmarkResult densityResult;
+
+	JPH::RefConst<JPH::Shape> capsule = new JPH::CapsuleShape(0.9f, 0.5f);
+	JPH::CollideShapeSettings collideSettings;
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> coordinate(0.0f, static_cast<float>(CHUNK_SIZE));
+	std::uniform_real_distribution<float> slope(-0.5f, 0.5f);
+
+	for (size_t i = 0; i < chunkDensities.size(); i++) {
+		// Cooking
+		auto start = std::chrono::high_resolution_clock::now();
+
+		const JPH::VertexList& vertices = chunkVertices[i];
+		JPH::IndexedTriangleList triangles;
+		triangles.reserve(vertices.size() / 3);
+		for (JPH::uint32 v = 0; v + 2 < vertices.size(); v += 3) {
+			triangles.push_back(JPH::IndexedTriangle(v, v + 1, v + 2));
+		}
+		JPH::MeshShapeSettings meshSettings(vertices, triangles);
+		JPH::ShapeSettings::ShapeResult shapeResult = meshSettings.Create();
+		if (!shapeResult.IsValid()) continue;
+		JPH::RefConst<JPH::Shape> meshShape = shapeResult.Get();
+
+		auto end = std::chrono::high_resolution_clock::now();
+		meshResult.cookMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		JPH::RefConst<JPH::Shape> densityShape = new DensityFieldShape(chunkDensities[i], 0.5f);
+		end = std::chrono::high_resolution_clock::now();
+		densityResult.cookMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+		// The mesh path also keeps the triangle positions on the chunk to be able to cook.
+		// The density shape reads the chunk's grid, which it keeps alive, so the grid counts too
+		meshResult.memoryBytes += meshShape->GetStats().mSizeBytes + vertices.size() * sizeof(JPH::Float3);
+		densityResult.memoryBytes += densityShape->GetStats().mSizeBytes + chunkDensities[i]->densities.size() * sizeof(float);
+
+		// Same rays and capsule positions for both shapes
+		std::vector<JPH::RayCast> rays;
+		for (unsigned int r = 0; r < RAYS_PER_CHUNK; r++) {
+			rays.push_back({ JPH::Vec3(coordinate(random), CHUNK_SIZE + 1.0f, coordinate(random)), JPH::Vec3(slope(random), -(CHUNK_SIZE + 2.0f), slope(random)) });
+		}
+		std::vector<JPH::Vec3> capsulePositions;
+		for (unsigned int c = 0; c < COLLIDES_PER_CHUNK; c++) {
+			capsulePositions.push_back(JPH::Vec3(coordinate(random), coordinate(random), coordinate(random)));
+		}
+
+		auto runQueries = [&](const JPH::Shape* shape, CollisionBenchmarkResult& result) {
+			auto queryStart = std::chrono::high_resolution_clock::now();
+			for (const JPH::RayCast& ray : rays) {
+				JPH::RayCastResult hit;
+				if (shape->CastRay(ray, JPH::SubShapeIDCreator(), hit)) result.rayHits++;
+			}
+			auto queryEnd = std::chrono::high_resolution_clock::now();
+			result.rayMs += std::chrono::duration<double, std::milli>(queryEnd - queryStart).count();
+
+			queryStart = std::chrono::high_resolution_clock::now();
+			for (const JPH::Vec3& position : capsulePositions) {
+				JPH::AllHitCollisionCollector<JPH::CollideShapeCollector> collector;
+				JPH::CollisionDispatch::sCollideShapeVsShape(capsule, shape, JPH::Vec3::sReplicate(1.0f), JPH::Vec3::sReplicate(1.0f), JPH::Mat44::sTranslation(position), JPH::Mat44::sIdentity(), JPH::SubShapeIDCreator(), JPH::SubShapeIDCreator(), collideSettings, collector);
+				result.contacts += collector.mHits.size();
+			}
+			queryEnd = std::chrono::high_resolution_clock::now();
+			result.collideMs += std::chrono::duration<double, std::milli>(queryEnd - queryStart).count();
+		};
+
+		runQueries(meshShape, meshResult);
+		runQueries(densityShape, densityResult);
+	}
+
+	const unsigned int numRays = RAYS_PER_CHUNK * chunkDensities.size();
+	const unsigned int numCollides = COLLIDES_PER_CHUNK * chunkDensities.size();
+
+	printCollisionResult("MeshShape        ", meshResult, numRays, numCollides);
+	printCollisionResult("DensityFieldShape", densityResult, numRays, numCollides);
+
+	delete physicsEngine;
+}
+
+void benchmarkChunkCulling() {
+	constexpr unsigned int COLUMN_HEIGHT = 8;
+	constexpr unsigned int ITERATIONS = 200;
+	const unsigned int chunkCounts[] = { 1000, 5000, 10000, 50000 };
+
+	Camera camera(glm::vec3(0.0f, 0.0f, 0.0f), 90.0f);
+	camera.aspectRatio = 16.0f / 9.0f;
+
+	for (const unsigned int chunkCount : chunkCounts) {
+		// Square of columns around the camera, like the loaded area
+		const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(chunkCount) / COLUMN_HEIGHT)));
+
+		ChunkCuller culler;
+		std::unordered_map<unsigned int, glm::vec3*> scatteredChunks; // Same layout as loadedChunks, one heap object per chunk
+
+		unsigned int id = 0;
+		for (int x = -side / 2; x < side - side / 2 && id < chunkCount; x++) {
+			for (int z = -side / 2; z < side - side / 2 && id < chunkCount; z++) {
+				for (int y = -static_cast<int>(COLUMN_HEIGHT) / 2; y < static_cast<int>(COLUMN_HEIGHT) / 2 && id < chunkCount; y++) {
+					culler.add(id, glm::ivec3(x, y, z));
+					scatteredChunks[id] = new glm::vec3(x, y, z);
+					id++;
+				}
+			}
+		}
+
+		std::vector<unsigned int> visible;
+		visible.reserve(chunkCount);
+		culler.cull(camera.planes, visible); // Builds the SoA arrays outside of the timing
+
+		double scalarMs = 0.0;
+		double cullerMs = 0.0;
+		size_t scalarVisible = 0;
+		size_t cullerVisible = 0;
+		size_t boxesTested = 0;
+
+		for (unsigned int i = 0; i < ITERATIONS; i++) {
+			camera.yaw = 360.0f * i / ITERATIONS;
+			camera.pitch = -20.0f;
+			camera.recomputeMatrices();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (const auto& [chunkId, chunkPosition] : scatteredChunks) {
+				const glm::vec3 min = *chunkPosition * static_cast<float>(CHUNK_SIZE);
+				if (camera.isAABBinsideFrustum(min, min + glm::vec3(CHUNK_SIZE))) scalarVisible++;
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			scalarMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+			start = std::chrono::high_resolution_clock::now();
+			culler.cull(camera.planes, visible);
+			end = std::chrono::high_resolution_clock::now();
+			cullerMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+			cullerVisible += visible.size();
+			boxesTested += culler.lastColumnsTested + culler.lastChunksTested;
+		}
+
+		std::cout << chunkCount << " chunks"
+			<< ": scalar " << scalarMs * 1000.0 / ITERATIONS << " us (" << scalarVisible / ITERATIONS << " visible)"
+			<< ", SoA " << cullerMs * 1000.0 / ITERATIONS << " us (" << cullerVisible / ITERATIONS << " visible, " << boxesTested / ITERATIONS << " boxes tested)"
+			<< ", speedup " << scalarMs / cullerMs << "x"
+			<< std::endl;
+
+		for (const auto& [chunkId, chunkPosition] : scatteredChunks) {
+			delete chunkPosition;
+		}
+	}
+}
+
+void benchmarkWorldStorage() {
+	constexpr int SIDE = 8; // Chunks per axis, spread over several region files
+	constexpr unsigned int EDITED_CHUNK_INTERVAL = 4; // One chunk in 4 gets dug into
+	constexpr unsigned int EDITS_PER_CHUNK = 8;
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "advanced_engine_storage_benchmark";
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+
+	TerrainGenerator generator;
+	std::vector<glm::ivec3> positions;
+	for (int x = -SIDE / 2; x < SIDE / 2; x++) {
+		for (int y = 0; y < SIDE; y++) {
+			for (int z = -SIDE / 2; z < SIDE / 2; z++) {
+				positions.push_back(glm::ivec3(x, y, z));
+			}
+		}
+	}
+
+	std::vector<GeneratedTerrainResult> edited;
+	std::vector<TerrainDelta> deltas(positions.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	for (const glm::ivec3& position : positions) {
+		edited.push_back(generator.generateTerrain(position.x, position.y, position.z));
+	}
+	const double generateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Sphere digs like the player's tool, inside the chunk so each edit stays in one chunk
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> offset(4.0f, CHUNK_SIZE - 4.0f);
+	unsigned int editedChunks = 0;
+	size_t editedSamples = 0;
+	for (size_t i = 0; i < positions.size(); i += EDITED_CHUNK_INTERVAL) {
+		for (unsigned int e = 0; e < EDITS_PER_CHUNK; e++) {
+			const TerrainEdit edit = {
+				.shape = TerrainEditShape::Sphere,
+				.mode = e % 2 == 0 ? TerrainEditMode::Dig : TerrainEditMode::Place,
+				.center = glm::vec3(positions[i]) * static_cast<float>(CHUNK_SIZE) + glm::vec3(offset(random), offset(random), offset(random)),
+				.size = glm::vec3(2.5f),
+				.strength = 0.0f,
+				.material = 0
+			};
+			glm::ivec3 dirtyMin, dirtyMax;
+			applyTerrainEdit(edit, positions[i], edited[i].densities, edited[i].materials, deltas[i], dirtyMin, dirtyMax);
+		}
+		editedChunks++;
+		editedSamples += deltas[i].size();
+	}
+
+	uint64_t bytesSaved = 0;
+	unsigned int chunksSaved = 0;
+	start = std::chrono::high_resolution_clock::now();
+	{
+		WorldStorage storage(directory.string());
+		for (size_t i = 0; i < positions.size(); i++) {
+			if (!deltas[i].empty()) {
+				storage.saveChunk(positions[i], deltas[i]);
+			}
+		}
+		storage.flush();
+		bytesSaved = storage.bytesSaved;
+		chunksSaved = storage.chunksSaved;
+	}
+	const double saveMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// A new storage opens the files again, like the next run of the game: generate, then apply the saved edits
+	unsigned int mismatches = 0;
+	start = std::chrono::high_resolution_clock::now();
+	{
+		WorldStorage storage(directory.string());
+		for (size_t i = 0; i < positions.size(); i++) {
+			GeneratedTerrainResult terrain = generator.generateTerrain(positions[i].x, positions[i].y, positions[i].z);
+			TerrainDelta delta;
+			if (storage.loadChunk(positions[i], delta)) {
+				delta.apply(terrain.densities, terrain.materials);
+			}
+			if (terrain.densities != edited[i].densities || terrain.materials != edited[i].materials) {
+				mismatches++;
+			}
+		}
+	}
+	const double loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	uint64_t bytesOnDisk = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		bytesOnDisk += entry.file_size();
+	}
+
+	const double chunkCount = static_cast<double>(positions.size());
+	const double fullGridBytes = static_cast<double>(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES) * (sizeof(float) + sizeof(unsigned int));
+	std::cout << positions.size() << " chunks, " << editedChunks << " edited (" << editedSamples / std::max(editedChunks, 1u) << " samples each)"
+		<< ": generate " << generateMs / chunkCount << " ms/chunk"
+		<< ", generate + apply edits " << loadMs / chunkCount << " ms/chunk"
+		<< ", save " << saveMs << " ms"
+		<< std::endl;
+	std::cout << chunksSaved << " chunks written, " << static_cast<double>(bytesSaved) / std::max(chunksSaved, 1u) << " bytes per edited chunk"
+		<< " (full grids would be " << fullGridBytes / 1024.0 << " KB), " << bytesOnDisk / 1024.0 << " KB on disk with region headers"
+		<< ", " << mismatches << " mismatches"
+		<< std::endl;
+
+	std::filesystem::remove_all(directory, error);
+}
+
+void benchmarkVoxelOctree() {
+	const unsigned int radii[] = { 6, 12, 24 }; // In chunks, like RENDER_DISTANCE
+	constexpr float LOD_DISTANCE = 2.0f; // Nodes are split until they are smaller than their distance / LOD_DISTANCE
+	constexpr int VERIFIED_CHUNKS = 2; // Chunks per axis around the center compared sample by sample
+
+	TerrainGenerator generator;
+	MarchingCubeGenerator meshGenerator(0.5f);
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	WorkerPool workerPool(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+	// Both cover the loaded sphere around the chunk at the origin. Grid materials are counted at 1 byte like the
+	// octree's, the chunks keep them as unsigned int which would make the octree look 3 bytes per sample better
+	const glm::vec3 center = glm::vec3(CHUNK_SIZE * 0.5f);
+	const double gridBytes = static_cast<double>(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES) * (sizeof(float) + sizeof(unsigned char));
+
+	for (const unsigned int radius : radii) {
+		const int r = static_cast<int>(radius);
+
+		std::vector<glm::ivec3> chunkPositions;
+		for (int x = -r; x <= r; x++) {
+			for (int y = -r; y <= r; y++) {
+				for (int z = -r; z <= r; z++) {
+					if (x * x + y * y + z * z <= r * r) {
+						chunkPositions.push_back(glm::ivec3(x, y, z));
+					}
+				}
+			}
+		}
+
+		const float sphereRadius = (radius + 0.5f) * CHUNK_SIZE;
+		const int rootRadius = static_cast<int>(std::ceil(sphereRadius / OCTREE_ROOT_CELLS)) + 1;
+		std::vector<glm::ivec3> rootPositions;
+		for (int x = -rootRadius; x <= rootRadius; x++) {
+			for (int y = -rootRadius; y <= rootRadius; y++) {
+				for (int z = -rootRadius; z <= rootRadius; z++) {
+					const glm::vec3 rootMin = glm::vec3(glm::ivec3(x, y, z) * static_cast<int>(OCTREE_ROOT_CELLS));
+					const glm::vec3 closest = glm::clamp(center, rootMin, rootMin + glm::vec3(static_cast<float>(OCTREE_ROOT_CELLS)));
+					if (glm::length(center - closest) <= sphereRadius) {
+						rootPositions.push_back(glm::ivec3(x, y, z));
+					}
+				}
+			}
+		}
+
+		// Grids are generated and dropped, at radius 24 they wouldn't fit in memory all at once
+		auto start = std::chrono::high_resolution_clock::now();
+		workerPool.parallelFor(static_cast<unsigned int>(chunkPositions.size()), [&](const unsigned int i) {
+			GeneratedTerrainResult terrain = generator.generateTerrain(chunkPositions[i].x, chunkPositions[i].y, chunkPositions[i].z);
+		});
+		const double gridMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::atomic<uint64_t> octreeBytes = 0;
+		std::atomic<unsigned int> nodeCount = 0;
+		std::atomic<unsigned int> brickCount = 0;
+		std::atomic<unsigned int> selectedNodes = 0;
+		std::atomic<uint64_t> lodVertices = 0;
+		std::atomic<uint64_t> meshNanoseconds = 0;
+		start = std::chrono::high_resolution_clock::now();
+		workerPool.parallelFor(static_cast<unsigned int>(rootPositions.size()), [&](const unsigned int i) {
+			VoxelOctree octree(&generator, rootPositions[i]);
+
+			std::vector<OctreeLodNode> selected;
+			octree.selectLod(center, LOD_DISTANCE, selected);
+
+			// The selected nodes go through the mesher like a chunk would
+			const auto meshStart = std::chrono::high_resolution_clock::now();
+			size_t vertexFloats = 0;
+			for (const OctreeLodNode& node : selected) {
+				vertexFloats += octree.meshNode(&meshGenerator, node).size();
+			}
+			meshNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - meshStart).count();
+
+			octreeBytes += octree.getMemoryUsage();
+			nodeCount += octree.getNodeCount();
+			brickCount += octree.getBrickCount();
+			selectedNodes += static_cast<unsigned int>(selected.size());
+			lodVertices += vertexFloats / N_TERRAIN_VA;
+		});
+		const double octreeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		const double gridVolume = static_cast<double>(chunkPositions.size()) * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+		const double octreeVolume = static_cast<double>(rootPositions.size()) * OCTREE_ROOT_CELLS * OCTREE_ROOT_CELLS * OCTREE_ROOT_CELLS;
+		const double totalGridBytes = gridBytes * chunkPositions.size();
+		std::cout << "Radius " << radius << ": grids " << chunkPositions.size() << " chunks, " << totalGridBytes / (1024.0 * 1024.0) << " MB"
+			<< " (" << totalGridBytes / gridVolume << " bytes/m3), generated in " << gridMs << " ms"
+			<< std::endl;
+		std::cout << "Radius " << radius << ": octrees " << rootPositions.size() << " roots, " << octreeBytes / (1024.0 * 1024.0) << " MB"
+			<< " (" << octreeBytes / octreeVolume << " bytes/m3), generated in " << octreeMs << " ms"
+			<< ", " << nodeCount << " nodes, " << brickCount << " bricks, " << selectedNodes << " nodes selected for LOD"
+			<< std::endl;
+		std::cout << "Radius " << radius << ": LOD nodes meshed into " << lodVertices << " vertices in " << meshNanoseconds / 1e6 << " ms of worker time"
+			<< " (included above)" << std::endl;
+	}
+
+	// Full detail nodes mesh to the same vertex count as the same cells of the generated terrain
+	{
+		VoxelOctree octree(&generator, glm::ivec3(0, 0, 0));
+		std::vector<OctreeLodNode> selected;
+		octree.selectLod(glm::vec3(0.0f), 1e9f, selected); // Everything at level 0
+
+		unsigned int meshMismatches = 0;
+		std::vector<float> region;
+		std::vector<float> densities(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES);
+		const std::vector<unsigned int> materials(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES, 0);
+		for (const OctreeLodNode& node : selected) {
+			generator.generateDensities(node.origin.x, node.origin.y, node.origin.z, BRICK_SAMPLES, BRICK_SAMPLES, BRICK_SAMPLES, region);
+			for (unsigned int y = 0; y < BRICK_SAMPLES; y++) {
+				for (unsigned int x = 0; x < BRICK_SAMPLES; x++) {
+					for (unsigned int z = 0; z < BRICK_SAMPLES; z++) {
+						densities[sampleIndex(x, y, z)] = region[z + x * BRICK_SAMPLES + y * BRICK_SAMPLES * BRICK_SAMPLES];
+					}
+				}
+			}
+
+			std::vector<float> expected;
+			std::vector<unsigned int> cellVertexCounts;
+			meshGenerator.generateCells(densities, materials, glm::ivec3(0, 0, 0), glm::ivec3(BRICK_CELLS), expected, cellVertexCounts);
+			if (octree.meshNode(&meshGenerator, node).size() != expected.size()) {
+				meshMismatches++;
+			}
+		}
+		std::cout << meshMismatches << " of " << selected.size() << " full detail nodes mesh differently from the generated terrain" << std::endl;
+	}
+
+	// The octrees hold exactly the samples of the chunk grids
+	unsigned int mismatches = 0;
+	std::unordered_map<int, VoxelOctree*> octrees;
+	for (int x = -VERIFIED_CHUNKS; x < VERIFIED_CHUNKS; x++) {
+		for (int y = -VERIFIED_CHUNKS; y < VERIFIED_CHUNKS; y++) {
+			for (int z = -VERIFIED_CHUNKS; z < VERIFIED_CHUNKS; z++) {
+				GeneratedTerrainResult terrain = generator.generateTerrain(x, y, z);
+				for (unsigned int i = 0; i < CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES; i++) {
+					const glm::ivec3 local(i / CHUNK_SAMPLES % CHUNK_SAMPLES, i / (CHUNK_SAMPLES * CHUNK_SAMPLES), i % CHUNK_SAMPLES);
+					const glm::ivec3 worldSample = glm::ivec3(x, y, z) * static_cast<int>(CHUNK_SIZE) + local;
+					const glm::ivec3 rootPosition = glm::ivec3(glm::floor(glm::vec3(worldSample) / static_cast<float>(OCTREE_ROOT_CELLS)));
+
+					// Roots within 4 of the origin, packed into one key
+					const int key = (rootPosition.x + 4) + (rootPosition.y + 4) * 8 + (rootPosition.z + 4) * 64;
+					VoxelOctree*& octree = octrees[key];
+					if (octree == nullptr) {
+						octree = new VoxelOctree(&generator, rootPosition);
+					}
+
+					float density;
+					unsigned int material;
+					octree->sample(worldSample, density, material);
+					if (density != terrain.densities[i] || material != terrain.materials[i]) {
+						mismatches++;
+					}
+				}
+			}
+		}
+	}
+	for (const auto& [key, octree] : octrees) {
+		delete octree;
+	}
+	std::cout << mismatches << " samples differ between the octrees and the chunk grids" << std::endl;
+}
+
+void benchmarkVoxelQueries() {
+	constexpr int CHUNKS_XZ = 4; // Chunks from -CHUNKS_XZ to CHUNKS_XZ - 1 on x and z
+	constexpr int CHUNKS_Y = 4; // From 0, around the surface
+	constexpr unsigned int NUM_RAYS = 65536;
+	constexpr unsigned int NUM_SWEEPS = 4096;
+	constexpr float RAY_LENGTH = 64.0f;
+	constexpr float SWEEP_RADIUS = 0.5f;
+
+	TerrainGenerator generator;
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	WorkerPool workerPool(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+	std::vector<glm::ivec3> chunkPositions;
+	for (int x = -CHUNKS_XZ; x < CHUNKS_XZ; x++) {
+		for (int y = 0; y < CHUNKS_Y; y++) {
+			for (int z = -CHUNKS_XZ; z < CHUNKS_XZ; z++) {
+				chunkPositions.push_back(glm::ivec3(x, y, z));
+			}
+		}
+	}
+
+	std::vector<std::shared_ptr<const VoxelBuffer>> voxels(chunkPositions.size());
+	workerPool.parallelFor(static_cast<unsigned int>(chunkPositions.size()), [&](const unsigned int i) {
+		GeneratedTerrainResult terrain = generator.generateTerrain(chunkPositions[i].x, chunkPositions[i].y, chunkPositions[i].z);
+		voxels[i] = std::make_shared<const VoxelBuffer>(VoxelBuffer{ std::move(terrain.densities), std::move(terrain.materials) });
+	});
+
+	VoxelQueries queries(0.5f);
+	for (size_t i = 0; i < chunkPositions.size(); i++) {
+		queries.setChunk(chunkPositions[i], voxels[i]);
+	}
+
+	// Same rays on every run, starting anywhere in the chunks that are loaded, in any direction
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> horizontal(-CHUNKS_XZ * static_cast<float>(CHUNK_SIZE), CHUNKS_XZ * static_cast<float>(CHUNK_SIZE));
+	std::uniform_real_distribution<float> vertical(0.0f, CHUNKS_Y * static_cast<float>(CHUNK_SIZE));
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+	std::vector<VoxelRay> rays(NUM_RAYS);
+	for (VoxelRay& ray : rays) {
+		glm::vec3 direction(0.0f);
+		while (glm::length(direction) < 0.001f) {
+			direction = glm::vec3(normal(rng), normal(rng), normal(rng));
+		}
+		ray = { glm::vec3(horizontal(rng), vertical(rng), horizontal(rng)), glm::normalize(direction), RAY_LENGTH };
+	}
+
+	const auto raysPerSecond = [](const unsigned int count, const std::chrono::high_resolution_clock::time_point start) {
+		return count / std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	std::vector<VoxelHit> singleHits(NUM_RAYS);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < NUM_RAYS; i++) {
+		singleHits[i] = queries.raycast(rays[i]);
+	}
+	const double singleRate = raysPerSecond(NUM_RAYS, start);
+
+	std::vector<VoxelHit> packetHits(NUM_RAYS);
+	start = std::chrono::high_resolution_clock::now();
+	queries.raycast(rays.data(), packetHits.data(), NUM_RAYS);
+	const double packetRate = raysPerSecond(NUM_RAYS, start);
+
+	std::vector<VoxelHit> threadedHits(NUM_RAYS);
+	start = std::chrono::high_resolution_clock::now();
+	queries.raycast(rays.data(), threadedHits.data(), NUM_RAYS, &workerPool);
+	const double threadedRate = raysPerSecond(NUM_RAYS, start);
+
+	// Every path must give the same hits, bit for bit
+	unsigned int hitCount = 0;
+	unsigned int mismatches = 0;
+	for (unsigned int i = 0; i < NUM_RAYS; i++) {
+		if (singleHits[i].isHit()) hitCount++;
+		for (const VoxelHit* other : { &packetHits[i], &threadedHits[i] }) {
+			if (other->distance != singleHits[i].distance || other->position != singleHits[i].position || other->normal != singleHits[i].normal) {
+				mismatches++;
+				break;
+			}
+		}
+	}
+
+	std::vector<VoxelHit> sweepHits(NUM_SWEEPS);
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < NUM_SWEEPS; i++) {
+		sweepHits[i] = queries.sphereSweep(rays[i], SWEEP_RADIUS);
+	}
+	const double sweepRate = raysPerSecond(NUM_SWEEPS, start);
+
+	std::vector<VoxelHit> threadedSweepHits(NUM_SWEEPS);
+	start = std::chrono::high_resolution_clock::now();
+	queries.sphereSweep(rays.data(), threadedSweepHits.data(), NUM_SWEEPS, SWEEP_RADIUS, &workerPool);
+	const double threadedSweepRate = raysPerSecond(NUM_SWEEPS, start);
+
+	unsigned int sweepHitCount = 0;
+	for (unsigned int i = 0; i < NUM_SWEEPS; i++) {
+		if (sweepHits[i].isHit()) sweepHitCount++;
+		if (threadedSweepHits[i].distance != sweepHits[i].distance || threadedSweepHits[i].position != sweepHits[i].position) {
+			mismatches++;
+		}
+	}
+
+#ifdef __AVX2__
+	const char* packetName = "AVX2 packets of 8";
+#else
+	const char* packetName = "packets (scalar fallback)";
+#endif
+	std::cout << chunkPositions.size() << " chunks, " << NUM_RAYS << " rays of " << RAY_LENGTH << " m, " << 100.0f * hitCount / NUM_RAYS << "% hit" << std::endl;
+	std::cout << "Raycast: single " << singleRate / 1e6 << " M rays/s, " << packetName << " " << packetRate / 1e6 << " M rays/s, "
+		<< workerPool.getThreadCount() << " workers " << threadedRate / 1e6 << " M rays/s" << std::endl;
+	std::cout << "Sphere sweep (radius " << SWEEP_RADIUS << "): single " << sweepRate / 1e3 << " K sweeps/s, "
+		<< workerPool.getThreadCount() << " workers " << threadedSweepRate / 1e3 << " K sweeps/s, " << 100.0f * sweepHitCount / NUM_SWEEPS << "% hit" << std::endl;
+	std::cout << mismatches << " queries differ between the single, packet and threaded paths" << std::endl;
+}
+
+// Same path on every run: one lap around the spawn above the terrain, looking along the path and slightly down
+static void scriptedCameraPose(const unsigned int frame, const unsigned int frameCount, glm::vec3& position, float& yaw, float& pitch) {
+	constexpr float RADIUS = 96.0f;
+	constexpr float HEIGHT = 80.0f;
+
+	const float angle = 6.2831853f * static_cast<float>(frame) / static_cast<float>(frameCount);
+	position = glm::vec3(std::cos(angle) * RADIUS, HEIGHT, std::sin(angle) * RADIUS);
+	yaw = glm::degrees(angle) + 90.0f;
+	pitch = -25.0f;
+}
+
+static void writeFrameStatsJson(std::ostream& out, const FrameBenchmarkConfig& config, const std::vector<FrameStats>& frames, const std::vector<float>& gpuMilliseconds) {
+	double cpuTotal = 0.0;
+	double gpuTotal = 0.0;
+	float cpuMax = 0.0f;
+	float gpuMax = 0.0f;
+	for (size_t i = 0; i < frames.size(); i++) {
+		cpuTotal += frames[i].cpuMilliseconds;
+		gpuTotal += gpuMilliseconds[i];
+		cpuMax = std::max(cpuMax, frames[i].cpuMilliseconds);
+		gpuMax = std::max(gpuMax, gpuMilliseconds[i]);
+	}
+
+	out << "{\n";
+	out << "  \"width\": " << config.width << ",\n";
+	out << "  \"height\": " << config.height << ",\n";
+	out << "  \"settled\": " << (config.waitForStreaming ? "true" : "false") << ",\n";
+	out << "  \"summary\": { \"frames\": " << frames.size()
+		<< ", \"cpuMsAverage\": " << cpuTotal / frames.size() << ", \"cpuMsMax\": " << cpuMax
+		<< ", \"gpuMsAverage\": " << gpuTotal / frames.size() << ", \"gpuMsMax\": " << gpuMax << " },\n";
+	out << "  \"frames\": [\n";
+	for (size_t i = 0; i < frames.size(); i++) {
+		const FrameStats& frame = frames[i];
+		out << "    { \"frame\": " << i
+			<< ", \"cpuMs\": " << frame.cpuMilliseconds
+			<< ", \"gpuMs\": " << gpuMilliseconds[i]
+			<< ", \"drawCalls\": " << frame.drawCalls
+			<< ", \"chunkDraws\": " << frame.chunkDraws
+			<< ", \"triangles\": " << frame.triangles
+			<< ", \"chunksAllocated\": " << frame.chunksAllocated
+			<< ", \"glObjectsCreated\": " << frame.glObjectsCreated
+			<< ", \"cancelledChunkJobs\": " << frame.cancelledChunkJobs
+			<< ", \"prefetchedChunks\": " << frame.prefetchedChunks
+			<< ", \"prefetchHits\": " << frame.prefetchHits
+			<< ", \"prefetchHitRate\": " << (frame.prefetchedChunks > 0 ? static_cast<float>(frame.prefetchHits) / frame.prefetchedChunks : 0.0f)
+			<< ", \"loaderGeneratedChunks\": " << frame.loaderGeneratedChunks
+			<< ", \"chunkStates\": {";
+		for (unsigned int state = 0; state < CHUNK_STATE_COUNT; state++) {
+			out << (state > 0 ? ", " : " ") << "\"" << getChunkStateName(static_cast<ChunkState>(state)) << "\": " << frame.chunkStates[state];
+		}
+		out << " } }" << (i + 1 < frames.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}" << std::endl;
+}
+
+void benchmarkFrames(const FrameBenchmarkConfig& config) {
+	Engine* engine = new Engine(true, config.width, config.height);
+
+	if (!config.dumpDirectory.empty()) {
+		std::filesystem::create_directories(config.dumpDirectory);
+	}
+
+	// One timer query per frame, read back at the end so the GPU is never waited on mid-run
+	std::vector<GLuint> timerQueries(config.frames);
+	glGenQueries(config.frames, timerQueries.data());
+
+	std::vector<FrameStats> frames;
+	frames.reserve(config.frames);
+	std::vector<unsigned char> pixels;
+	const auto runStart = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < config.frames; i++) {
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+		scriptedCameraPose(i, config.frames, position, yaw, pitch);
+		engine->setCameraPose(position, yaw, pitch);
+
+		if (config.waitForStreaming) {
+			engine->waitForChunkStreaming();
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, timerQueries[i]);
+		frames.push_back(engine->renderFrame());
+		glEndQuery(GL_TIME_ELAPSED);
+
+		if (!config.dumpDirectory.empty()) {
+			engine->readFramePixels(pixels);
+
+			char fileName[32];
+			std::snprintf(fileName, sizeof(fileName), "frame_%04u.png", i);
+			const std::string path = (std::filesystem::path(config.dumpDirectory) / fileName).string();
+
+			stbi_flip_vertically_on_write(1);
+			if (!stbi_write_png(path.c_str(), engine->getWidth(), engine->getHeight(), 3, pixels.data(), engine->getWidth() * 3)) {
+				std::cerr << "Failed to write " << path << std::endl;
+			}
+		}
+	}
+
+	// Churn of the walk, from the end of the first frame so the startup resources don't count
+	const double runMinutes = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - runStart).count() / 60.0;
+	const unsigned int chunkAllocations = frames.back().chunksAllocated - frames.front().chunksAllocated;
+	const unsigned int chunksRecycled = frames.back().chunksRecycled - frames.front().chunksRecycled;
+	const uint64_t glObjectsCreated = frames.back().glObjectsCreated - frames.front().glObjectsCreated;
+	std::cout << "Over " << runMinutes * 60.0 << " s: " << chunkAllocations << " chunk allocations (" << chunkAllocations / runMinutes << " per minute), "
+		<< chunksRecycled << " chunks recycled, " << glObjectsCreated << " GL objects created (" << glObjectsCreated / runMinutes << " per minute)"
+		<< std::endl;
+	std::cout << frames.back().cancelledChunkJobs << " chunk jobs cancelled after leaving the load region, " << frames.back().staleChunkResults
+		<< " of them already meshed and thrown away" << std::endl;
+	std::cout << frames.back().prefetchedChunks << " chunks prefetched, " << frames.back().prefetchHits << " used by the loader, "
+		<< frames.back().loaderGeneratedChunks << " generated by the loader itself" << std::endl;
+
+	std::vector<float> gpuMilliseconds(config.frames);
+	for (unsigned int i = 0; i < config.frames; i++) {
+		GLuint64 elapsedNanoseconds = 0;
+		glGetQueryObjectui64v(timerQueries[i], GL_QUERY_RESULT, &elapsedNanoseconds);
+		gpuMilliseconds[i] = static_cast<float>(elapsedNanoseconds / 1000000.0);
+	}
+	glDeleteQueries(config.frames, timerQueries.data());
+
+	std::ofstream file(config.jsonPath);
+	if (!file) {
+		delete engine;
+		throw std::runtime_error("Failed to open " + config.jsonPath);
+	}
+	writeFrameStatsJson(file, config, frames, gpuMilliseconds);
+	std::cout << "Frame stats written to " << config.jsonPath << std::endl;
+
+	if (!config.tracePath.empty()) {
+		Profiler::exportChromeTrace(config.tracePath);
+	}
+
+	delete engine;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Headless benchmarks, started with "--bench <name> [options]" on the command line. They print their results to stdout.
+
+bool runBenchmark(const std::string& name, const std::vector<std::string>& options);
+
+// "--bench frames --frames 300 --size 1280x720 --json out.json --dump frames/ --trace trace.json --settle"
+struct FrameBenchmarkConfig {
+	unsigned int frames = 300;
+	unsigned int width = 1280;
+	unsigned int height = 720;
+	std::string jsonPath = "frame_benchmark.json"; // Written to a file, the chunk streaming logs go to stdout
+	std::string dumpDirectory; // PNG of every frame, for golden image comparison. Empty disables it
+	std::string tracePath; // Chrome trace of the profiler zones. Empty disables it
+	bool waitForStreaming = false; // Load every chunk before each frame, so the images don't depend on timing
+};
+
+void benchmarkCollisionShapes();
+void benchmarkChunkCulling();
+void benchmarkWorldStorage(); // Size and speed of saved terrain edits, "--bench storage"
+void benchmarkVoxelOctree(); // Memory and generation time of octrees against chunk grids, "--bench octree"
+void benchmarkVoxelQueries(); // Raycast and sphere sweep throughput against chunk densities, "--bench raycast"
+void benchmarkFrames(const FrameBenchmarkConfig& config);
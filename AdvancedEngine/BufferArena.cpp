@@ -0,0 +1,86 @@
+#include "BufferArena.h"
+
+BufferArena::BufferArena(const unsigned int capacity) : capacity(0), usedSize(0) {
+	grow(capacity);
+}
+
+ArenaRange BufferArena::allocate(const unsigned int size) {
+	if (size == 0) return { 0, 0 };
+
+	// Smallest free block that is large enough
+	auto bestFit = freeBlocksBySize.lower_bound({ size, 0 });
+	if (bestFit == freeBlocksBySize.end()) return { 0, 0 };
+
+	const unsigned int blockSize = bestFit->first;
+	const unsigned int blockOffset = bestFit->second;
+	eraseFreeBlock(blockOffset, blockSize);
+
+	if (blockSize > size) {
+		insertFreeBlock(blockOffset + size, blockSize - size);
+	}
+
+	usedSize += size;
+	return { blockOffset, size };
+}
+
+void BufferArena::free(const ArenaRange& range) {
+	if (!range.isValid()) return;
+
+	usedSize -= range.size;
+
+	unsigned int offset = range.offset;
+	unsigned int size = range.size;
+
+	// Merge with the free block right after
+	auto next = freeBlocksByOffset.find(offset + size);
+	if (next != freeBlocksByOffset.end()) {
+		const unsigned int nextSize = next->second;
+		eraseFreeBlock(offset + size, nextSize);
+		size += nextSize;
+	}
+
+	// Merge with the free block right before
+	auto previous = freeBlocksByOffset.lower_bound(offset);
+	if (previous != freeBlocksByOffset.begin()) {
+		--previous;
+		if (previous->first + previous->second == offset) {
+			const unsigned int previousOffset = previous->first;
+			const unsigned int previousSize = previous->second;
+			eraseFreeBlock(previousOffset, previousSize);
+			offset = previousOffset;
+			size += previousSize;
+		}
+	}
+
+	insertFreeBlock(offset, size);
+}
+
+void BufferArena::grow(const unsigned int newCapacity) {
+	if (newCapacity <= capacity) return;
+
+	const unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+
+	// The new space is handed over as a freed range so it merges with a free block at the end
+	usedSize += newCapacity - oldCapacity;
+	free({ oldCapacity, newCapacity - oldCapacity });
+}
+
+unsigned int BufferArena::largestFreeBlock() const {
+	if (freeBlocksBySize.empty()) return 0;
+	return freeBlocksBySize.rbegin()->first;
+}
+
+unsigned int BufferArena::freeBlockCount() const {
+	return freeBlocksByOffset.size();
+}
+
+void BufferArena::insertFreeBlock(const unsigned int offset, const unsigned int size) {
+	freeBlocksByOffset[offset] = size;
+	freeBlocksBySize.insert({ size, offset });
+}
+
+void BufferArena::eraseFreeBlock(const unsigned int offset, const unsigned int size) {
+	freeBlocksByOffset.erase(offset);
+	freeBlocksBySize.erase({ size, offset });
+}
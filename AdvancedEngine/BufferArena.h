@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <utility>
+
+// A range of elements inside a BufferArena. An empty range means the allocation failed.
+struct ArenaRange {
+	unsigned int offset;
+	unsigned int size;
+
+	bool isValid() const { return size != 0; }
+};
+
+/*
+Sub-allocator for ranges of one large buffer, in elements (vertices, indices...).
+Best fit over a free list, freed ranges are merged with their free neighbours.
+
+It only does the bookkeeping and never touches OpenGL, the owner of the buffer copies the data.
+*/
+class BufferArena {
+public:
+	BufferArena(const unsigned int capacity);
+
+	ArenaRange allocate(const unsigned int size);
+	void free(const ArenaRange& range);
+
+	// Adds space at the end of the arena, existing ranges keep their offsets
+	void grow(const unsigned int newCapacity);
+
+	unsigned int largestFreeBlock() const;
+	unsigned int freeBlockCount() const;
+
+	unsigned int capacity;
+	unsigned int usedSize;
+
+private:
+	void insertFreeBlock(const unsigned int offset, const unsigned int size);
+	void eraseFreeBlock(const unsigned int offset, const unsigned int size);
+
+	std::map<unsigned int, unsigned int> freeBlocksByOffset; // offset -> size, ordered to find neighbours
+	std::set<std::pair<unsigned int, unsigned int>> freeBlocksBySize; // (size, offset), ordered for best fit
+};
@@ -1,62 +1,223 @@
 #include "Chunk.h"
-#include "Material.h"
 #include "Settings.h"
+#include "DensityFieldShape.h"
+#include "Profiler.h"
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
 #include <Jolt/Physics/Collision/Shape/MeshShape.h>
+#include <cstring>
 
-Chunk::Chunk(const glm::vec3& chunkPosition, const std::vector<float>& densities, const std::vector<unsigned int>& materials) : chunkPosition(chunkPosition), densities(densities), materials(materials) {
+Chunk::Chunk(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels) : chunkPosition(chunkPosition), voxels(voxels), geometry({ { 0, 0 }, { 0, 0 } }), geometryArena(nullptr), chunkBody(nullptr), physicsEngine(nullptr), collisionMode(ChunkCollisionMode::Mesh), isoLevel(0.5f), cullId(0), pendingStaging({ 0, 0, nullptr }), stagingRing(nullptr), pendingVertexCount(0) {
 
 }
 
 Chunk::~Chunk() {
-	if (chunkObject == nullptr) return;
-	if (chunkMesh == nullptr) return;
-	delete chunkObject;
-	delete chunkMesh;
+	releaseResources();
+}
 
-    if (physicsEngine->bodyInterface->IsAdded(chunkBody->GetID())) {
-        physicsEngine->bodyInterface->RemoveBody(chunkBody->GetID());
+void Chunk::releaseResources() {
+    releasePhysics();
+
+    if (stagingRing != nullptr) {
+        stagingRing->release(pendingStaging);
+        pendingStaging = { 0, 0, nullptr };
+    }
+    if (geometryArena != nullptr) {
+        geometryArena->release(geometry);
     }
-    physicsEngine->bodyInterface->DestroyBody(chunkBody->GetID());
 }
 
-void Chunk::buildChunk(Material* material, MarchingCubeGenerator* generator, Camera* camera, PhysicsEngine* physicsEngine) {
-    this->physicsEngine = physicsEngine;
+void Chunk::reset(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels) {
+    this->chunkPosition = chunkPosition;
+    this->voxels = voxels;
+
+    collisionMode = ChunkCollisionMode::Mesh;
+    isoLevel = 0.5f;
+    cullId = 0;
+
+    occluderBoxes.clear();
+    pendingVertices.clear();
+    pendingVertexCount = 0;
+    meshVertices.clear();
+    cellVertexOffsets.clear();
+    collisionVertices.clear();
+}
+
+void Chunk::buildMesh(MarchingCubeGenerator* generator, StagingRing* stagingRing, const ChunkHalo& halo) {
+    PROFILE_ZONE("Mesh chunk");
+    this->stagingRing = stagingRing;
+    this->isoLevel = generator->threshold;
+
+    // Fully solid chunks have no mesh but are the best occluders, so this comes first
+    occluderBoxes = buildOccluderBoxes(voxels->densities, isoLevel);
     
-    std::vector<float> vertices = generator->generateMesh(densities, materials, 1);
-    if (vertices.size() == 0) return;
+    stageMesh(generator->generateMesh(voxels->densities, voxels->materials, 1, &halo));
+}
+
+void Chunk::remesh(MarchingCubeGenerator* generator, StagingRing* stagingRing, const ChunkHalo& halo, const glm::ivec3& cellMin, const glm::ivec3& cellMax) {
+    PROFILE_ZONE("Remesh chunk");
+    this->stagingRing = stagingRing;
+    this->isoLevel = generator->threshold;
 
-    // Create graphics mesh (unchanged)
-    std::vector<unsigned int> indices(vertices.size() / N_TERRAIN_VA);
-    for (unsigned int i = 0; i < vertices.size() / N_TERRAIN_VA; i++) {
-        indices[i] = i;
+    occluderBoxes = buildOccluderBoxes(voxels->densities, isoLevel);
+
+    constexpr unsigned int CELL_COUNT = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+    if (cellVertexOffsets.empty()) {
+        // First edit, mesh every cell once to learn their ranges
+        std::vector<unsigned int> cellVertexCounts;
+        meshVertices.clear();
+        generator->generateCells(voxels->densities, voxels->materials, glm::ivec3(0, 0, 0), glm::ivec3(CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE), meshVertices, cellVertexCounts, &halo);
+
+        cellVertexOffsets.resize(CELL_COUNT + 1);
+        cellVertexOffsets[0] = 0;
+        for (unsigned int cell = 0; cell < CELL_COUNT; cell++) {
+            cellVertexOffsets[cell + 1] = cellVertexOffsets[cell] + cellVertexCounts[cell];
+        }
     }
-    chunkMesh = new Mesh(vertices, indices, material);
-    chunkObject = new WorldObject(chunkPosition * static_cast<float>(CHUNK_SIZE), glm::vec3(0), glm::vec3(1), chunkMesh, camera);
+    else {
+        std::vector<float> dirtyVertices;
+        std::vector<unsigned int> dirtyVertexCounts;
+        generator->generateCells(voxels->densities, voxels->materials, cellMin, cellMax, dirtyVertices, dirtyVertexCounts, &halo);
 
-    // Prepare physics mesh data
-    JPH::VertexList verticesList;
-    JPH::IndexedTriangleList triangles;
+        // Splice the new cells between the kept ones, cells are in the same y, x, z order as generateCells
+        std::vector<float> vertices;
+        vertices.reserve(meshVertices.size() + dirtyVertices.size());
+        std::vector<unsigned int> offsets(CELL_COUNT + 1);
 
-    // Each triangle has 3 vertices, each vertex has 6 floats
-    unsigned int numTriangles = vertices.size() / (N_TERRAIN_VA * 3);
-    verticesList.reserve(numTriangles * 3);
-    triangles.reserve(numTriangles);
+        unsigned int dirtyCell = 0;
+        size_t dirtyOffset = 0;
+        for (unsigned int cell = 0; cell < CELL_COUNT; cell++) {
+            offsets[cell] = vertices.size() / N_TERRAIN_VA;
 
-    for (unsigned int tri = 0; tri < numTriangles; tri++) {
-        unsigned int baseIndex = tri * 3 * N_TERRAIN_VA; // Skip 6 floats per vertex, 3 vertices per triangle
+            const int z = cell % CHUNK_SIZE;
+            const int x = (cell / CHUNK_SIZE) % CHUNK_SIZE;
+            const int y = cell / (CHUNK_SIZE * CHUNK_SIZE);
+            const bool dirty = x >= cellMin.x && x < cellMax.x && y >= cellMin.y && y < cellMax.y && z >= cellMin.z && z < cellMax.z;
+
+            if (dirty) {
+                const size_t floatCount = static_cast<size_t>(dirtyVertexCounts[dirtyCell++]) * N_TERRAIN_VA;
+                vertices.insert(vertices.end(), dirtyVertices.begin() + dirtyOffset, dirtyVertices.begin() + dirtyOffset + floatCount);
+                dirtyOffset += floatCount;
+            }
+            else {
+                vertices.insert(vertices.end(), meshVertices.begin() + static_cast<size_t>(cellVertexOffsets[cell]) * N_TERRAIN_VA, meshVertices.begin() + static_cast<size_t>(cellVertexOffsets[cell + 1]) * N_TERRAIN_VA);
+            }
+        }
+        offsets[CELL_COUNT] = vertices.size() / N_TERRAIN_VA;
+
+        meshVertices = std::move(vertices);
+        cellVertexOffsets = std::move(offsets);
+    }
+
+    stageMesh(std::vector<float>(meshVertices));
+}
+
+void Chunk::stageMesh(std::vector<float>&& vertices) {
+    pendingVertexCount = 0;
+    collisionVertices.clear();
+    if (vertices.size() == 0) return;
 
-        // Add vertices for this triangle
-        for (int i = 0; i < 3; i++) {
-            unsigned int offset = baseIndex + i * N_TERRAIN_VA;
-            verticesList.push_back(JPH::Float3(
+    pendingVertexCount = vertices.size() / N_TERRAIN_VA;
+
+    // Vertices then indices, written straight into the mapped staging memory when the ring has room.
+    // Indices are local to the chunk, the draw command's base vertex points them at the arena range
+    const unsigned int vertexBytes = vertices.size() * sizeof(float);
+    pendingStaging = stagingRing->allocate(vertexBytes + pendingVertexCount * sizeof(unsigned int));
+
+    if (pendingStaging.isValid()) {
+        std::memcpy(pendingStaging.data, vertices.data(), vertexBytes);
+
+        unsigned int* indices = reinterpret_cast<unsigned int*>(pendingStaging.data + vertexBytes);
+        for (unsigned int i = 0; i < pendingVertexCount; i++) {
+            indices[i] = i;
+        }
+    }
+
+    // Keep the triangle positions for the physics mesh, cooking happens in buildPhysics()
+    if (collisionMode == ChunkCollisionMode::Mesh) {
+        collisionVertices.reserve(pendingVertexCount);
+
+        for (unsigned int i = 0; i < pendingVertexCount; i++) {
+            unsigned int offset = i * N_TERRAIN_VA;
+            collisionVertices.push_back(JPH::Float3(
                 vertices[offset],     // x
                 vertices[offset + 1], // y
                 vertices[offset + 2]  // z
             ));
         }
+    }
 
-        // Add triangle (vertices are added in order, so indices are sequential)
+    if (!pendingStaging.isValid()) {
+        pendingVertices = std::move(vertices);
+    }
+}
+
+void Chunk::uploadMesh(TerrainGeometryArena* geometryArena, PhysicsEngine* physicsEngine) {
+    this->geometryArena = geometryArena;
+    this->physicsEngine = physicsEngine;
+
+    // Replaces the mesh of an edited chunk
+    if (hasGeometry()) {
+        geometryArena->release(geometry);
+    }
+
+    if (pendingVertexCount == 0) return;
+
+    if (pendingStaging.isValid()) {
+        geometry = geometryArena->uploadFromStaging(stagingRing, pendingStaging, pendingVertexCount, pendingVertexCount);
+        stagingRing->release(pendingStaging);
+        pendingStaging = { 0, 0, nullptr };
+    }
+    else {
+        // The staging ring was full, go through glBufferSubData
+        std::vector<unsigned int> indices(pendingVertexCount);
+        for (unsigned int i = 0; i < pendingVertexCount; i++) {
+            indices[i] = i;
+        }
+        geometry = geometryArena->upload(pendingVertices, indices);
+        pendingVertices = std::vector<float>();
+    }
+
+    pendingVertexCount = 0;
+}
+
+void Chunk::buildPhysics() {
+    if (chunkBody != nullptr || physicsEngine == nullptr) return;
+    if (!hasGeometry()) return; // No surface, nothing to collide with
+
+    PROFILE_ZONE("Cook chunk collision");
+
+    if (collisionMode == ChunkCollisionMode::DensityField) {
+        chunkShape = new DensityFieldShape(voxels, isoLevel);
+    }
+    else {
+        chunkShape = buildMeshShape();
+    }
+
+    if (chunkShape == nullptr) return;
+
+    JPH::BodyCreationSettings bcs(
+        chunkShape,
+        JPH::Vec3(chunkPosition.x * CHUNK_SIZE, chunkPosition.y * CHUNK_SIZE, chunkPosition.z * CHUNK_SIZE),
+        JPH::Quat::sIdentity(),
+        JPH::EMotionType::Static,
+        Layers::NON_MOVING
+    );
+    chunkBody = physicsEngine->bodyInterface->CreateBody(bcs);
+    if (chunkBody != nullptr) {
+        physicsEngine->addObject(chunkBody);
+    }
+}
+
+JPH::Ref<JPH::Shape> Chunk::buildMeshShape() {
+    if (collisionVertices.empty()) return nullptr;
+
+    // Vertices are stored in triangle order, so indices are sequential
+    unsigned int numTriangles = collisionVertices.size() / 3;
+    JPH::IndexedTriangleList triangles;
+    triangles.reserve(numTriangles);
+
+    for (unsigned int tri = 0; tri < numTriangles; tri++) {
         unsigned int firstVertexIndex = tri * 3;
         triangles.push_back(JPH::IndexedTriangle(
             firstVertexIndex,
@@ -65,31 +226,38 @@ void Chunk::buildChunk(Material* material, MarchingCubeGenerator* generator, Cam
         ));
     }
 
-    JPH::MeshShapeSettings meshSettings(verticesList, triangles);
+    JPH::MeshShapeSettings meshSettings(collisionVertices, triangles);
     
 
     JPH::ShapeSettings::ShapeResult shapeResult = meshSettings.Create();
-    if (shapeResult.IsValid()) {
-        chunkShape = shapeResult.Get();
-        JPH::BodyCreationSettings bcs(
-            chunkShape,
-            JPH::Vec3(chunkPosition.x * CHUNK_SIZE, chunkPosition.y * CHUNK_SIZE, chunkPosition.z * CHUNK_SIZE),
-            JPH::Quat::sIdentity(),
-            JPH::EMotionType::Static,
-            Layers::NON_MOVING
-        );
-        chunkBody = physicsEngine->bodyInterface->CreateBody(bcs);
-    }
+    if (!shapeResult.IsValid()) return nullptr;
+
+    return shapeResult.Get();
 }
 
+void Chunk::releasePhysics() {
+    if (chunkBody == nullptr) return;
 
+    if (physicsEngine->bodyInterface->IsAdded(chunkBody->GetID())) {
+        physicsEngine->bodyInterface->RemoveBody(chunkBody->GetID());
+    }
+    physicsEngine->bodyInterface->DestroyBody(chunkBody->GetID());
 
-void Chunk::render() {
-	if (chunkObject != nullptr && chunkMesh != nullptr) {
+    chunkBody = nullptr;
+    chunkShape = nullptr;
+}
+
+bool Chunk::hasPhysics() const {
+    return chunkBody != nullptr;
+}
+
+bool Chunk::hasGeometry() const {
+    return geometry.isValid();
+}
 
+void Chunk::queueDraw() {
+	if (!hasGeometry()) return;
 
-		chunkObject->render();
-	}
-	
+	geometryArena->addDraw(geometry, chunkPosition * static_cast<float>(CHUNK_SIZE));
 }
 
@@ -1,26 +1,68 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
-#include "WorldObject.h"
+#include "TerrainGeometryArena.h"
+#include "OcclusionBuffer.h"
 #include "MarchingCubesGenerator.h"
+#include "ChunkHalo.h"
 #include "PhysicsEngine.h"
+#include "VoxelBuffer.h"
+
+enum class ChunkCollisionMode {
+	Mesh, // MeshShape cooked from the marching cubes triangles
+	DensityField // DensityFieldShape sampling the density grid directly
+};
 
 class Chunk {
 public:
-	Chunk(const glm::vec3& chunkPosition, const std::vector<float>& densities, const std::vector<unsigned int>& materials);
+	Chunk(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels);
 	~Chunk();
 
+	// Pooling: releaseResources() gives back the geometry, staging memory and physics body (main thread),
+	// reset() turns the chunk into a new one, reusing the capacity of its vectors (any thread)
+	void releaseResources();
+	void reset(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels);
+
 	glm::vec3 chunkPosition;
-	std::vector<float> densities;
-	std::vector<unsigned int> materials;
+	std::shared_ptr<const VoxelBuffer> voxels; // Shared with knownChunks, edits replace it with an edited copy
 
-	WorldObject* chunkObject;
-	Mesh* chunkMesh;
+	ChunkGeometry geometry;
+	TerrainGeometryArena* geometryArena;
 	JPH::Body* chunkBody;
 	JPH::Ref<JPH::Shape> chunkShape;
 	PhysicsEngine* physicsEngine;
 
-	void buildChunk(Material* material, MarchingCubeGenerator* generator, Camera* camera, PhysicsEngine* physicsEngine);
-	void render();
-};
\ No newline at end of file
+	ChunkCollisionMode collisionMode;
+	float isoLevel;
+
+	unsigned int cullId; // Slot in the ChunksManager's culling list
+	std::vector<OccluderBox> occluderBoxes; // Solid parts of the chunk, chunk-local
+
+	// Mesh produced by buildMesh() and waiting for uploadMesh(), in the staging ring or in pendingVertices when the ring was full
+	StagingAllocation pendingStaging;
+	StagingRing* stagingRing;
+	std::vector<float> pendingVertices;
+	unsigned int pendingVertexCount;
+
+	// Mesh kept on the CPU with the vertex range of each cell, so edits only remesh the cells they touch. Empty until the chunk is first edited
+	std::vector<float> meshVertices;
+	std::vector<unsigned int> cellVertexOffsets; // First vertex of each cell, plus the total at the end
+
+	// Triangle positions kept around so the collision shape can be cooked later, only when a dynamic body comes close (Mesh mode only)
+	JPH::VertexList collisionVertices;
+
+	void buildMesh(MarchingCubeGenerator* generator, StagingRing* stagingRing, const ChunkHalo& halo); // Safe on a worker thread, no GL calls. halo is finished and holds the current densities
+	void remesh(MarchingCubeGenerator* generator, StagingRing* stagingRing, const ChunkHalo& halo, const glm::ivec3& cellMin, const glm::ivec3& cellMax); // After an edit of the densities, cells in [cellMin, cellMax) changed. Same rules as buildMesh
+	void uploadMesh(TerrainGeometryArena* geometryArena, PhysicsEngine* physicsEngine); // Main thread
+	void buildPhysics();
+	void releasePhysics();
+	bool hasPhysics() const;
+	bool hasGeometry() const;
+	void queueDraw(); // Adds the chunk to the arena's next multi draw
+
+private:
+	void stageMesh(std::vector<float>&& vertices);
+	JPH::Ref<JPH::Shape> buildMeshShape();
+};
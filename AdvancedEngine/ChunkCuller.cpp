@@ -0,0 +1,224 @@
+#include "ChunkCuller.h"
+#include "Settings.h"
+#include <algorithm>
+#include <bit>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+void BoundsSoA::resize(const unsigned int count) {
+	const unsigned int paddedCount = count + 8;
+	minX.assign(paddedCount, 0.0f);
+	minY.assign(paddedCount, 0.0f);
+	minZ.assign(paddedCount, 0.0f);
+	maxX.assign(paddedCount, 0.0f);
+	maxY.assign(paddedCount, 0.0f);
+	maxZ.assign(paddedCount, 0.0f);
+}
+
+void BoundsSoA::set(const unsigned int index, const glm::vec3& min, const glm::vec3& max) {
+	minX[index] = min.x;
+	minY[index] = min.y;
+	minZ[index] = min.z;
+	maxX[index] = max.x;
+	maxY[index] = max.y;
+	maxZ[index] = max.z;
+}
+
+// Tests the boxes [first, first + 8) against the frustum planes.
+// Bit i of the result is set when box first + i is at least partly inside, bit i of outFullyInside when it is entirely inside.
+static unsigned int testBoxes8(const BoundsSoA& bounds, const unsigned int first, const Plane* planes, unsigned int& outFullyInside) {
+#ifdef __AVX2__
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	__m256 inside = visible;
+
+	for (int i = 0; i < 6; i++) {
+		const Plane& plane = planes[i];
+
+		// The corner furthest along the normal decides if the box is outside, the nearest one if it is fully inside
+		const float* farX = plane.normal.x >= 0 ? bounds.maxX.data() : bounds.minX.data();
+		const float* farY = plane.normal.y >= 0 ? bounds.maxY.data() : bounds.minY.data();
+		const float* farZ = plane.normal.z >= 0 ? bounds.maxZ.data() : bounds.minZ.data();
+		const float* nearX = plane.normal.x >= 0 ? bounds.minX.data() : bounds.maxX.data();
+		const float* nearY = plane.normal.y >= 0 ? bounds.minY.data() : bounds.maxY.data();
+		const float* nearZ = plane.normal.z >= 0 ? bounds.minZ.data() : bounds.maxZ.data();
+
+		const __m256 normalX = _mm256_set1_ps(plane.normal.x);
+		const __m256 normalY = _mm256_set1_ps(plane.normal.y);
+		const __m256 normalZ = _mm256_set1_ps(plane.normal.z);
+		const __m256 distance = _mm256_set1_ps(plane.distance);
+
+		__m256 farDistance = _mm256_add_ps(distance, _mm256_mul_ps(normalX, _mm256_loadu_ps(farX + first)));
+		farDistance = _mm256_add_ps(farDistance, _mm256_mul_ps(normalY, _mm256_loadu_ps(farY + first)));
+		farDistance = _mm256_add_ps(farDistance, _mm256_mul_ps(normalZ, _mm256_loadu_ps(farZ + first)));
+
+		__m256 nearDistance = _mm256_add_ps(distance, _mm256_mul_ps(normalX, _mm256_loadu_ps(nearX + first)));
+		nearDistance = _mm256_add_ps(nearDistance, _mm256_mul_ps(normalY, _mm256_loadu_ps(nearY + first)));
+		nearDistance = _mm256_add_ps(nearDistance, _mm256_mul_ps(normalZ, _mm256_loadu_ps(nearZ + first)));
+
+		visible = _mm256_and_ps(visible, _mm256_cmp_ps(farDistance, zero, _CMP_GE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(nearDistance, zero, _CMP_GE_OQ));
+	}
+
+	outFullyInside = _mm256_movemask_ps(inside);
+	return _mm256_movemask_ps(visible);
+#else
+	unsigned int visible = 0;
+	outFullyInside = 0;
+
+	for (unsigned int lane = 0; lane < 8; lane++) {
+		const unsigned int index = first + lane;
+		bool isVisible = true;
+		bool isInside = true;
+
+		for (int i = 0; i < 6; i++) {
+			const Plane& plane = planes[i];
+			const glm::vec3 farCorner(
+				plane.normal.x >= 0 ? bounds.maxX[index] : bounds.minX[index],
+				plane.normal.y >= 0 ? bounds.maxY[index] : bounds.minY[index],
+				plane.normal.z >= 0 ? bounds.maxZ[index] : bounds.minZ[index]
+			);
+			const glm::vec3 nearCorner(
+				plane.normal.x >= 0 ? bounds.minX[index] : bounds.maxX[index],
+				plane.normal.y >= 0 ? bounds.minY[index] : bounds.maxY[index],
+				plane.normal.z >= 0 ? bounds.minZ[index] : bounds.maxZ[index]
+			);
+			isVisible = isVisible && glm::dot(plane.normal, farCorner) + plane.distance >= 0;
+			isInside = isInside && glm::dot(plane.normal, nearCorner) + plane.distance >= 0;
+		}
+
+		if (isVisible) visible |= 1u << lane;
+		if (isInside) outFullyInside |= 1u << lane;
+	}
+
+	return visible;
+#endif
+}
+
+ChunkCuller::ChunkCuller() : lastColumnsTested(0), lastChunksTested(0), dirty(true) {
+
+}
+
+void ChunkCuller::add(const unsigned int id, const glm::ivec3& chunkPosition) {
+	if (entryIndices.contains(id)) {
+		entries[entryIndices[id]].chunkPosition = chunkPosition;
+	}
+	else {
+		entryIndices[id] = entries.size();
+		entries.push_back({ id, chunkPosition });
+	}
+	dirty = true;
+}
+
+void ChunkCuller::remove(const unsigned int id) {
+	const auto it = entryIndices.find(id);
+	if (it == entryIndices.end()) return;
+
+	// Swap with the last entry so removal stays O(1), order is restored by the sort in rebuild()
+	const unsigned int index = it->second;
+	entryIndices.erase(it);
+
+	if (index != entries.size() - 1) {
+		entries[index] = entries.back();
+		entryIndices[entries[index].id] = index;
+	}
+	entries.pop_back();
+	dirty = true;
+}
+
+unsigned int ChunkCuller::getChunkCount() const {
+	return entries.size();
+}
+
+void ChunkCuller::rebuild() {
+	dirty = false;
+
+	std::vector<Entry> sorted = entries;
+	std::sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) {
+		if (a.chunkPosition.x != b.chunkPosition.x) return a.chunkPosition.x < b.chunkPosition.x;
+		if (a.chunkPosition.z != b.chunkPosition.z) return a.chunkPosition.z < b.chunkPosition.z;
+		return a.chunkPosition.y < b.chunkPosition.y;
+	});
+
+	const float size = static_cast<float>(CHUNK_SIZE);
+
+	chunkBounds.resize(sorted.size());
+	chunkIds.resize(sorted.size());
+	columnFirstChunk.clear();
+	columnChunkCount.clear();
+
+	for (unsigned int i = 0; i < sorted.size(); i++) {
+		const glm::vec3 min = glm::vec3(sorted[i].chunkPosition) * size;
+		chunkBounds.set(i, min, min + glm::vec3(size));
+		chunkIds[i] = sorted[i].id;
+
+		const bool newColumn = i == 0
+			|| sorted[i].chunkPosition.x != sorted[i - 1].chunkPosition.x
+			|| sorted[i].chunkPosition.z != sorted[i - 1].chunkPosition.z;
+
+		if (newColumn) {
+			columnFirstChunk.push_back(i);
+			columnChunkCount.push_back(0);
+		}
+		columnChunkCount.back()++;
+	}
+
+	columnBounds.resize(columnFirstChunk.size());
+
+	for (unsigned int column = 0; column < columnFirstChunk.size(); column++) {
+		const unsigned int first = columnFirstChunk[column];
+		const unsigned int last = first + columnChunkCount[column] - 1;
+
+		// Chunks are sorted by y inside a column, the first and last give the vertical extent
+		const glm::vec3 min = glm::vec3(sorted[first].chunkPosition) * size;
+		const glm::vec3 max = glm::vec3(sorted[last].chunkPosition) * size + glm::vec3(size);
+		columnBounds.set(column, min, max);
+	}
+}
+
+void ChunkCuller::cull(const Plane* planes, std::vector<unsigned int>& outVisible) {
+	if (dirty) rebuild();
+
+	outVisible.clear();
+	lastColumnsTested = 0;
+	lastChunksTested = 0;
+
+	const unsigned int numColumns = columnFirstChunk.size();
+
+	for (unsigned int firstColumn = 0; firstColumn < numColumns; firstColumn += 8) {
+		const unsigned int columnLanes = std::min(8u, numColumns - firstColumn);
+		lastColumnsTested += columnLanes;
+
+		unsigned int columnsInside;
+		unsigned int visibleColumns = testBoxes8(columnBounds, firstColumn, planes, columnsInside) & ((1u << columnLanes) - 1);
+
+		while (visibleColumns != 0) {
+			const unsigned int lane = std::countr_zero(visibleColumns);
+			visibleColumns &= visibleColumns - 1;
+
+			const unsigned int column = firstColumn + lane;
+			const unsigned int first = columnFirstChunk[column];
+			const unsigned int end = first + columnChunkCount[column];
+
+			if (columnsInside & (1u << lane)) {
+				outVisible.insert(outVisible.end(), chunkIds.begin() + first, chunkIds.begin() + end);
+				continue;
+			}
+
+			for (unsigned int firstChunk = first; firstChunk < end; firstChunk += 8) {
+				const unsigned int chunkLanes = std::min(8u, end - firstChunk);
+				lastChunksTested += chunkLanes;
+
+				unsigned int chunksInside;
+				unsigned int visibleChunks = testBoxes8(chunkBounds, firstChunk, planes, chunksInside) & ((1u << chunkLanes) - 1);
+
+				while (visibleChunks != 0) {
+					outVisible.push_back(chunkIds[firstChunk + std::countr_zero(visibleChunks)]);
+					visibleChunks &= visibleChunks - 1;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+
+// Box bounds as structure of arrays, padded so 8 boxes can always be loaded from any index below the count
+struct BoundsSoA {
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	void resize(const unsigned int count);
+	void set(const unsigned int index, const glm::vec3& min, const glm::vec3& max);
+};
+
+/*
+Frustum culling for every loaded chunk.
+
+Chunks are grouped by column (same x and z). Columns are tested first, a column outside the frustum
+rejects all its chunks and a column fully inside accepts them without further tests. Only the chunks of
+columns crossing a plane are tested one by one. Tests run on 8 boxes at a time with AVX2.
+
+Chunks are identified by an id chosen by the caller, cull() returns the ids of the visible ones.
+*/
+class ChunkCuller {
+public:
+	ChunkCuller();
+
+	void add(const unsigned int id, const glm::ivec3& chunkPosition);
+	void remove(const unsigned int id);
+
+	void cull(const Plane* planes, std::vector<unsigned int>& outVisible);
+
+	unsigned int getChunkCount() const;
+
+	// Boxes tested by the last cull(), columns and chunks
+	unsigned int lastColumnsTested;
+	unsigned int lastChunksTested;
+
+private:
+	struct Entry {
+		unsigned int id;
+		glm::ivec3 chunkPosition;
+	};
+
+	void rebuild();
+
+	std::vector<Entry> entries;
+	std::unordered_map<unsigned int, unsigned int> entryIndices; // id -> index in entries
+	bool dirty;
+
+	// Rebuilt from entries, chunks sorted by column
+	BoundsSoA columnBounds;
+	std::vector<unsigned int> columnFirstChunk;
+	std::vector<unsigned int> columnChunkCount;
+	BoundsSoA chunkBounds;
+	std::vector<unsigned int> chunkIds;
+};
@@ -0,0 +1,145 @@
+#include "ChunkHalo.h"
+#include "Settings.h"
+#include "WorldStorage.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Chunk-local samples of a halo region along one axis: the neighbor's side of the border, or the chunk's own range
+static void getRegionRange(const int offset, int& first, unsigned int& count) {
+	if (offset < 0) {
+		first = -static_cast<int>(CHUNK_HALO);
+		count = CHUNK_HALO;
+	}
+	else if (offset > 0) {
+		first = CHUNK_SAMPLES;
+		count = CHUNK_HALO;
+	}
+	else {
+		first = 0;
+		count = CHUNK_SAMPLES;
+	}
+}
+
+static unsigned int toHaloIndex(const int x, const int y, const int z) {
+	return haloSampleIndex(x + CHUNK_HALO, y + CHUNK_HALO, z + CHUNK_HALO);
+}
+
+ChunkHalo::ChunkHalo() : densities(HALO_SAMPLES * HALO_SAMPLES * HALO_SAMPLES, 0.0f), copiedNeighbors(0) {
+
+}
+
+unsigned int ChunkHalo::getNeighborBit(const glm::ivec3& offset) {
+	return (offset.z + 1) + (offset.x + 1) * 3 + (offset.y + 1) * 9;
+}
+
+void ChunkHalo::copyNeighbor(const glm::ivec3& offset, const std::vector<float>& neighborDensities) {
+	glm::ivec3 first;
+	glm::uvec3 count;
+	getRegionRange(offset.x, first.x, count.x);
+	getRegionRange(offset.y, first.y, count.y);
+	getRegionRange(offset.z, first.z, count.z);
+
+	// Border samples are shared, the neighbor's sample 0 is this chunk's sample CHUNK_SIZE
+	const glm::ivec3 neighborShift = offset * static_cast<int>(CHUNK_SIZE);
+
+	for (int y = first.y; y < first.y + static_cast<int>(count.y); y++) {
+		for (int x = first.x; x < first.x + static_cast<int>(count.x); x++) {
+			for (int z = first.z; z < first.z + static_cast<int>(count.z); z++) {
+				densities[toHaloIndex(x, y, z)] = neighborDensities[sampleIndex(x - neighborShift.x, y - neighborShift.y, z - neighborShift.z)];
+			}
+		}
+	}
+
+	copiedNeighbors |= 1u << getNeighborBit(offset);
+}
+
+unsigned int ChunkHalo::finish(const glm::ivec3& chunkPosition, const std::vector<float>& chunkDensities, TerrainGenerator* generator, WorldStorage* worldStorage) {
+	// The chunk itself, one z row at a time
+	for (unsigned int y = 0; y < CHUNK_SAMPLES; y++) {
+		for (unsigned int x = 0; x < CHUNK_SAMPLES; x++) {
+			std::memcpy(&densities[toHaloIndex(x, y, 0)], &chunkDensities[sampleIndex(x, y, 0)], CHUNK_SAMPLES * sizeof(float));
+		}
+	}
+
+	unsigned int generatedRegions = 0;
+	std::vector<float> region;
+	TerrainDelta delta;
+
+	for (int offsetY = -1; offsetY <= 1; offsetY++) {
+		for (int offsetX = -1; offsetX <= 1; offsetX++) {
+			for (int offsetZ = -1; offsetZ <= 1; offsetZ++) {
+				const glm::ivec3 offset(offsetX, offsetY, offsetZ);
+				if (offset == glm::ivec3(0) || (copiedNeighbors & (1u << getNeighborBit(offset)))) continue;
+
+				glm::ivec3 first;
+				glm::uvec3 count;
+				getRegionRange(offset.x, first.x, count.x);
+				getRegionRange(offset.y, first.y, count.y);
+				getRegionRange(offset.z, first.z, count.z);
+
+				const glm::ivec3 origin = chunkPosition * static_cast<int>(CHUNK_SIZE) + first;
+				generator->generateDensities(origin.x, origin.y, origin.z, count.x, count.y, count.z, region);
+
+				for (unsigned int y = 0; y < count.y; y++) {
+					for (unsigned int x = 0; x < count.x; x++) {
+						for (unsigned int z = 0; z < count.z; z++) {
+							densities[toHaloIndex(first.x + x, first.y + y, first.z + z)] = region[z + x * count.z + y * count.x * count.z];
+						}
+					}
+				}
+
+				// Edited samples of the neighbor that fall in the region, in the neighbor's own sample coordinates
+				if (worldStorage->loadChunk(chunkPosition + offset, delta)) {
+					const glm::ivec3 neighborShift = offset * static_cast<int>(CHUNK_SIZE);
+					for (const auto& [index, sample] : delta.samples) {
+						const int x = (index / CHUNK_SAMPLES) % CHUNK_SAMPLES + neighborShift.x;
+						const int y = index / (CHUNK_SAMPLES * CHUNK_SAMPLES) + neighborShift.y;
+						const int z = index % CHUNK_SAMPLES + neighborShift.z;
+						if (x < first.x || x >= first.x + static_cast<int>(count.x)) continue;
+						if (y < first.y || y >= first.y + static_cast<int>(count.y)) continue;
+						if (z < first.z || z >= first.z + static_cast<int>(count.z)) continue;
+
+						densities[toHaloIndex(x, y, z)] = sample.density;
+					}
+				}
+				generatedRegions++;
+			}
+		}
+	}
+
+	copiedNeighbors = 0;
+	return generatedRegions;
+}
+
+glm::vec3 ChunkHalo::getGradient(const glm::vec3& position) const {
+	// Central differences at the two samples around the position, mesh vertices are on cell edges so a lerp is enough
+	const auto sampleGradient = [this](const int x, const int y, const int z) {
+		return glm::vec3(
+			densities[toHaloIndex(x + 1, y, z)] - densities[toHaloIndex(x - 1, y, z)],
+			densities[toHaloIndex(x, y + 1, z)] - densities[toHaloIndex(x, y - 1, z)],
+			densities[toHaloIndex(x, y, z + 1)] - densities[toHaloIndex(x, y, z - 1)]
+		) * 0.5f;
+	};
+
+	const glm::ivec3 base = glm::clamp(glm::ivec3(glm::floor(position)), glm::ivec3(0), glm::ivec3(CHUNK_SIZE));
+	const glm::vec3 fraction = position - glm::vec3(base);
+
+	glm::ivec3 next = base;
+	float t = 0.0f;
+	if (fraction.x > 0.0f) {
+		next.x++;
+		t = fraction.x;
+	}
+	else if (fraction.y > 0.0f) {
+		next.y++;
+		t = fraction.y;
+	}
+	else if (fraction.z > 0.0f) {
+		next.z++;
+		t = fraction.z;
+	}
+	next = glm::min(next, glm::ivec3(CHUNK_SIZE));
+
+	return glm::mix(sampleGradient(base.x, base.y, base.z), sampleGradient(next.x, next.y, next.z), t);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "TerrainGenerator.h"
+
+class WorldStorage;
+
+/*
+A chunk's densities with CHUNK_HALO more samples on every side, so density gradients are defined up to the
+chunk's border. Chunk grids stay CHUNK_SAMPLES^3, the halo is built for meshing only.
+
+Each of the 26 neighbors covers one region of the halo: a face, an edge or a corner. The main thread copies
+the regions of the neighbors that were already generated, then the worker meshing the chunk copies the chunk
+itself into the middle and generates only the regions whose neighbor wasn't there. A generated region gets the
+neighbor's saved edits on top, like the neighbor itself will when it loads.
+*/
+class ChunkHalo {
+public:
+	ChunkHalo();
+
+	void copyNeighbor(const glm::ivec3& offset, const std::vector<float>& neighborDensities); // offset in [-1, 1], not 0
+	unsigned int finish(const glm::ivec3& chunkPosition, const std::vector<float>& chunkDensities, TerrainGenerator* generator, WorldStorage* worldStorage); // Returns the regions generated
+
+	glm::vec3 getGradient(const glm::vec3& position) const; // Chunk-local, points towards the solid side
+
+	std::vector<float> densities; // HALO_SAMPLES^3, by haloSampleIndex()
+	uint32_t copiedNeighbors; // Bit per neighbor, see getNeighborBit()
+
+	static unsigned int getNeighborBit(const glm::ivec3& offset);
+};
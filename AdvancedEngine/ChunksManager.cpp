@@ -1,97 +1,763 @@
 #include "ChunksManager.h"
+#include "Settings.h"
+#include "Profiler.h"
 #include <iostream>
 #include <algorithm>
+#include <climits>
+#include <cmath>
 
 const unsigned int RENDER_DISTANCE = 6;
-
-inline std::size_t hashVec3(const glm::vec3& v) {
-	return std::hash<int>()(static_cast<int>(v.x))
-		^ (std::hash<int>()(static_cast<int>(v.y)) << 1)
-		^ (std::hash<int>()(static_cast<int>(v.z)) << 2);
+const unsigned int UNLOAD_DISTANCE = RENDER_DISTANCE + 1; // Chunks load within RENDER_DISTANCE and unload past this, so walking along a chunk border doesn't churn
+const unsigned int FORGET_DISTANCE = UNLOAD_DISTANCE + 3; // Known terrain past this is dropped from memory, its edits are on disk. Prefetching stays within it
+const unsigned int MAX_POOLED_CHUNKS = 128;
+const char* WORLD_DIRECTORY = "world"; // Terrain edits are saved here, on top of the generated terrain
+
+// Starting size of the shared terrain buffers, they double when full
+const unsigned int TERRAIN_ARENA_VERTICES = 1 << 20;
+const unsigned int TERRAIN_ARENA_INDICES = 1 << 20;
+
+const unsigned int STAGING_RING_SIZE = 32 * 1024 * 1024;
+// Jobs queued per worker, enough to keep them busy without queueing chunks that may be out of range by the time they run
+const unsigned int CHUNK_JOBS_PER_WORKER = 2;
+
+// Prefetch: the player's path is extrapolated this far ahead, sampled every half chunk
+const float PREFETCH_SECONDS = 3.0f;
+const float PREFETCH_MIN_SPEED = 4.0f; // Meters per second, slower than this the loader keeps up
+const float PREFETCH_CAMERA_WEIGHT = 0.5f; // How much the path bends towards where the player looks
+const unsigned int PREFETCH_JOBS_PER_WORKER = 1;
+
+// Software occlusion: resolution of the depth buffer, and the chunks around the camera rasterized as occluders
+const unsigned int OCCLUSION_WIDTH = 256;
+const unsigned int OCCLUSION_HEIGHT = 128;
+const unsigned int OCCLUDER_DISTANCE = 2;
+const unsigned int OCCLUSION_BANDS = 8; // Rows are split in bands rasterized in parallel
+const unsigned int OCCLUSION_TESTS_PER_TASK = 64;
+
+const char* getChunkStateName(const ChunkState state) {
+	switch (state) {
+	case ChunkState::Queued: return "Queued";
+	case ChunkState::Generating: return "Generating";
+	case ChunkState::Generated: return "Generated";
+	case ChunkState::Meshing: return "Meshing";
+	case ChunkState::Meshed: return "Meshed";
+	case ChunkState::Cooking: return "Cooking";
+	case ChunkState::Uploaded: return "Uploaded";
+	case ChunkState::Unloading: return "Unloading";
+	}
+	return "Unknown";
 }
 
-ChunksManager::ChunksManager(Camera* camera, PhysicsEngine* physicsEngine) : camera(camera), physicsEngine(physicsEngine) {
+ChunksManager::ChunksManager(Camera* camera, PhysicsEngine* physicsEngine, Player* player) : camera(camera), physicsEngine(physicsEngine), player(player), physicsRadius(PHYSICS_RADIUS), collisionMode(ChunkCollisionMode::DensityField), occlusionCulling(true), lastOccludedChunks(0), lastDrawCount(0), lastHorizonDrawCount(0), lastTriangleCount(0), lastEditedChunks(0), prefetchedChunks(0), prefetchHits(0), loaderGeneratedChunks(0), chunksAllocated(0), chunksRecycled(0), cancelledChunkJobs(0), staleChunkResults(0), nextChunkGeneration(0), chunksUnloading(0), haloRegionsCopied(0), haloRegionsGenerated(0), voxelBufferCopies(0), forgottenChunks(0) {
 	createOffsetsCache();
 
 	terrainGenerator = new TerrainGenerator();
 	terrainMaterial = new TerrainGBufferMaterial();
+	terrainGeometry = new TerrainGeometryArena(terrainMaterial->vertexAttributes, TERRAIN_ARENA_VERTICES, TERRAIN_ARENA_INDICES);
+	stagingRing = new StagingRing(STAGING_RING_SIZE);
+	chunkCuller = new ChunkCuller();
+	occlusionBuffer = new OcclusionBuffer(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+
+	// Leave one core for the main thread
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	workerPool = new WorkerPool(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+	worldStorage = new WorldStorage(WORLD_DIRECTORY);
+
+	// Takes over a chunk and a half inside the loaded sphere, where the chunks at its edge may still be missing
+	horizonTerrain = new HorizonTerrain(terrainGenerator, workerPool, (RENDER_DISTANCE - 1.5f) * CHUNK_SIZE);
 
 	// Initialize textures
 
 
 
 	meshGenerator = new MarchingCubeGenerator(0.5f);
+	voxelQueries = new VoxelQueries(0.5f);
+}
+
+ChunksManager::~ChunksManager() {
+	if (prefetchedChunks > 0) {
+		std::cout << "Prefetched " << prefetchedChunks << " chunks, " << prefetchHits << " were used by the loader ("
+			<< 100.0f * prefetchHits / prefetchedChunks << "% hit rate), it generated " << loaderGeneratedChunks << " chunks itself" << std::endl;
+	}
+	if (haloRegionsCopied + haloRegionsGenerated > 0) {
+		std::cout << "Chunk halos: " << haloRegionsCopied << " neighbor regions copied, " << haloRegionsGenerated << " generated" << std::endl;
+	}
+	if (voxelBufferCopies > 0) {
+		std::cout << "Edits copied " << voxelBufferCopies << " voxel buffers" << std::endl;
+	}
+	if (forgottenChunks > 0) {
+		std::cout << "Forgot the terrain of " << forgottenChunks << " far chunks, " << knownChunks.size() << " still known" << std::endl;
+	}
+
+	// The workers use the generators, the storage and the staging ring, stop them first
+	delete workerPool;
+	delete worldStorage;
+	delete horizonTerrain;
+
+	for (const FinishedChunk& finished : finishedChunks) {
+		delete finished.chunk;
+	}
+	for (const auto& [key, chunk] : loadedChunks) {
+		delete chunk;
+	}
+	for (Chunk* chunk : chunkPool) {
+		delete chunk;
+	}
+
+	delete occlusionBuffer;
+	delete chunkCuller;
+	delete stagingRing;
+	delete terrainGeometry;
+	delete meshGenerator;
+	delete voxelQueries;
+	delete terrainGenerator;
 }
 
-TerrainChunkData ChunksManager::generateChunk(const glm::vec3& chunkPosition) {
-	GeneratedTerrainResult result = terrainGenerator->generateTerrain(chunkPosition.x, chunkPosition.y, chunkPosition.z);
+TerrainChunkData ChunksManager::loadChunkData(const glm::vec3& chunkPosition) {
+	GeneratedTerrainResult terrain;
+	{
+		PROFILE_ZONE("Generate chunk");
+		terrain = terrainGenerator->generateTerrain(chunkPosition.x, chunkPosition.y, chunkPosition.z);
+	}
 
-	return {
+	TerrainChunkData chunkData = {
 		.x = static_cast<int>(chunkPosition.x),
 		.y = static_cast<int>(chunkPosition.y),
-		.z = static_cast<int>(chunkPosition.z),
-		.densities = result.densities,
-		.materials = result.materials
+		.z = static_cast<int>(chunkPosition.z)
 	};
+
+	// Only edited chunks are saved, their edits go on top of the generated terrain while it isn't shared yet
+	if (worldStorage->loadChunk(glm::ivec3(chunkPosition), chunkData.edits)) {
+		chunkData.edits.apply(terrain.densities, terrain.materials);
+	}
+
+	// The generator's vectors are moved in, this is the only copy of the samples from now on
+	chunkData.voxels = std::make_shared<const VoxelBuffer>(VoxelBuffer{ std::move(terrain.densities), std::move(terrain.materials) });
+	return chunkData;
 }
 
 void ChunksManager::tick(const glm::vec3& currentChunkPosition) {
+	PROFILE_ZONE("ChunksManager::tick");
+
+	loadAndUnloadChunks(currentChunkPosition);
+	applyPendingEdits();
+	updatePhysicsChunks();
+	horizonTerrain->update(camera->position);
+}
+
+void ChunksManager::queueEdit(const TerrainEdit& edit) {
+	pendingEdits.push_back(edit);
+}
+
+VoxelHit ChunksManager::raycast(const VoxelRay& ray) const {
+	return voxelQueries->raycast(ray);
+}
+
+void ChunksManager::raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const {
+	voxelQueries->raycast(rays, hits, count, workerPool);
+}
+
+void ChunksManager::sphereSweep(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, const float radius) const {
+	voxelQueries->sphereSweep(rays, hits, count, radius, workerPool);
+}
+
+void ChunksManager::applyPendingEdits() {
+	lastEditedChunks = 0;
+	if (pendingEdits.empty()) return;
+
+	PROFILE_ZONE("Apply terrain edits");
+
+	// Every chunk is remeshed, saved and recooked at most once, however many edits touched it this frame
+	struct DirtyChunk {
+		glm::ivec3 chunkPosition;
+		TerrainChunkData* data;
+		std::shared_ptr<VoxelBuffer> voxels; // Copy of data->voxels taking every edit of the frame, then swapped in. nullptr when only the halo changed
+		Chunk* chunk; // nullptr when the chunk is known but not loaded
+		glm::ivec3 sampleMin;
+		glm::ivec3 sampleMax;
+	};
+	std::unordered_map<uint64_t, DirtyChunk> dirtyChunks;
+	std::vector<TerrainEdit> deferredEdits;
+
+	for (const TerrainEdit& edit : pendingEdits) {
+		glm::vec3 boundsMin, boundsMax;
+		getTerrainEditBounds(edit, boundsMin, boundsMax);
+
+		// Border samples are shared, a chunk's samples cover [position * CHUNK_SIZE, position * CHUNK_SIZE + CHUNK_SIZE]
+		const glm::ivec3 firstChunk = glm::ivec3(
+			static_cast<int>(std::ceil((boundsMin.x - CHUNK_SIZE) / CHUNK_SIZE)),
+			static_cast<int>(std::ceil((boundsMin.y - CHUNK_SIZE) / CHUNK_SIZE)),
+			static_cast<int>(std::ceil((boundsMin.z - CHUNK_SIZE) / CHUNK_SIZE))
+		);
+		const glm::ivec3 lastChunk = glm::ivec3(
+			static_cast<int>(std::floor(boundsMax.x / CHUNK_SIZE)),
+			static_cast<int>(std::floor(boundsMax.y / CHUNK_SIZE)),
+			static_cast<int>(std::floor(boundsMax.z / CHUNK_SIZE))
+		);
+
+		// A chunk on a worker works on a copy of its terrain and of its neighbors' borders, wait for it to land so the edit isn't lost
+		bool touchesChunkInFlight = false;
+		for (int y = firstChunk.y - 1; y <= lastChunk.y + 1 && !touchesChunkInFlight; y++) {
+			for (int x = firstChunk.x - 1; x <= lastChunk.x + 1 && !touchesChunkInFlight; x++) {
+				for (int z = firstChunk.z - 1; z <= lastChunk.z + 1 && !touchesChunkInFlight; z++) {
+					const uint64_t key = packChunkPosition(glm::ivec3(x, y, z));
+					touchesChunkInFlight = chunksInFlight.contains(key) || chunksPrefetching.contains(key);
+				}
+			}
+		}
+		if (touchesChunkInFlight) {
+			deferredEdits.push_back(edit);
+			continue;
+		}
+
+		for (int y = firstChunk.y; y <= lastChunk.y; y++) {
+			for (int x = firstChunk.x; x <= lastChunk.x; x++) {
+				for (int z = firstChunk.z; z <= lastChunk.z; z++) {
+					const glm::ivec3 chunkPosition(x, y, z);
+					const uint64_t key = packChunkPosition(glm::ivec3(chunkPosition));
+
+					// Never generated, out of range of the player anyway
+					const auto known = knownChunks.find(key);
+					if (known == knownChunks.end()) continue;
+
+					// Copy-on-write, once per chunk and frame: the loaded chunk, its collision shape and the queries keep reading the old samples
+					const auto dirty = dirtyChunks.find(key);
+					std::shared_ptr<VoxelBuffer> voxels;
+					if (dirty != dirtyChunks.end()) {
+						voxels = dirty->second.voxels;
+					}
+					else {
+						voxels = std::make_shared<VoxelBuffer>(*known->second.voxels);
+						voxelBufferCopies++;
+					}
+
+					glm::ivec3 sampleMin, sampleMax;
+					if (!applyTerrainEdit(edit, chunkPosition, voxels->densities, voxels->materials, known->second.edits, sampleMin, sampleMax)) continue;
+
+					if (dirty == dirtyChunks.end()) {
+						const auto loaded = loadedChunks.find(key);
+						Chunk* chunk = loaded != loadedChunks.end() ? loaded->second : nullptr;
+						dirtyChunks[key] = { chunkPosition, &known->second, voxels, chunk, sampleMin, sampleMax };
+					}
+					else {
+						DirtyChunk& dirtyChunk = dirty->second;
+						dirtyChunk.sampleMin = glm::ivec3(std::min(dirtyChunk.sampleMin.x, sampleMin.x), std::min(dirtyChunk.sampleMin.y, sampleMin.y), std::min(dirtyChunk.sampleMin.z, sampleMin.z));
+						dirtyChunk.sampleMax = glm::ivec3(std::max(dirtyChunk.sampleMax.x, sampleMax.x), std::max(dirtyChunk.sampleMax.y, sampleMax.y), std::max(dirtyChunk.sampleMax.z, sampleMax.z));
+					}
+				}
+			}
+		}
+	}
+	pendingEdits.swap(deferredEdits);
+
+	if (dirtyChunks.empty()) return;
+
+	// Samples within CHUNK_HALO of a face are in the neighbors' halos, their gradients and border normals change too.
+	// Ranges are in the neighbor's samples, the remesh below clamps them to its cells
+	std::vector<DirtyChunk> haloNeighbors;
+	for (const auto& [key, dirtyChunk] : dirtyChunks) {
+		for (int y = -1; y <= 1; y++) {
+			for (int x = -1; x <= 1; x++) {
+				for (int z = -1; z <= 1; z++) {
+					const glm::ivec3 offset(x, y, z);
+					if (offset == glm::ivec3(0)) continue;
+
+					bool reachesNeighbor = true;
+					for (int axis = 0; axis < 3; axis++) {
+						if (offset[axis] < 0 && dirtyChunk.sampleMin[axis] > static_cast<int>(CHUNK_HALO)) reachesNeighbor = false;
+						if (offset[axis] > 0 && dirtyChunk.sampleMax[axis] < static_cast<int>(CHUNK_SIZE - CHUNK_HALO)) reachesNeighbor = false;
+					}
+					if (!reachesNeighbor) continue;
+
+					const glm::ivec3 neighborPosition = dirtyChunk.chunkPosition + offset;
+					const auto loaded = loadedChunks.find(packChunkPosition(glm::ivec3(neighborPosition)));
+					if (loaded == loadedChunks.end() || loaded->second == nullptr) continue;
+
+					const glm::ivec3 shift = offset * static_cast<int>(CHUNK_SIZE);
+					haloNeighbors.push_back({ neighborPosition, nullptr, nullptr, loaded->second, dirtyChunk.sampleMin - shift, dirtyChunk.sampleMax - shift });
+				}
+			}
+		}
+	}
+	for (const DirtyChunk& neighbor : haloNeighbors) {
+		const auto [dirty, inserted] = dirtyChunks.try_emplace(packChunkPosition(glm::ivec3(neighbor.chunkPosition)), neighbor);
+		if (!inserted) {
+			DirtyChunk& dirtyChunk = dirty->second;
+			dirtyChunk.sampleMin = glm::ivec3(std::min(dirtyChunk.sampleMin.x, neighbor.sampleMin.x), std::min(dirtyChunk.sampleMin.y, neighbor.sampleMin.y), std::min(dirtyChunk.sampleMin.z, neighbor.sampleMin.z));
+			dirtyChunk.sampleMax = glm::ivec3(std::max(dirtyChunk.sampleMax.x, neighbor.sampleMax.x), std::max(dirtyChunk.sampleMax.y, neighbor.sampleMax.y), std::max(dirtyChunk.sampleMax.z, neighbor.sampleMax.z));
+		}
+	}
+
+	std::vector<DirtyChunk*> chunks;
+	std::vector<ChunkHalo> halos;
+	for (auto& [key, dirtyChunk] : dirtyChunks) {
+		chunks.push_back(&dirtyChunk);
+		if (dirtyChunk.voxels == nullptr) continue;
+
+		dirtyChunk.data->voxels = dirtyChunk.voxels;
+		voxelQueries->setChunk(dirtyChunk.chunkPosition, dirtyChunk.voxels);
+		if (dirtyChunk.chunk != nullptr) {
+			dirtyChunk.chunk->voxels = dirtyChunk.voxels;
+		}
+	}
+
+	// After every edit of the frame, so the neighbors' samples are the edited ones
+	halos.resize(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (chunks[i]->chunk != nullptr) {
+			gatherHalo(chunks[i]->chunkPosition, halos[i]);
+		}
+	}
+
+	// Saving and meshing are independent per chunk, the workers take them
+	workerPool->parallelFor(chunks.size(), [this, &chunks, &halos](const unsigned int task) {
+		DirtyChunk& dirtyChunk = *chunks[task];
+		if (dirtyChunk.voxels != nullptr) {
+			worldStorage->saveChunk(dirtyChunk.chunkPosition, dirtyChunk.data->edits);
+		}
+
+		if (dirtyChunk.chunk == nullptr) return;
+		haloRegionsGenerated += halos[task].finish(dirtyChunk.chunkPosition, dirtyChunk.chunk->voxels->densities, terrainGenerator, worldStorage);
+
+		// A sample is a corner of the cells on both sides of it, and is in the gradient of the samples next to it
+		const glm::ivec3 cellMin = glm::ivec3(std::max(dirtyChunk.sampleMin.x - 2, 0), std::max(dirtyChunk.sampleMin.y - 2, 0), std::max(dirtyChunk.sampleMin.z - 2, 0));
+		const glm::ivec3 cellMax = glm::ivec3(
+			std::min(dirtyChunk.sampleMax.x + 2, static_cast<int>(CHUNK_SIZE)),
+			std::min(dirtyChunk.sampleMax.y + 2, static_cast<int>(CHUNK_SIZE)),
+			std::min(dirtyChunk.sampleMax.z + 2, static_cast<int>(CHUNK_SIZE))
+		);
+		dirtyChunk.chunk->remesh(meshGenerator, stagingRing, halos[task], cellMin, cellMax);
+	});
+
+	for (DirtyChunk* dirtyChunk : chunks) {
+		Chunk* chunk = dirtyChunk->chunk;
+		if (chunk == nullptr) continue;
+
+		chunk->uploadMesh(terrainGeometry, physicsEngine);
+		if (chunk->hasGeometry()) {
+			chunkCuller->add(chunk->cullId, glm::ivec3(chunk->chunkPosition));
+		}
+		else {
+			chunkCuller->remove(chunk->cullId);
+		}
+
+		// Cooked again by updatePhysicsChunks right after. A halo change moves no vertex, the shape stays
+		if (dirtyChunk->voxels != nullptr) {
+			chunk->releasePhysics();
+		}
+		lastEditedChunks++;
+	}
+}
+
+void ChunksManager::loadAndUnloadChunks(const glm::vec3& currentChunkPosition) {
 	
-	const std::vector<glm::vec3> loadList = createLoadList(currentChunkPosition, true); // Returns multiple values, add the ability to load multiple chunks per frame in the future (multithreading?)
+	uploadFinishedChunks();
+	cancelChunkJobs(currentChunkPosition);
+	submitChunkJobs(currentChunkPosition);
+	prefetchChunks(currentChunkPosition);
+
+	std::vector<uint64_t> keysToUnload;
+
+	for (const auto& [key, chunk] : loadedChunks) {
+
+		if (chunk == nullptr) continue;
+
+		if (glm::length(chunk->chunkPosition - currentChunkPosition) > static_cast<float>(UNLOAD_DISTANCE)) {
+			releaseChunkSlot(chunk);
+			recycleChunk(chunk);
+			loadedChunks[key] = nullptr;
+			keysToUnload.push_back(key);
+		}
+	}
+
+	for (const uint64_t key : keysToUnload) {
+		loadedChunks.erase(key);
+	}
+
+	forgetFarChunks(currentChunkPosition);
+}
+
+void ChunksManager::forgetFarChunks(const glm::vec3& currentChunkPosition) {
+	// Jobs and shapes still holding a buffer keep it until they are done with it
+	for (auto it = knownChunks.begin(); it != knownChunks.end();) {
+		const TerrainChunkData& data = it->second;
+		const glm::ivec3 chunkPosition(data.x, data.y, data.z);
+		if (glm::length(glm::vec3(chunkPosition) - currentChunkPosition) <= static_cast<float>(FORGET_DISTANCE)) {
+			++it;
+			continue;
+		}
+
+		voxelQueries->setChunk(chunkPosition, nullptr);
+		prefetchedUnused.erase(it->first);
+		it = knownChunks.erase(it);
+		forgottenChunks++;
+	}
+}
+
+void ChunksManager::submitChunkJobs(const glm::vec3& currentChunkPosition) {
+	const unsigned int maxChunksInFlight = workerPool->getThreadCount() * CHUNK_JOBS_PER_WORKER;
+	if (chunksInFlight.size() >= maxChunksInFlight) return;
+
+	const std::vector<glm::vec3> loadList = createLoadList(currentChunkPosition, true);
 
 	if (loadList.empty()) return;
 
-	std::cout << "# Chunks left to load: " << loadList.size() << std::endl;
+	for (const glm::vec3& chunkToLoad : loadList) {
+		if (chunksInFlight.size() >= maxChunksInFlight) break;
+
+		const uint64_t key = packChunkPosition(glm::ivec3(chunkToLoad));
+		const std::shared_ptr<ChunkJob> job = std::make_shared<ChunkJob>();
+		job->chunkPosition = chunkToLoad;
+		job->generation = nextChunkGeneration++;
+		job->state = ChunkState::Queued;
+		job->cancelled = false;
+		chunksInFlight[key] = job;
+
+		// Known terrain is shared with the job, the workers never touch knownChunks
+		const auto known = knownChunks.find(key);
+		const bool isKnown = known != knownChunks.end();
+		std::shared_ptr<const VoxelBuffer> voxels = isKnown ? known->second.voxels : nullptr;
+		if (isKnown) {
+			if (prefetchedUnused.erase(key) > 0) prefetchHits++;
+		}
+		else {
+			loaderGeneratedChunks++;
+		}
+		const ChunkCollisionMode chunkCollisionMode = collisionMode;
+
+		// The neighbors' borders are copied now, the worker generates the ones that are missing
+		ChunkHalo halo;
+		gatherHalo(chunkToLoad, halo);
+
+		workerPool->submit([this, job, isKnown, voxels, chunkCollisionMode, halo = std::move(halo)]() mutable {
+			// Cancelled while queued, the main thread only needs to hear that the job is over
+			if (job->cancelled) {
+				std::lock_guard<std::mutex> lock(finishedChunksMutex);
+				finishedChunks.push_back({ job, nullptr });
+				return;
+			}
 
-	// Load one chunk. Only one. FOr now...
+			TerrainChunkData chunkData;
+			if (!isKnown) {
+				job->state = ChunkState::Generating;
+				chunkData = loadChunkData(job->chunkPosition);
+				voxels = chunkData.voxels;
+				job->state = ChunkState::Generated;
+			}
 
-	const glm::vec3& chunkToLoad = loadList[0];
-	const size_t hash = hashVec3(chunkToLoad);
+			// The generated terrain is still worth keeping, but not the meshing
+			Chunk* newChunk = nullptr;
+			if (!job->cancelled) {
+				job->state = ChunkState::Meshing;
+				newChunk = acquireChunk(job->chunkPosition, voxels);
+				newChunk->collisionMode = chunkCollisionMode;
+				haloRegionsGenerated += halo.finish(glm::ivec3(job->chunkPosition), voxels->densities, terrainGenerator, worldStorage);
+				newChunk->buildMesh(meshGenerator, stagingRing, halo);
+				job->state = ChunkState::Meshed;
+			}
 
-	if (knownChunks.contains(hash) == false) {
-		// Generate chunk
-		knownChunks[hash] = generateChunk(chunkToLoad);
+			std::lock_guard<std::mutex> lock(finishedChunksMutex);
+			finishedChunks.push_back({ job, newChunk });
+			if (!isKnown) {
+				finishedChunkData.push_back(std::move(chunkData));
+			}
+		});
 	}
+}
+
+void ChunksManager::gatherHalo(const glm::vec3& chunkPosition, ChunkHalo& halo) {
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			for (int z = -1; z <= 1; z++) {
+				if (x == 0 && y == 0 && z == 0) continue;
 
-	// Load the chunk
+				const auto neighbor = knownChunks.find(packChunkPosition(glm::ivec3(chunkPosition + glm::vec3(x, y, z))));
+				if (neighbor == knownChunks.end()) continue;
 
-	// TODO: load it with marching cubes generator
+				halo.copyNeighbor(glm::ivec3(x, y, z), neighbor->second.voxels->densities);
+				haloRegionsCopied++;
+			}
+		}
+	}
+}
 
+void ChunksManager::cancelChunkJobs(const glm::vec3& currentChunkPosition) {
+	// Same distance as unloading, a chunk that would be kept if it were loaded keeps its job
+	for (auto it = chunksInFlight.begin(); it != chunksInFlight.end();) {
+		ChunkJob& job = *it->second;
+		if (glm::length(job.chunkPosition - currentChunkPosition) <= static_cast<float>(UNLOAD_DISTANCE)) {
+			++it;
+			continue;
+		}
 
-	const TerrainChunkData& chunkData = knownChunks[hash];
+		// Queued jobs return as soon as a worker picks them up, running ones stop at their next step
+		job.cancelled = true;
+		cancelledChunkJobs++;
+		chunksUnloading++;
+		it = chunksInFlight.erase(it);
+	}
+}
 
-	Chunk* newChunk = new Chunk(chunkToLoad, chunkData.densities, chunkData.materials);
-	newChunk->buildChunk(terrainMaterial, meshGenerator, camera, physicsEngine);
-	if (newChunk->chunkBody != nullptr) {
-		physicsEngine->addObject(newChunk->chunkBody);
+std::array<unsigned int, CHUNK_STATE_COUNT> ChunksManager::getChunkStateCounts() const {
+	std::array<unsigned int, CHUNK_STATE_COUNT> counts = {};
+	for (const auto& [key, job] : chunksInFlight) {
+		counts[static_cast<unsigned int>(job->state.load())]++;
 	}
+	counts[static_cast<unsigned int>(ChunkState::Uploaded)] = loadedChunks.size();
+	counts[static_cast<unsigned int>(ChunkState::Unloading)] = chunksUnloading;
+	return counts;
+}
 
+void ChunksManager::prefetchChunks(const glm::vec3& currentChunkPosition) {
+	// The loader comes first, prefetching only takes workers it leaves idle
+	if (chunksInFlight.size() >= workerPool->getThreadCount() * CHUNK_JOBS_PER_WORKER) return;
 
-	loadedChunks[hash] = newChunk;
+	const unsigned int maxPrefetching = workerPool->getThreadCount() * PREFETCH_JOBS_PER_WORKER;
+	if (chunksPrefetching.size() >= maxPrefetching) return;
 
-	// Unload any
+	const JPH::Vec3 bodyVelocity = physicsEngine->bodyReadVelocity(*player->playerBody);
+	const glm::vec3 velocity(bodyVelocity.GetX(), bodyVelocity.GetY(), bodyVelocity.GetZ());
+	const float speed = glm::length(velocity);
+	if (speed < PREFETCH_MIN_SPEED) return;
 
-	const std::vector<glm::vec3> fullLoadList = createLoadList(currentChunkPosition, false);
+	PROFILE_ZONE("Prefetch chunks");
 
-	std::vector<size_t> hashesToUnload;
+	const glm::vec3 direction = glm::normalize(velocity / speed + camera->direction * PREFETCH_CAMERA_WEIGHT);
+	const float pathLength = speed * PREFETCH_SECONDS;
+	const float pathStep = CHUNK_SIZE * 0.5f;
+	const float renderDistance = static_cast<float>(RENDER_DISTANCE);
 
-	for (const auto& [hash, chunk] : loadedChunks) {
+	// Walks the path from the nearest point, so the chunks needed soonest are queued first
+	glm::vec3 lastPathChunk = currentChunkPosition;
+	for (float distance = pathStep; distance <= pathLength; distance += pathStep) {
+		const glm::vec3 pathChunk = glm::floor((camera->position + direction * distance) / static_cast<float>(CHUNK_SIZE));
+		if (pathChunk == lastPathChunk) continue;
+		lastPathChunk = pathChunk;
 
-		if (chunk == nullptr) continue;
+		for (const glm::vec3& offset : loadChunksOffsets) {
+			const glm::vec3 chunkPosition = pathChunk + offset;
+
+			// In range now: the loader's job. Past FORGET_DISTANCE it would be dropped right away
+			const float chunkDistance = glm::length(chunkPosition - currentChunkPosition);
+			if (chunkDistance <= renderDistance || chunkDistance > static_cast<float>(FORGET_DISTANCE)) continue;
+
+			const uint64_t key = packChunkPosition(glm::ivec3(chunkPosition));
+			if (knownChunks.contains(key) || chunksInFlight.contains(key) || chunksPrefetching.contains(key)) continue;
+
+			chunksPrefetching.insert(key);
+			workerPool->submit([this, chunkPosition]() {
+				TerrainChunkData chunkData = loadChunkData(chunkPosition);
+
+				std::lock_guard<std::mutex> lock(finishedChunksMutex);
+				finishedChunkData.push_back(std::move(chunkData));
+			});
+
+			if (chunksPrefetching.size() >= maxPrefetching) return;
+		}
+	}
+}
+
+void ChunksManager::uploadFinishedChunks() {
+	PROFILE_ZONE("Upload chunks");
+	PROFILE_GPU_ZONE("Upload chunks");
+
+	std::vector<FinishedChunk> chunks;
+	std::vector<TerrainChunkData> chunkData;
+	{
+		std::lock_guard<std::mutex> lock(finishedChunksMutex);
+		chunks.swap(finishedChunks);
+		chunkData.swap(finishedChunkData);
+	}
+
+	for (TerrainChunkData& data : chunkData) {
+		const uint64_t key = packChunkPosition(glm::ivec3(data.x, data.y, data.z));
+		// A cancelled job and the one that requested the chunk again may both generate it, the first one wins
+		// so that edits applied in between aren't overwritten
+		const glm::ivec3 chunkPosition(data.x, data.y, data.z);
+		const auto [known, inserted] = knownChunks.try_emplace(key, std::move(data));
+		if (inserted) {
+			voxelQueries->setChunk(chunkPosition, known->second.voxels);
+		}
+
+		if (chunksPrefetching.erase(key) > 0) {
+			prefetchedChunks++;
+			prefetchedUnused.insert(key);
+		}
+	}
+
+	for (const FinishedChunk& finished : chunks) {
+		const uint64_t key = packChunkPosition(glm::ivec3(finished.job->chunkPosition));
+
+		const auto current = chunksInFlight.find(key);
+		if (current == chunksInFlight.end() || current->second->generation != finished.job->generation) {
+			// Stale: cancelled, and maybe requested again since
+			chunksUnloading--;
+			if (finished.chunk != nullptr) {
+				recycleChunk(finished.chunk);
+				staleChunkResults++;
+			}
+			continue;
+		}
+
+		finished.job->state = ChunkState::Cooking;
+		finished.chunk->uploadMesh(terrainGeometry, physicsEngine);
+		addLoadedChunk(key, finished.chunk); // Counted as Uploaded from now on
+		chunksInFlight.erase(current);
+	}
+
+	// Fences the copies issued above so their staging memory can be reused
+	stagingRing->endFrame();
+}
+
+void ChunksManager::addLoadedChunk(const uint64_t key, Chunk* chunk) {
+	if (freeChunkSlots.empty()) {
+		chunk->cullId = chunkSlots.size();
+		chunkSlots.push_back(chunk);
+	}
+	else {
+		chunk->cullId = freeChunkSlots.back();
+		freeChunkSlots.pop_back();
+		chunkSlots[chunk->cullId] = chunk;
+	}
+
+	// Empty chunks have nothing to draw, keep them out of the culler
+	if (chunk->hasGeometry()) {
+		chunkCuller->add(chunk->cullId, glm::ivec3(chunk->chunkPosition));
+	}
+
+	loadedChunks[key] = chunk;
+}
+
+void ChunksManager::releaseChunkSlot(Chunk* chunk) {
+	chunkCuller->remove(chunk->cullId);
+	chunkSlots[chunk->cullId] = nullptr;
+	freeChunkSlots.push_back(chunk->cullId);
+}
+
+Chunk* ChunksManager::acquireChunk(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels) {
+	Chunk* chunk = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(chunkPoolMutex);
+		if (!chunkPool.empty()) {
+			chunk = chunkPool.back();
+			chunkPool.pop_back();
+		}
+	}
+
+	if (chunk == nullptr) {
+		chunksAllocated++;
+		return new Chunk(chunkPosition, voxels);
+	}
+
+	chunksRecycled++;
+	chunk->reset(chunkPosition, voxels);
+	return chunk;
+}
+
+void ChunksManager::recycleChunk(Chunk* chunk) {
+	chunk->releaseResources();
+	chunk->voxels = nullptr; // Pooled chunks don't keep unloaded terrain alive
+
+	{
+		std::lock_guard<std::mutex> lock(chunkPoolMutex);
+		if (chunkPool.size() < MAX_POOLED_CHUNKS) {
+			chunkPool.push_back(chunk);
+			return;
+		}
+	}
+	delete chunk;
+}
+
+void ChunksManager::cullOccludedChunks() {
+	const glm::ivec3 cameraChunk = glm::ivec3(glm::floor(camera->position / static_cast<float>(CHUNK_SIZE)));
 
-		if (std::find(fullLoadList.begin(), fullLoadList.end(), chunk->chunkPosition) == fullLoadList.end()) {
-			// Unload
+	// Occluders: solid boxes of the chunks closest to the camera
+	frameOccluders.clear();
+	for (const Chunk* chunk : chunkSlots) {
+		if (chunk == nullptr || chunk->occluderBoxes.empty()) continue;
 
-			delete chunk;
-			loadedChunks[hash] = nullptr;
-			hashesToUnload.push_back(hash);
+		const glm::ivec3 delta = glm::abs(glm::ivec3(chunk->chunkPosition) - cameraChunk);
+		if (std::max(delta.x, std::max(delta.y, delta.z)) > static_cast<int>(OCCLUDER_DISTANCE)) continue;
 
-			std::cout << "Delete chunk! " << std::endl;
+		const glm::vec3 chunkOrigin = chunk->chunkPosition * static_cast<float>(CHUNK_SIZE);
+		if (!camera->isAABBinsideFrustum(chunkOrigin, chunkOrigin + glm::vec3(CHUNK_SIZE))) continue;
+
+		for (const OccluderBox& box : chunk->occluderBoxes) {
+			frameOccluders.push_back({ chunkOrigin + box.min, chunkOrigin + box.max });
 		}
 	}
 
-	for (const size_t h : hashesToUnload) {
-		loadedChunks.erase(h);
+	lastOccludedChunks = 0;
+	if (frameOccluders.empty()) return;
+
+	occlusionBuffer->setViewProjection(camera->projectionMatrix * camera->viewMatrix);
+
+	// Each band of rows belongs to one task, so there are no races and the result doesn't depend on scheduling
+	workerPool->parallelFor(OCCLUSION_BANDS, [this](const unsigned int band) {
+		const unsigned int firstRow = band * OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+		const unsigned int endRow = (band + 1) * OCCLUSION_HEIGHT / OCCLUSION_BANDS;
+
+		occlusionBuffer->clearRows(firstRow, endRow);
+		for (const OccluderBox& box : frameOccluders) {
+			occlusionBuffer->rasterizeBox(box, firstRow, endRow);
+		}
+	});
+
+	occlusionResults.assign(visibleChunkIds.size(), 1);
+	const unsigned int testTasks = (visibleChunkIds.size() + OCCLUSION_TESTS_PER_TASK - 1) / OCCLUSION_TESTS_PER_TASK;
+
+	workerPool->parallelFor(testTasks, [this](const unsigned int task) {
+		const unsigned int first = task * OCCLUSION_TESTS_PER_TASK;
+		const unsigned int end = std::min<unsigned int>(first + OCCLUSION_TESTS_PER_TASK, visibleChunkIds.size());
+
+		for (unsigned int i = first; i < end; i++) {
+			const glm::vec3 chunkOrigin = chunkSlots[visibleChunkIds[i]]->chunkPosition * static_cast<float>(CHUNK_SIZE);
+			occlusionResults[i] = occlusionBuffer->isBoxVisible(chunkOrigin, chunkOrigin + glm::vec3(CHUNK_SIZE));
+		}
+	});
+
+	// Compact, keeping the culler's order
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < visibleChunkIds.size(); i++) {
+		if (occlusionResults[i]) {
+			visibleChunkIds[visibleCount++] = visibleChunkIds[i];
+		}
+	}
+	lastOccludedChunks = visibleChunkIds.size() - visibleCount;
+	visibleChunkIds.resize(visibleCount);
+}
+
+void ChunksManager::updatePhysicsChunks() {
+	// Collision shapes are only cooked around dynamic bodies, and released again once they move away.
+	// Releasing uses one extra chunk of margin so a body sitting on a chunk border doesn't cause churn.
+
+	std::vector<glm::ivec3> bodyChunkPositions;
+	for (const JPH::Vec3& position : physicsEngine->getDynamicBodyPositions()) {
+		const glm::ivec3 bodyChunk = glm::ivec3(
+			static_cast<int>(std::floor(position.GetX() / CHUNK_SIZE)),
+			static_cast<int>(std::floor(position.GetY() / CHUNK_SIZE)),
+			static_cast<int>(std::floor(position.GetZ() / CHUNK_SIZE))
+		);
+		if (std::find(bodyChunkPositions.begin(), bodyChunkPositions.end(), bodyChunk) == bodyChunkPositions.end()) {
+			bodyChunkPositions.push_back(bodyChunk);
+		}
+	}
+
+	for (const auto& [key, chunk] : loadedChunks) {
+		if (chunk == nullptr) continue;
+
+		int closestDistance = INT_MAX;
+		for (const glm::ivec3& bodyChunk : bodyChunkPositions) {
+			const glm::ivec3 delta = glm::abs(glm::ivec3(chunk->chunkPosition) - bodyChunk);
+			closestDistance = std::min(closestDistance, std::max(delta.x, std::max(delta.y, delta.z)));
+		}
+
+		if (!chunk->hasPhysics() && closestDistance <= static_cast<int>(physicsRadius)) {
+			chunk->buildPhysics();
+		}
+		else if (chunk->hasPhysics() && closestDistance > static_cast<int>(physicsRadius) + 1) {
+			chunk->releasePhysics();
+		}
 	}
 }
 
@@ -106,22 +772,45 @@ void ChunksManager::createOffsetsCache() {
 		}
 	}
 
+	// Nearest first, chunk jobs are submitted in this order
+	std::sort(loadChunksOffsets.begin(), loadChunksOffsets.end(), [](const glm::vec3& a, const glm::vec3& b) {
+		return glm::dot(a, a) < glm::dot(b, b);
+	});
+
 	std::cout << "Created load offsets cache with " << loadChunksOffsets.size() << " entries." << std::endl;
 }
 
 void ChunksManager::renderChunks() {
 
 	terrainMaterial->use();
-	terrainMaterial->setMatrices(camera);
 
-	for (const auto& [hash, chunk] : loadedChunks) {
-		const glm::vec3& chunkPositionMin = chunk->chunkPosition * static_cast<float>(CHUNK_SIZE);
-		const glm::vec3& chunkPositionMax = chunk->chunkPosition * static_cast<float>(CHUNK_SIZE) + glm::vec3(CHUNK_SIZE);
-		if (camera->isAABBinsideFrustum(chunkPositionMin, chunkPositionMax) == false) {
-			continue;
-		}
-		chunk->render();
+	{
+		PROFILE_ZONE("Frustum culling");
+		chunkCuller->cull(camera->planes, visibleChunkIds);
+	}
+	if (occlusionCulling) {
+		PROFILE_ZONE("Occlusion culling");
+		cullOccludedChunks();
 	}
+
+	for (const unsigned int id : visibleChunkIds) {
+		chunkSlots[id]->queueDraw();
+	}
+
+	terrainGeometry->draw();
+
+	{
+		PROFILE_GPU_ZONE("Horizon terrain");
+		horizonTerrain->render();
+	}
+
+	lastDrawCount = terrainGeometry->lastDrawCount;
+	lastHorizonDrawCount = horizonTerrain->lastDrawCount;
+	lastTriangleCount = terrainGeometry->lastTriangleCount + horizonTerrain->lastTriangleCount;
+}
+
+bool ChunksManager::isStreaming(const glm::vec3& currentChunkPosition) {
+	return !chunksInFlight.empty() || !chunksPrefetching.empty() || !createLoadList(currentChunkPosition, true).empty();
 }
 
 std::vector<glm::vec3> ChunksManager::createLoadList(const glm::vec3& currentChunkPosition, const bool ignoreCurrentlyLoaded) {
@@ -131,9 +820,10 @@ std::vector<glm::vec3> ChunksManager::createLoadList(const glm::vec3& currentChu
 	unsigned int index = 0;
 	for (const glm::vec3& offset : loadChunksOffsets) {
 		const glm::vec3 chunkPosition = currentChunkPosition + offset;
-		const size_t hash = hashVec3(chunkPosition);
+		const uint64_t key = packChunkPosition(glm::ivec3(chunkPosition));
 
-		if (loadedChunks.contains(hash) && ignoreCurrentlyLoaded) continue;
+		// A chunk being prefetched is picked up as known once it lands
+		if ((loadedChunks.contains(key) || chunksInFlight.contains(key) || chunksPrefetching.contains(key)) && ignoreCurrentlyLoaded) continue;
 		toLoad.emplace_back(chunkPosition);
 	}
 	return toLoad;
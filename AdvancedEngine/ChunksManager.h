@@ -1,45 +1,173 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <mutex>
 #include <glm/glm.hpp>
 #include "TerrainGenerator.h"
 #include "Chunk.h"
+#include "Camera.h"
+#include "TerrainGeometryArena.h"
+#include "StagingRing.h"
+#include "WorkerPool.h"
+#include "ChunkCuller.h"
+#include "OcclusionBuffer.h"
 #include "MoreMaterials.h"
+#include "WorldStorage.h"
+#include "TerrainEdit.h"
+#include "HorizonTerrain.h"
+#include "Player.h"
+#include "VoxelQueries.h"
 
 struct TerrainChunkData {
 	int x;
 	int y;
 	int z;
 
-	std::vector<float> densities;
-	std::vector<unsigned int> materials;
+	std::shared_ptr<const VoxelBuffer> voxels; // Shared with the loaded Chunk and the voxel queries, replaced by edits
+	TerrainDelta edits; // Already applied to voxels, kept to be saved
+};
+
+// Lifecycle of a chunk, from the load request to the draw list
+enum class ChunkState {
+	Queued, // Waiting for a worker
+	Generating, // Terrain and saved edits
+	Generated,
+	Meshing,
+	Meshed, // Waiting for the main thread
+	Cooking, // Being uploaded into the arena, only within uploadFinishedChunks()
+	Uploaded, // Loaded
+	Unloading // Left the load region while on a worker, whatever it produces is dropped
+};
+const unsigned int CHUNK_STATE_COUNT = 8;
+
+const char* getChunkStateName(const ChunkState state);
+
+// A chunk being built on a worker, shared with the main thread
+struct ChunkJob {
+	glm::vec3 chunkPosition;
+	unsigned int generation; // A result is stale when the chunk was requested again since, with a newer generation
+	std::atomic<ChunkState> state;
+	std::atomic<bool> cancelled; // Checked by the worker between steps
+};
+
+struct FinishedChunk {
+	std::shared_ptr<ChunkJob> job;
+	Chunk* chunk; // nullptr when the job was cancelled before meshing
 };
 
 class ChunksManager {
 public:
-	ChunksManager(Camera* camera, PhysicsEngine* physicsEngine);
+	ChunksManager(Camera* camera, PhysicsEngine* physicsEngine, Player* player);
+	~ChunksManager(); // Prints the prefetch hit rate and the halo regions copied and generated
 	void tick(const glm::vec3& currentChunkPosition);
 	void renderChunks();
+	bool isStreaming(const glm::vec3& currentChunkPosition); // Chunks in range are still missing or being built
+	void queueEdit(const TerrainEdit& edit); // Applied on the next tick, together with the other edits of the frame
+
+	// Against the densities of the known chunks (within FORGET_DISTANCE), edits included once they were applied by a tick
+	VoxelHit raycast(const VoxelRay& ray) const;
+	void raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const; // Split across the workers
+	void sphereSweep(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, const float radius) const;
+
+	unsigned int physicsRadius; // Chunks within this distance of a dynamic body get collision shapes
+	ChunkCollisionMode collisionMode; // Collision shape used for newly loaded chunks
+	bool occlusionCulling; // Skip chunks hidden behind the solid terrain near the camera
+	unsigned int lastOccludedChunks; // Frustum visible chunks rejected by occlusion on the last frame
+	unsigned int lastDrawCount; // Chunks drawn on the last frame
+	unsigned int lastHorizonDrawCount; // Draw calls of the horizon terrain on the last frame
+	unsigned int lastTriangleCount;
+	unsigned int lastEditedChunks; // Chunks remeshed by edits on the last tick
+	unsigned int prefetchedChunks; // Generated ahead of the player, terrain only
+	unsigned int prefetchHits; // Prefetched chunks the loader has needed since
+	unsigned int loaderGeneratedChunks; // Chunks the loader had to generate itself
+	std::atomic<unsigned int> chunksAllocated; // Chunk objects created, the pooled ones that were reused don't count
+	std::atomic<unsigned int> chunksRecycled;
+	unsigned int cancelledChunkJobs; // Jobs whose chunk left the load region before they finished
+	unsigned int staleChunkResults; // Meshed chunks thrown away because their job was cancelled
+
+	std::array<unsigned int, CHUNK_STATE_COUNT> getChunkStateCounts() const; // Indexed by ChunkState
+
+	// Halo regions of the chunks meshed so far: copied from a generated neighbor, or generated because there was none
+	unsigned int haloRegionsCopied;
+	std::atomic<unsigned int> haloRegionsGenerated;
+
+	unsigned int voxelBufferCopies; // Copies made by edits, the only voxel copies after generation
+	unsigned int forgottenChunks; // Known chunks dropped past FORGET_DISTANCE, their buffers are freed once nothing else holds them
 private:
 
+	void loadAndUnloadChunks(const glm::vec3& currentChunkPosition);
+	void submitChunkJobs(const glm::vec3& currentChunkPosition);
+	void prefetchChunks(const glm::vec3& currentChunkPosition);
+	void cancelChunkJobs(const glm::vec3& currentChunkPosition); // Out of the load region
+	void forgetFarChunks(const glm::vec3& currentChunkPosition); // Drops known terrain past FORGET_DISTANCE
+	void gatherHalo(const glm::vec3& chunkPosition, ChunkHalo& halo); // Copies the borders of the known neighbors
+	void uploadFinishedChunks();
+	void updatePhysicsChunks();
+	void applyPendingEdits();
+	void addLoadedChunk(const uint64_t key, Chunk* chunk);
+	void releaseChunkSlot(Chunk* chunk);
+	Chunk* acquireChunk(const glm::vec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels); // Any thread
+	void recycleChunk(Chunk* chunk); // Main thread
+	void cullOccludedChunks(); // Removes hidden chunks from visibleChunkIds
+
 	std::vector<glm::vec3> createLoadList(const glm::vec3& currentChunkPosition, const bool ignoreCurrentlyLoaded);
 
-	TerrainChunkData generateChunk(const glm::vec3& chunkPosition);
+	TerrainChunkData loadChunkData(const glm::vec3& chunkPosition); // Generated terrain with the saved edits on top, on a worker
 
 
 	void createOffsetsCache();
 
-	std::unordered_map<size_t, TerrainChunkData> knownChunks;
-	std::unordered_map<size_t, Chunk*> loadedChunks;
+	std::unordered_map<uint64_t, TerrainChunkData> knownChunks;
+	std::unordered_map<uint64_t, Chunk*> loadedChunks;
+
+	// Chunks being generated and meshed on the workers, they move to finishedChunks when done.
+	// A cancelled job leaves chunksInFlight at once and is only counted in chunksUnloading until its result comes back
+	std::unordered_map<uint64_t, std::shared_ptr<ChunkJob>> chunksInFlight;
+	std::vector<FinishedChunk> finishedChunks;
+	unsigned int nextChunkGeneration;
+	unsigned int chunksUnloading;
+	std::vector<TerrainChunkData> finishedChunkData; // Newly generated terrain for knownChunks
+	std::mutex finishedChunksMutex;
+
+	// Terrain generated along the player's path before the loader asks for it, it lands in knownChunks
+	std::unordered_set<uint64_t> chunksPrefetching;
+	std::unordered_set<uint64_t> prefetchedUnused;
+
+	std::vector<TerrainEdit> pendingEdits;
+
+	// Unloaded chunks waiting to be reused, their vectors keep their capacity
+	std::vector<Chunk*> chunkPool;
+	std::mutex chunkPoolMutex;
+
+	// Loaded chunks indexed by their cullId, for the culler's visible list
+	std::vector<Chunk*> chunkSlots;
+	std::vector<unsigned int> freeChunkSlots;
+	std::vector<unsigned int> visibleChunkIds;
+	ChunkCuller* chunkCuller;
+
+	OcclusionBuffer* occlusionBuffer;
+	std::vector<OccluderBox> frameOccluders; // World space
+	std::vector<unsigned char> occlusionResults;
 
 	std::vector<glm::vec3> loadChunksOffsets;
 	
 	TerrainGenerator* terrainGenerator;
 	TerrainGBufferMaterial* terrainMaterial;
+	TerrainGeometryArena* terrainGeometry;
+	StagingRing* stagingRing;
+	WorkerPool* workerPool;
+	WorldStorage* worldStorage;
+	HorizonTerrain* horizonTerrain;
 	MarchingCubeGenerator* meshGenerator;
+	VoxelQueries* voxelQueries; // Shares the buffers of knownChunks
 	Camera* camera;
 	PhysicsEngine* physicsEngine;
+	Player* player;
 
 
 };
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include "DensityFieldShape.h"
+#include "MarchingCubesGenerator.h"
+#include "Settings.h"
+#include <Jolt/Physics/Collision/Shape/ConvexShape.h>
+#include <Jolt/Physics/Collision/CollisionDispatch.h>
+#include <Jolt/Physics/Collision/CollideConvexVsTriangles.h>
+#include <Jolt/Physics/Collision/CastConvexVsTriangles.h>
+#include <Jolt/Physics/Collision/RayCast.h>
+#include <Jolt/Physics/Collision/CastResult.h>
+#include <Jolt/Physics/Collision/CollidePointResult.h>
+#include <Jolt/Physics/Collision/ShapeCast.h>
+#include <Jolt/Physics/Collision/ShapeFilter.h>
+#include <Jolt/Physics/Collision/TransformedShape.h>
+#include <Jolt/Physics/Collision/PhysicsMaterial.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <new>
+
+constexpr JPH::EShapeSubType DENSITY_FIELD_SUBTYPE = JPH::EShapeSubType::User1;
+constexpr JPH::uint CELL_ID_BITS = 15;
+constexpr unsigned int RAY_SAMPLES_PER_CELL = 4;
+constexpr unsigned int RAY_BISECTION_STEPS = 10;
+constexpr JPH::uint8 ALL_EDGES_ACTIVE = 0b111;
+
+static_assert(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE <= (1u << CELL_ID_BITS), "Cell index doesn't fit in the sub shape ID");
+
+inline unsigned int encodeCell(const unsigned int x, const unsigned int y, const unsigned int z) {
+	return x + y * CHUNK_SIZE + z * CHUNK_SIZE * CHUNK_SIZE;
+}
+
+inline JPH::Vec3 toJolt(const glm::vec3& v) {
+	return JPH::Vec3(v.x, v.y, v.z);
+}
+
+// Iteration state for GetTrianglesStart/GetTrianglesNext, lives inside the Jolt provided context buffer
+struct DensityFieldTrianglesContext {
+	JPH::Mat44 localToWorld;
+	unsigned int cellMin[3];
+	unsigned int cellMax[3];
+	unsigned int cursor[3];
+	bool finished;
+};
+
+static_assert(sizeof(DensityFieldTrianglesContext) <= sizeof(JPH::Shape::GetTrianglesContext), "GetTrianglesContext too small");
+
+DensityFieldShape::DensityFieldShape(const std::shared_ptr<const VoxelBuffer>& voxels, const float isoLevel) : JPH::Shape(JPH::EShapeType::User1, DENSITY_FIELD_SUBTYPE), voxels(voxels), densities(&voxels->densities), isoLevel(isoLevel) {
+
+}
+
+void DensityFieldShape::sRegister() {
+	JPH::ShapeFunctions& functions = JPH::ShapeFunctions::sGet(DENSITY_FIELD_SUBTYPE);
+	functions.mColor = JPH::Color::sDarkGreen;
+
+	for (const JPH::EShapeSubType convexSubType : JPH::sConvexSubShapeTypes) {
+		JPH::CollisionDispatch::sRegisterCollideShape(convexSubType, DENSITY_FIELD_SUBTYPE, sCollideConvexVsDensityField);
+		JPH::CollisionDispatch::sRegisterCastShape(convexSubType, DENSITY_FIELD_SUBTYPE, sCastConvexVsDensityField);
+
+		JPH::CollisionDispatch::sRegisterCollideShape(DENSITY_FIELD_SUBTYPE, convexSubType, JPH::CollisionDispatch::sReversedCollideShape);
+		JPH::CollisionDispatch::sRegisterCastShape(DENSITY_FIELD_SUBTYPE, convexSubType, JPH::CollisionDispatch::sReversedCastShape);
+	}
+}
+
+JPH::AABox DensityFieldShape::GetLocalBounds() const {
+	return JPH::AABox(JPH::Vec3::sZero(), JPH::Vec3::sReplicate(static_cast<float>(CHUNK_SIZE)));
+}
+
+JPH::uint DensityFieldShape::GetSubShapeIDBitsRecursive() const {
+	return CELL_ID_BITS;
+}
+
+JPH::MassProperties DensityFieldShape::GetMassProperties() const {
+	// Terrain is always static
+	return JPH::MassProperties();
+}
+
+const JPH::PhysicsMaterial* DensityFieldShape::GetMaterial(const JPH::SubShapeID& inSubShapeID) const {
+	return JPH::PhysicsMaterial::sDefault;
+}
+
+JPH::Vec3 DensityFieldShape::GetSurfaceNormal(const JPH::SubShapeID& inSubShapeID, JPH::Vec3Arg inLocalSurfacePosition) const {
+	// Density increases towards the inside of the terrain, so the outward normal is the negated gradient
+	const float h = 0.25f;
+	const JPH::Vec3 gradient(
+		sampleDensity(inLocalSurfacePosition + JPH::Vec3(h, 0, 0)) - sampleDensity(inLocalSurfacePosition - JPH::Vec3(h, 0, 0)),
+		sampleDensity(inLocalSurfacePosition + JPH::Vec3(0, h, 0)) - sampleDensity(inLocalSurfacePosition - JPH::Vec3(0, h, 0)),
+		sampleDensity(inLocalSurfacePosition + JPH::Vec3(0, 0, h)) - sampleDensity(inLocalSurfacePosition - JPH::Vec3(0, 0, h))
+	);
+
+	if (gradient.IsNearZero()) {
+		return JPH::Vec3::sAxisY();
+	}
+	return -gradient.Normalized();
+}
+
+void DensityFieldShape::GetSubmergedVolume(JPH::Mat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, const JPH::Plane& inSurface, float& outTotalVolume, float& outSubmergedVolume, JPH::Vec3& outCenterOfBuoyancy JPH_IF_DEBUG_RENDERER(, JPH::RVec3Arg inBaseOffset)) const {
+	outTotalVolume = 0.0f;
+	outSubmergedVolume = 0.0f;
+	outCenterOfBuoyancy = JPH::Vec3::sZero();
+}
+
+#ifdef JPH_DEBUG_RENDERER
+void DensityFieldShape::Draw(JPH::DebugRenderer* inRenderer, JPH::RMat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, JPH::ColorArg inColor, bool inUseMaterialColors, bool inDrawWireframe) const {
+	// The render mesh already shows the terrain
+}
+#endif
+
+float DensityFieldShape::sampleDensity(JPH::Vec3Arg localPosition) const {
+	const float maxCoordinate = static_cast<float>(CHUNK_SIZE);
+	const float px = std::clamp(localPosition.GetX(), 0.0f, maxCoordinate);
+	const float py = std::clamp(localPosition.GetY(), 0.0f, maxCoordinate);
+	const float pz = std::clamp(localPosition.GetZ(), 0.0f, maxCoordinate);
+
+	const unsigned int x = std::min(static_cast<unsigned int>(px), CHUNK_SIZE - 1);
+	const unsigned int y = std::min(static_cast<unsigned int>(py), CHUNK_SIZE - 1);
+	const unsigned int z = std::min(static_cast<unsigned int>(pz), CHUNK_SIZE - 1);
+
+	const float fx = px - x;
+	const float fy = py - y;
+	const float fz = pz - z;
+
+	const std::vector<float>& d = *densities;
+
+	// Trilinear interpolation, first along x, then y, then z
+	const float c00 = d[sampleIndex(x, y, z)] + (d[sampleIndex(x + 1, y, z)] - d[sampleIndex(x, y, z)]) * fx;
+	const float c10 = d[sampleIndex(x, y + 1, z)] + (d[sampleIndex(x + 1, y + 1, z)] - d[sampleIndex(x, y + 1, z)]) * fx;
+	const float c01 = d[sampleIndex(x, y, z + 1)] + (d[sampleIndex(x + 1, y, z + 1)] - d[sampleIndex(x, y, z + 1)]) * fx;
+	const float c11 = d[sampleIndex(x, y + 1, z + 1)] + (d[sampleIndex(x + 1, y + 1, z + 1)] - d[sampleIndex(x, y + 1, z + 1)]) * fx;
+
+	const float c0 = c00 + (c10 - c00) * fy;
+	const float c1 = c01 + (c11 - c01) * fy;
+
+	return c0 + (c1 - c0) * fz;
+}
+
+bool DensityFieldShape::cellHasSurface(const unsigned int x, const unsigned int y, const unsigned int z) const {
+	const std::vector<float>& d = *densities;
+
+	const float corners[8] = {
+		d[sampleIndex(x, y, z)], d[sampleIndex(x + 1, y, z)], d[sampleIndex(x, y + 1, z)], d[sampleIndex(x + 1, y + 1, z)],
+		d[sampleIndex(x, y, z + 1)], d[sampleIndex(x + 1, y, z + 1)], d[sampleIndex(x, y + 1, z + 1)], d[sampleIndex(x + 1, y + 1, z + 1)]
+	};
+
+	const auto [minDensity, maxDensity] = std::minmax_element(corners, corners + 8);
+	return *minDensity < isoLevel && *maxDensity >= isoLevel;
+}
+
+bool DensityFieldShape::getCellRange(const JPH::AABox& localBox, unsigned int* outMin, unsigned int* outMax) const {
+	if (!localBox.Overlaps(GetLocalBounds())) return false;
+
+	for (unsigned int axis = 0; axis < 3; axis++) {
+		outMin[axis] = static_cast<unsigned int>(std::clamp(static_cast<int>(std::floor(localBox.mMin[axis])), 0, static_cast<int>(CHUNK_SIZE) - 1));
+		outMax[axis] = static_cast<unsigned int>(std::clamp(static_cast<int>(std::floor(localBox.mMax[axis])), 0, static_cast<int>(CHUNK_SIZE) - 1));
+	}
+	return true;
+}
+
+float DensityFieldShape::castRayLocal(JPH::Vec3Arg origin, JPH::Vec3Arg direction, const float maxFraction, unsigned int& outCell) const {
+	const float chunkSize = static_cast<float>(CHUNK_SIZE);
+
+	// Clip the ray against the chunk bounds
+	float tEnter = 0.0f;
+	float tExit = maxFraction;
+
+	for (unsigned int axis = 0; axis < 3; axis++) {
+		if (std::fabs(direction[axis]) < 1e-12f) {
+			if (origin[axis] < 0.0f || origin[axis] > chunkSize) return FLT_MAX;
+			continue;
+		}
+
+		float t0 = -origin[axis] / direction[axis];
+		float t1 = (chunkSize - origin[axis]) / direction[axis];
+		if (t0 > t1) std::swap(t0, t1);
+
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+		if (tEnter > tExit) return FLT_MAX;
+	}
+
+	// Walk the cells along the ray (Amanatides & Woo)
+	const JPH::Vec3 entry = origin + direction * tEnter;
+
+	int cell[3];
+	int step[3];
+	float tNext[3];
+	float tDelta[3];
+
+	for (unsigned int axis = 0; axis < 3; axis++) {
+		cell[axis] = std::clamp(static_cast<int>(std::floor(entry[axis])), 0, static_cast<int>(CHUNK_SIZE) - 1);
+
+		if (direction[axis] > 0.0f) {
+			step[axis] = 1;
+			tNext[axis] = (cell[axis] + 1 - origin[axis]) / direction[axis];
+			tDelta[axis] = 1.0f / direction[axis];
+		}
+		else if (direction[axis] < 0.0f) {
+			step[axis] = -1;
+			tNext[axis] = (cell[axis] - origin[axis]) / direction[axis];
+			tDelta[axis] = -1.0f / direction[axis];
+		}
+		else {
+			step[axis] = 0;
+			tNext[axis] = FLT_MAX;
+			tDelta[axis] = FLT_MAX;
+		}
+	}
+
+	float tCell = tEnter;
+	float previousDensity = sampleDensity(entry) - isoLevel;
+
+	while (true) {
+		const float tCellEnd = std::min(std::min(tNext[0], tNext[1]), std::min(tNext[2], tExit));
+
+		if (cellHasSurface(cell[0], cell[1], cell[2])) {
+			// Sample the segment inside the cell and refine the first air -> solid crossing
+			float tPrevious = tCell;
+
+			for (unsigned int i = 1; i <= RAY_SAMPLES_PER_CELL; i++) {
+				const float t = tCell + (tCellEnd - tCell) * static_cast<float>(i) / RAY_SAMPLES_PER_CELL;
+				const float density = sampleDensity(origin + direction * t) - isoLevel;
+
+				if (previousDensity < 0.0f && density >= 0.0f) {
+					float low = tPrevious;
+					float high = t;
+					for (unsigned int j = 0; j < RAY_BISECTION_STEPS; j++) {
+						const float mid = (low + high) * 0.5f;
+						if (sampleDensity(origin + direction * mid) >= isoLevel) high = mid;
+						else low = mid;
+					}
+
+					outCell = encodeCell(cell[0], cell[1], cell[2]);
+					return high;
+				}
+
+				previousDensity = density;
+				tPrevious = t;
+			}
+		}
+		else {
+			previousDensity = sampleDensity(origin + direction * tCellEnd) - isoLevel;
+		}
+
+		if (tCellEnd >= tExit) break;
+
+		// Step into the next cell along the axis whose boundary is closest
+		unsigned int axis = 0;
+		if (tNext[1] < tNext[axis]) axis = 1;
+		if (tNext[2] < tNext[axis]) axis = 2;
+
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= static_cast<int>(CHUNK_SIZE)) break;
+
+		tCell = tCellEnd;
+		tNext[axis] += tDelta[axis];
+	}
+
+	return FLT_MAX;
+}
+
+bool DensityFieldShape::CastRay(const JPH::RayCast& inRay, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::RayCastResult& ioHit) const {
+	unsigned int cell = 0;
+	const float fraction = castRayLocal(inRay.mOrigin, inRay.mDirection, ioHit.mFraction, cell);
+	if (fraction >= ioHit.mFraction) return false;
+
+	ioHit.mFraction = fraction;
+	ioHit.mSubShapeID2 = inSubShapeIDCreator.PushID(cell, CELL_ID_BITS).GetID();
+	return true;
+}
+
+void DensityFieldShape::CastRay(const JPH::RayCast& inRay, const JPH::RayCastSettings& inRayCastSettings, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::CastRayCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter) const {
+	if (!inShapeFilter.ShouldCollide(this, inSubShapeIDCreator.GetID())) return;
+
+	unsigned int cell = 0;
+	const float fraction = castRayLocal(inRay.mOrigin, inRay.mDirection, std::min(1.0f, ioCollector.GetEarlyOutFraction()), cell);
+	if (fraction == FLT_MAX) return;
+
+	JPH::RayCastResult hit;
+	hit.mBodyID = JPH::TransformedShape::sGetBodyID(ioCollector.GetContext());
+	hit.mFraction = fraction;
+	hit.mSubShapeID2 = inSubShapeIDCreator.PushID(cell, CELL_ID_BITS).GetID();
+	ioCollector.AddHit(hit);
+}
+
+void DensityFieldShape::CollidePoint(JPH::Vec3Arg inPoint, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::CollidePointCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter) const {
+	if (!inShapeFilter.ShouldCollide(this, inSubShapeIDCreator.GetID())) return;
+	if (!GetLocalBounds().Contains(inPoint)) return;
+	if (sampleDensity(inPoint) < isoLevel) return;
+
+	ioCollector.AddHit({ JPH::TransformedShape::sGetBodyID(ioCollector.GetContext()), inSubShapeIDCreator.GetID() });
+}
+
+void DensityFieldShape::CollideSoftBodyVertices(JPH::Mat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, const JPH::CollideSoftBodyVertexIterator& inVertices, JPH::uint inNumVertices, int inCollidingShapeIndex) const {
+	// No soft bodies in the world
+}
+
+void DensityFieldShape::GetTrianglesStart(JPH::Shape::GetTrianglesContext& ioContext, const JPH::AABox& inBox, JPH::Vec3Arg inPositionCOM, JPH::QuatArg inRotation, JPH::Vec3Arg inScale) const {
+	DensityFieldTrianglesContext& context = *new (&ioContext) DensityFieldTrianglesContext;
+
+	context.localToWorld = JPH::Mat44::sRotationTranslation(inRotation, inPositionCOM) * JPH::Mat44::sScale(inScale);
+
+	const JPH::AABox localBox = inBox.Transformed(context.localToWorld.Inversed());
+	context.finished = !getCellRange(localBox, context.cellMin, context.cellMax);
+
+	for (unsigned int axis = 0; axis < 3; axis++) {
+		context.cursor[axis] = context.cellMin[axis];
+	}
+}
+
+int DensityFieldShape::GetTrianglesNext(JPH::Shape::GetTrianglesContext& ioContext, int inMaxTrianglesRequested, JPH::Float3* outTriangleVertices, const JPH::PhysicsMaterial** outMaterials) const {
+	DensityFieldTrianglesContext& context = reinterpret_cast<DensityFieldTrianglesContext&>(ioContext);
+
+	constexpr int MAX_TRIANGLES_PER_CELL = 5;
+
+	glm::vec3 cellVertices[MAX_TRIANGLES_PER_CELL * 3];
+	int numTriangles = 0;
+
+	while (!context.finished && inMaxTrianglesRequested - numTriangles >= MAX_TRIANGLES_PER_CELL) {
+		const unsigned int x = context.cursor[0];
+		const unsigned int y = context.cursor[1];
+		const unsigned int z = context.cursor[2];
+
+		if (cellHasSurface(x, y, z)) {
+			const unsigned int cellTriangles = MarchingCubeGenerator::triangulateCell(densities->data(), x, y, z, isoLevel, cellVertices);
+
+			for (unsigned int i = 0; i < cellTriangles * 3; i++) {
+				(context.localToWorld * toJolt(cellVertices[i])).StoreFloat3(outTriangleVertices++);
+			}
+			if (outMaterials != nullptr) {
+				for (unsigned int i = 0; i < cellTriangles; i++) {
+					*outMaterials++ = JPH::PhysicsMaterial::sDefault;
+				}
+			}
+
+			numTriangles += cellTriangles;
+		}
+
+		// Advance z, then x, then y
+		if (++context.cursor[2] > context.cellMax[2]) {
+			context.cursor[2] = context.cellMin[2];
+			if (++context.cursor[0] > context.cellMax[0]) {
+				context.cursor[0] = context.cellMin[0];
+				if (++context.cursor[1] > context.cellMax[1]) {
+					context.finished = true;
+				}
+			}
+		}
+	}
+
+	return numTriangles;
+}
+
+JPH::Shape::Stats DensityFieldShape::GetStats() const {
+	// The density grid belongs to the chunk, the shape itself adds nothing else
+	return Stats(sizeof(*this), 0);
+}
+
+void DensityFieldShape::sCollideConvexVsDensityField(const JPH::Shape* inShape1, const JPH::Shape* inShape2, JPH::Vec3Arg inScale1, JPH::Vec3Arg inScale2, JPH::Mat44Arg inCenterOfMassTransform1, JPH::Mat44Arg inCenterOfMassTransform2, const JPH::SubShapeIDCreator& inSubShapeIDCreator1, const JPH::SubShapeIDCreator& inSubShapeIDCreator2, const JPH::CollideShapeSettings& inCollideShapeSettings, JPH::CollideShapeCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter) {
+	JPH_ASSERT(inShape1->GetType() == JPH::EShapeType::Convex);
+	const JPH::ConvexShape* shape1 = static_cast<const JPH::ConvexShape*>(inShape1);
+	JPH_ASSERT(inShape2->GetSubType() == DENSITY_FIELD_SUBTYPE);
+	const DensityFieldShape* shape2 = static_cast<const DensityFieldShape*>(inShape2);
+
+	// Bounds of the convex shape in the unscaled local space of the terrain
+	const JPH::Mat44 transform1To2 = inCenterOfMassTransform2.InversedRotationTranslation() * inCenterOfMassTransform1;
+	JPH::AABox bounds = shape1->GetLocalBounds().Scaled(inScale1).Transformed(transform1To2);
+	bounds.ExpandBy(JPH::Vec3::sReplicate(inCollideShapeSettings.mMaxSeparationDistance));
+	bounds = JPH::AABox(bounds.mMin / inScale2, bounds.mMax / inScale2);
+
+	unsigned int cellMin[3];
+	unsigned int cellMax[3];
+	if (!shape2->getCellRange(bounds, cellMin, cellMax)) return;
+
+	JPH::CollideConvexVsTriangles collider(shape1, inScale1, inScale2, inCenterOfMassTransform1, inCenterOfMassTransform2, inSubShapeIDCreator1.GetID(), inCollideShapeSettings, ioCollector);
+
+	glm::vec3 cellVertices[15];
+
+	for (unsigned int y = cellMin[1]; y <= cellMax[1]; y++) {
+		for (unsigned int x = cellMin[0]; x <= cellMax[0]; x++) {
+			for (unsigned int z = cellMin[2]; z <= cellMax[2]; z++) {
+				if (ioCollector.ShouldEarlyOut()) return;
+				if (!shape2->cellHasSurface(x, y, z)) continue;
+
+				const JPH::SubShapeID cellID = inSubShapeIDCreator2.PushID(encodeCell(x, y, z), CELL_ID_BITS).GetID();
+				const unsigned int numTriangles = MarchingCubeGenerator::triangulateCell(shape2->densities->data(), x, y, z, shape2->isoLevel, cellVertices);
+
+				for (unsigned int i = 0; i < numTriangles; i++) {
+					collider.Collide(toJolt(cellVertices[i * 3]), toJolt(cellVertices[i * 3 + 1]), toJolt(cellVertices[i * 3 + 2]), ALL_EDGES_ACTIVE, cellID);
+				}
+			}
+		}
+	}
+}
+
+void DensityFieldShape::sCastConvexVsDensityField(const JPH::ShapeCast& inShapeCast, const JPH::ShapeCastSettings& inShapeCastSettings, const JPH::Shape* inShape, JPH::Vec3Arg inScale, const JPH::ShapeFilter& inShapeFilter, JPH::Mat44Arg inCenterOfMassTransform2, const JPH::SubShapeIDCreator& inSubShapeIDCreator1, const JPH::SubShapeIDCreator& inSubShapeIDCreator2, JPH::CastShapeCollector& ioCollector) {
+	JPH_ASSERT(inShape->GetSubType() == DENSITY_FIELD_SUBTYPE);
+	const DensityFieldShape* shape = static_cast<const DensityFieldShape*>(inShape);
+
+	// The cast is already in the local space of the terrain, sweep its bounds along the cast direction
+	JPH::AABox sweptBounds = inShapeCast.mShapeWorldBounds;
+	sweptBounds.Encapsulate(inShapeCast.mShapeWorldBounds.mMin + inShapeCast.mDirection);
+	sweptBounds.Encapsulate(inShapeCast.mShapeWorldBounds.mMax + inShapeCast.mDirection);
+	sweptBounds = JPH::AABox(sweptBounds.mMin / inScale, sweptBounds.mMax / inScale);
+
+	unsigned int cellMin[3];
+	unsigned int cellMax[3];
+	if (!shape->getCellRange(sweptBounds, cellMin, cellMax)) return;
+
+	JPH::CastConvexVsTriangles caster(inShapeCast, inShapeCastSettings, inScale, inCenterOfMassTransform2, inSubShapeIDCreator1, ioCollector);
+
+	glm::vec3 cellVertices[15];
+
+	for (unsigned int y = cellMin[1]; y <= cellMax[1]; y++) {
+		for (unsigned int x = cellMin[0]; x <= cellMax[0]; x++) {
+			for (unsigned int z = cellMin[2]; z <= cellMax[2]; z++) {
+				if (ioCollector.ShouldEarlyOut()) return;
+				if (!shape->cellHasSurface(x, y, z)) continue;
+
+				const JPH::SubShapeID cellID = inSubShapeIDCreator2.PushID(encodeCell(x, y, z), CELL_ID_BITS).GetID();
+				const unsigned int numTriangles = MarchingCubeGenerator::triangulateCell(shape->densities->data(), x, y, z, shape->isoLevel, cellVertices);
+
+				for (unsigned int i = 0; i < numTriangles; i++) {
+					caster.Cast(toJolt(cellVertices[i * 3]), toJolt(cellVertices[i * 3 + 1]), toJolt(cellVertices[i * 3 + 2]), ALL_EDGES_ACTIVE, cellID);
+				}
+			}
+		}
+	}
+}
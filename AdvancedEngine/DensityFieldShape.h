@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Jolt/Jolt.h>
+#include <Jolt/Physics/Collision/Shape/Shape.h>
+#include <Jolt/Physics/Collision/CollideShape.h>
+#include <Jolt/Physics/Collision/ShapeCast.h>
+#include <memory>
+#include <vector>
+#include "VoxelBuffer.h"
+
+/*
+A terrain collision shape that answers queries directly from a chunk's density grid, instead of
+cooking the marching cubes triangles into a MeshShape.
+
+Ray casts march the cells along the ray and find the iso-surface with trilinear interpolation.
+Convex shapes collide and cast against the triangles of the few cells they overlap, which are
+triangulated on the fly with the same tables as the render mesh.
+
+The shape shares the chunk's voxel buffer, which never changes while shared, so queries stay valid across edits.
+*/
+class DensityFieldShape final : public JPH::Shape {
+public:
+	JPH_OVERRIDE_NEW_DELETE
+
+	DensityFieldShape(const std::shared_ptr<const VoxelBuffer>& voxels, const float isoLevel);
+
+	// Registers the collision dispatch functions, call once after JPH::RegisterTypes()
+	static void sRegister();
+
+	bool MustBeStatic() const override { return true; }
+	JPH::AABox GetLocalBounds() const override;
+	JPH::uint GetSubShapeIDBitsRecursive() const override;
+	float GetInnerRadius() const override { return 0.0f; }
+	JPH::MassProperties GetMassProperties() const override;
+	const JPH::PhysicsMaterial* GetMaterial(const JPH::SubShapeID& inSubShapeID) const override;
+	JPH::Vec3 GetSurfaceNormal(const JPH::SubShapeID& inSubShapeID, JPH::Vec3Arg inLocalSurfacePosition) const override;
+	void GetSubmergedVolume(JPH::Mat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, const JPH::Plane& inSurface, float& outTotalVolume, float& outSubmergedVolume, JPH::Vec3& outCenterOfBuoyancy JPH_IF_DEBUG_RENDERER(, JPH::RVec3Arg inBaseOffset)) const override;
+
+#ifdef JPH_DEBUG_RENDERER
+	void Draw(JPH::DebugRenderer* inRenderer, JPH::RMat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, JPH::ColorArg inColor, bool inUseMaterialColors, bool inDrawWireframe) const override;
+#endif
+
+	bool CastRay(const JPH::RayCast& inRay, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::RayCastResult& ioHit) const override;
+	void CastRay(const JPH::RayCast& inRay, const JPH::RayCastSettings& inRayCastSettings, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::CastRayCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter = { }) const override;
+	void CollidePoint(JPH::Vec3Arg inPoint, const JPH::SubShapeIDCreator& inSubShapeIDCreator, JPH::CollidePointCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter = { }) const override;
+	void CollideSoftBodyVertices(JPH::Mat44Arg inCenterOfMassTransform, JPH::Vec3Arg inScale, const JPH::CollideSoftBodyVertexIterator& inVertices, JPH::uint inNumVertices, int inCollidingShapeIndex) const override;
+
+	void GetTrianglesStart(JPH::Shape::GetTrianglesContext& ioContext, const JPH::AABox& inBox, JPH::Vec3Arg inPositionCOM, JPH::QuatArg inRotation, JPH::Vec3Arg inScale) const override;
+	int GetTrianglesNext(JPH::Shape::GetTrianglesContext& ioContext, int inMaxTrianglesRequested, JPH::Float3* outTriangleVertices, const JPH::PhysicsMaterial** outMaterials = nullptr) const override;
+
+	Stats GetStats() const override;
+	float GetVolume() const override { return 0.0f; }
+
+	float sampleDensity(JPH::Vec3Arg localPosition) const;
+
+private:
+	// Returns the fraction of the first air -> solid crossing along the ray, or FLT_MAX
+	float castRayLocal(JPH::Vec3Arg origin, JPH::Vec3Arg direction, const float maxFraction, unsigned int& outCell) const;
+	bool cellHasSurface(const unsigned int x, const unsigned int y, const unsigned int z) const;
+	// Converts a local space box into an inclusive range of cells, returns false when it doesn't overlap the chunk
+	bool getCellRange(const JPH::AABox& localBox, unsigned int* outMin, unsigned int* outMax) const;
+
+	static void sCollideConvexVsDensityField(const JPH::Shape* inShape1, const JPH::Shape* inShape2, JPH::Vec3Arg inScale1, JPH::Vec3Arg inScale2, JPH::Mat44Arg inCenterOfMassTransform1, JPH::Mat44Arg inCenterOfMassTransform2, const JPH::SubShapeIDCreator& inSubShapeIDCreator1, const JPH::SubShapeIDCreator& inSubShapeIDCreator2, const JPH::CollideShapeSettings& inCollideShapeSettings, JPH::CollideShapeCollector& ioCollector, const JPH::ShapeFilter& inShapeFilter);
+	static void sCastConvexVsDensityField(const JPH::ShapeCast& inShapeCast, const JPH::ShapeCastSettings& inShapeCastSettings, const JPH::Shape* inShape, JPH::Vec3Arg inScale, const JPH::ShapeFilter& inShapeFilter, JPH::Mat44Arg inCenterOfMassTransform2, const JPH::SubShapeIDCreator& inSubShapeIDCreator1, const JPH::SubShapeIDCreator& inSubShapeIDCreator2, JPH::CastShapeCollector& ioCollector);
+
+	std::shared_ptr<const VoxelBuffer> voxels; // Shared with the chunk, an edit gives the chunk a new buffer and a new shape
+	const std::vector<float>* densities; // voxels->densities
+	float isoLevel;
+};
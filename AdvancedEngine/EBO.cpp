@@ -1,9 +1,11 @@
 #include "EBO.h"
+#include "Profiler.h"
 #include <iostream>
 
 
 EBO::EBO(std::vector<unsigned int> indices, GLenum usage) {
 	glGenBuffers(1, &ebo);
+	Profiler::countGlObjectsCreated(1);
 	bind();
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), usage);
 
@@ -14,6 +16,14 @@ EBO::EBO(std::vector<unsigned int> indices, GLenum usage) {
 	
 	//std::cout << "Number of elements: " << numberOfElements << std::endl;
 }
+EBO::EBO(const unsigned int numberOfElements, GLenum usage) {
+	glGenBuffers(1, &ebo);
+	Profiler::countGlObjectsCreated(1);
+	bind();
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numberOfElements * sizeof(unsigned int), nullptr, usage);
+
+	this->numberOfElements = numberOfElements;
+}
 void EBO::bind() {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 }
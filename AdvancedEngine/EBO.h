@@ -7,6 +7,7 @@
 class EBO {
 public:
 	EBO(std::vector<unsigned int> indices, GLenum usage);
+	EBO(const unsigned int numberOfElements, GLenum usage); // Allocates storage without uploading anything
 	~EBO();
 
 	void bind();
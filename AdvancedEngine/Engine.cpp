@@ -2,16 +2,27 @@
 #include "MoreMaterials.h"
 #include "MarchingCubesGenerator.h"
 #include "Settings.h"
+#include "Profiler.h"
+#include "ProgramBinaryCache.h"
+#include "WorkerPool.h"
 #include <FastNoise/FastNoise.h>
 #include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <thread>
 
 
-const unsigned int WIDTH = 1900;
-const unsigned int HEIGHT = 1060;
 const float MOVEMENT_SPEED = 5.0f;
+const float FIXED_TIMESTEP = 1.0f / 60.0f;
+const unsigned int MAX_PHYSICS_SUBSTEPS = 4; // Per frame, the rest of a long hitch is dropped
+const char* PROFILE_TRACE_PATH = "profile_trace.json"; // Written on F9 and on exit
+// Terrain tool: left mouse digs, right mouse places, a sphere in front of the camera while the button is held
+const float EDIT_DISTANCE = 6.0f; // When the terrain is out of reach
+const float EDIT_REACH = 16.0f;
+const float EDIT_RADIUS = 2.5f;
+const unsigned int EDIT_PLACE_MATERIAL = 0;
 const char* vertexShaderSource = R"(
 #version 460 core
 
@@ -34,7 +45,7 @@ void main() {
 )";
 
 
-Engine::Engine() : currentWidth(WIDTH), currentHeight(HEIGHT) {
+Engine::Engine(const bool headless, const unsigned int width, const unsigned int height) : headless(headless), currentWidth(width), currentHeight(height), deltaTime(0.0f), physicsAccumulator(0.0f), outputFramebuffer(0), outputColor(0) {
 
 	WindowConfig config;
 	config.width = currentWidth;
@@ -42,6 +53,9 @@ Engine::Engine() : currentWidth(WIDTH), currentHeight(HEIGHT) {
 	config.GLmajorVersion = 4;
 	config.GLminorVersion = 6;
 	config.title = "Not advanced engine";
+	config.headless = headless;
+
+	Profiler::setThreadName("Main");
 
 	window = new Window(config);
 
@@ -51,6 +65,14 @@ Engine::Engine() : currentWidth(WIDTH), currentHeight(HEIGHT) {
 };
 
 Engine::~Engine() {
+	// Chunks free GL buffers, the context has to outlive them
+	delete chunksManager;
+	delete cameraUniformBuffer;
+	if (outputFramebuffer != 0) {
+		glDeleteFramebuffers(1, &outputFramebuffer);
+		glDeleteRenderbuffers(1, &outputColor);
+	}
+	Profiler::releaseGpuQueries();
 	delete window;
 }
 
@@ -110,14 +132,21 @@ void Engine::initialize() {
 	glViewport(0, 0, currentWidth, currentHeight);
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
-	glfwSetInputMode(window->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if (!headless) {
+		glfwSetInputMode(window->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
 
 	physicsEngine = new PhysicsEngine();
 
 	initializeCamera();
+	cameraUniformBuffer = new UniformBuffer(sizeof(CameraUniforms), CAMERA_UNIFORMS_BINDING);
 	initializeWorld();
 	initializeDeferredRendering();
 	initializeFullscreenQuad();
+	if (headless) {
+		initializeOutputFramebuffer();
+	}
+	ProgramBinaryCache::printStartupReport();
 	//initializeDebuggingObjects();
 	
 	registerEvents();
@@ -126,13 +155,13 @@ void Engine::initialize() {
 }
 
 void Engine::initializeWorld() {
-	chunksManager = new ChunksManager(camera, physicsEngine);
+	chunksManager = new ChunksManager(camera, physicsEngine, player);
 }
 
 void Engine::initializeCamera() {
 
 	camera = new Camera(glm::vec3(0, 0, 5), 90.f);
-	camera->aspectRatio = static_cast<float>(window->windowWidth) / static_cast<float>(window->windowHeight);
+	camera->aspectRatio = static_cast<float>(currentWidth) / static_cast<float>(currentHeight);
 
 	camera->recomputeMatrices();
 
@@ -144,34 +173,35 @@ void Engine::initializeCamera() {
 void Engine::initializeDeferredRendering() {
 
 	glGenFramebuffers(1, &gBuffer);
+	Profiler::countGlObjectsCreated(1);
 	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 	glViewport(0, 0, currentWidth, currentHeight);
 
-	glGenRenderbuffers(1, &rboDepth);
-	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, currentWidth, currentHeight);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, currentWidth, currentHeight, 0, GL_RGB, GL_FLOAT, NULL);
+	// World positions are rebuilt from this depth in the deferred pass, there is no position target
+	glGenTextures(1, &gDepth);
+	Profiler::countGlObjectsCreated(1);
+	glBindTexture(GL_TEXTURE_2D, gDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, currentWidth, currentHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 
+	// Octahedral encoded normal
 	glGenTextures(1, &gNormal);
+	Profiler::countGlObjectsCreated(1);
 	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, currentWidth, currentHeight, 0, GL_RGB, GL_FLOAT, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, currentWidth, currentHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
 
 	glGenTextures(1, &gSkyMaterial);
+	Profiler::countGlObjectsCreated(1);
 	glBindTexture(GL_TEXTURE_2D, gSkyMaterial);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, currentWidth, currentHeight, 0, GL_RG, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gSkyMaterial, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gSkyMaterial, 0);
 
 	/*glGenTextures(1, &gAlbedo);
 	glBindTexture(GL_TEXTURE_2D, gAlbedo);
@@ -197,8 +227,8 @@ void Engine::initializeDeferredRendering() {
 
 
 
-	GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-	glDrawBuffers(3, attachments);
+	GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		throw std::runtime_error("Framebuffer incomplete");
@@ -207,6 +237,25 @@ void Engine::initializeDeferredRendering() {
 
 }
 
+void Engine::initializeOutputFramebuffer() {
+
+	// The default framebuffer of a hidden window isn't guaranteed to be rendered or readable, the final image goes here instead
+	glGenFramebuffers(1, &outputFramebuffer);
+	Profiler::countGlObjectsCreated(1);
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+
+	glGenRenderbuffers(1, &outputColor);
+	Profiler::countGlObjectsCreated(1);
+	glBindRenderbuffer(GL_RENDERBUFFER, outputColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, currentWidth, currentHeight);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, outputColor);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("Output framebuffer incomplete");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
 void Engine::initializeFullscreenQuad() {
 
 	const std::vector<float> quadVerts = {
@@ -221,11 +270,21 @@ void Engine::initializeFullscreenQuad() {
 	};
 
 	DeferredShadingMaterial* deferredShadingMat = new DeferredShadingMaterial();
-	Texture* albedoTerrainTexture = new Texture({ "assets/stone-albedo.png", "assets/terrain2.png", "assets/grass-albedo.png" });
-	Texture* normalTerrainTexture = new Texture({ "assets/stone-normal.png", "assets/terrain2-normal.png", "assets/grass-normal.png" });
-	Texture* roughnessTerrainTexture = new Texture({ "assets/stone-roughness.png", "assets/terrain2-roughness.png", "assets/grass-roughness.png" });
-	Texture* metallicTerrainTexture = new Texture({ "assets/stone-metallic.png", "assets/terrain2-metallic.png", "assets/grass-metallic.png" });
-	Texture* aoTerrainTexture = new Texture({ "assets/stone-ao.png", "assets/terrain2-ao.png", "assets/grass-ao.png" });
+	// All 15 images decode in parallel on a pool that only lives for startup
+	WorkerPool textureWorkers(std::thread::hardware_concurrency());
+	const std::vector<Texture*> terrainTextures = Texture::loadTextures({
+		{ "assets/stone-albedo.png", "assets/terrain2.png", "assets/grass-albedo.png" },
+		{ "assets/stone-normal.png", "assets/terrain2-normal.png", "assets/grass-normal.png" },
+		{ "assets/stone-roughness.png", "assets/terrain2-roughness.png", "assets/grass-roughness.png" },
+		{ "assets/stone-metallic.png", "assets/terrain2-metallic.png", "assets/grass-metallic.png" },
+		{ "assets/stone-ao.png", "assets/terrain2-ao.png", "assets/grass-ao.png" }
+	}, &textureWorkers);
+
+	Texture* albedoTerrainTexture = terrainTextures[0];
+	Texture* normalTerrainTexture = terrainTextures[1];
+	Texture* roughnessTerrainTexture = terrainTextures[2];
+	Texture* metallicTerrainTexture = terrainTextures[3];
+	Texture* aoTerrainTexture = terrainTextures[4];
 
 	deferredShadingMat->albedoTexture = albedoTerrainTexture;
 	deferredShadingMat->normalMapTexture = normalTerrainTexture;
@@ -323,50 +382,103 @@ void Engine::registerEvents() {
 }*/
 
 void Engine::tick() {
+	PROFILE_ZONE("Engine::tick");
 
 	
-	//std::cout << "begin process inputs" << std::endl;
-	player->processInputs(this->window, deltaTime);
-	//std::cout << "end process inputs update physics" << std::endl;
-	physicsEngine->step(deltaTime);
-	//std::cout << "end update physics begin post update" << std::endl;
-	player->postUpdate();
-	//std::cout << "end post update" << std::endl;
+	// Physics runs at a fixed rate, the accumulator carries leftover frame time over to the next frame
+
+	physicsAccumulator += deltaTime;
+
+	unsigned int substeps = 0;
+	while (physicsAccumulator >= FIXED_TIMESTEP && substeps < MAX_PHYSICS_SUBSTEPS) {
+		player->processInputs(this->window, FIXED_TIMESTEP);
+		physicsEngine->step(FIXED_TIMESTEP);
+		player->postUpdate();
+
+		physicsAccumulator -= FIXED_TIMESTEP;
+		substeps++;
+	}
+
+	// After a hitch, drop what couldn't be simulated instead of falling further behind every frame
+	if (physicsAccumulator >= FIXED_TIMESTEP) {
+		physicsAccumulator = std::fmod(physicsAccumulator, FIXED_TIMESTEP);
+	}
+
+	// Render between the last two physics states
+	player->interpolate(physicsAccumulator / FIXED_TIMESTEP);
 
 
 	handleCameraInput();
+	handleEditInput();
 
-	// Get the current position in chunk coordinates
+	chunksManager->tick(getCameraChunkPosition());
+}
+
+void Engine::handleEditInput() {
+	const bool dig = window->getMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+	const bool place = window->getMouseButtonPressed(GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+	if (!dig && !place) return;
+
+	// Centered on the terrain under the crosshair
+	const VoxelHit hit = chunksManager->raycast({ camera->position, camera->direction, EDIT_REACH });
+	const glm::vec3 center = hit.isHit() ? hit.position : camera->position + camera->direction * EDIT_DISTANCE;
+
+	// One edit per frame while held, the ChunksManager remeshes only the cells it touched
+	chunksManager->queueEdit({
+		.shape = TerrainEditShape::Sphere,
+		.mode = dig ? TerrainEditMode::Dig : TerrainEditMode::Place,
+		.center = center,
+		.size = glm::vec3(EDIT_RADIUS),
+		.strength = 0.0f,
+		.material = EDIT_PLACE_MATERIAL
+	});
+}
 
-	const glm::vec3& currentCameraPosition = camera->position;
-	const glm::vec3 currentChunkPosition = glm::vec3(
+glm::vec3 Engine::getCameraChunkPosition() const {
+	return glm::vec3(
 		std::floor(camera->position.x / CHUNK_SIZE),
 		std::floor(camera->position.y / CHUNK_SIZE),
 		std::floor(camera->position.z / CHUNK_SIZE)
 	);
-
-	chunksManager->tick(currentChunkPosition);
 }
 
 void Engine::render() {
+	PROFILE_ZONE("Engine::render");
+
 	glEnable(GL_DEPTH_TEST);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
 	glClearColor(0.0, 0.0, 0.0, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// Camera matrices for every shader this frame
+	const CameraUniforms cameraUniforms = {
+		.viewMatrix = camera->viewMatrix,
+		.projectionMatrix = camera->projectionMatrix,
+		.inverseViewProjection = glm::inverse(camera->projectionMatrix * camera->viewMatrix),
+		.cameraPosition = glm::vec4(camera->position, 1.0f)
+	};
+	cameraUniformBuffer->update(&cameraUniforms, sizeof(cameraUniforms));
 	
 	// GBUffer pass
-	chunksManager->renderChunks();
+	{
+		PROFILE_ZONE("G-buffer pass");
+		PROFILE_GPU_ZONE("G-buffer pass");
+		chunksManager->renderChunks();
+	}
 
 	// Deferred shading pass
 
 	//glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	PROFILE_ZONE("Deferred pass");
+	PROFILE_GPU_ZONE("Deferred pass");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
+	glBindTexture(GL_TEXTURE_2D, gDepth);
 
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, gNormal);
@@ -394,6 +506,7 @@ void Engine::run() {
 
 	int fpsCounter = 0;
 	auto start = std::chrono::high_resolution_clock::now();
+	bool exportKeyWasDown = false;
 
 	std::cout << "begin mainloop" << std::endl;
 
@@ -401,10 +514,23 @@ void Engine::run() {
 
 		auto deltaTimeStart = std::chrono::high_resolution_clock::now();
 
-		tick();
-		render();
-		window->swapBuffers();
+		{
+			PROFILE_ZONE("Frame");
+			tick();
+			render();
+		}
+		{
+			PROFILE_ZONE("Swap buffers");
+			window->swapBuffers();
+		}
 		window->pollEvents();
+		Profiler::endFrame();
+
+		const bool exportKeyDown = window->getKeyPressed(GLFW_KEY_F9) == GLFW_PRESS;
+		if (exportKeyDown && !exportKeyWasDown) {
+			Profiler::exportChromeTrace(PROFILE_TRACE_PATH);
+		}
+		exportKeyWasDown = exportKeyDown;
 
 		fpsCounter++;
 
@@ -420,5 +546,58 @@ void Engine::run() {
 
 		deltaTime = std::chrono::duration<float, std::milli>(deltaTimeEnd - deltaTimeStart).count() / 1000.0f;
 	}
+
+	Profiler::exportChromeTrace(PROFILE_TRACE_PATH);
+}
+
+void Engine::setCameraPose(const glm::vec3& position, const float yaw, const float pitch) {
+	camera->position = position;
+	camera->yaw = yaw;
+	camera->pitch = pitch;
+	camera->recomputeMatrices();
+}
+
+void Engine::waitForChunkStreaming() {
+	const glm::vec3 chunkPosition = getCameraChunkPosition();
+
+	while (chunksManager->isStreaming(chunkPosition)) {
+		chunksManager->tick(chunkPosition);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+FrameStats Engine::renderFrame() {
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	chunksManager->tick(getCameraChunkPosition());
+	render();
+
+	const auto end = std::chrono::high_resolution_clock::now();
+	Profiler::endFrame();
+
+	const unsigned int chunkDraws = chunksManager->lastDrawCount;
+	return {
+		.cpuMilliseconds = std::chrono::duration<float, std::milli>(end - start).count(),
+		.drawCalls = (chunkDraws > 0 ? 1u : 0u) + chunksManager->lastHorizonDrawCount + 1u, // Terrain multi-draw, horizon levels and the fullscreen quad
+		.chunkDraws = chunkDraws,
+		.triangles = chunksManager->lastTriangleCount + 2,
+		.chunksAllocated = chunksManager->chunksAllocated,
+		.chunksRecycled = chunksManager->chunksRecycled,
+		.glObjectsCreated = Profiler::getGlObjectsCreated(),
+		.cancelledChunkJobs = chunksManager->cancelledChunkJobs,
+		.staleChunkResults = chunksManager->staleChunkResults,
+		.prefetchedChunks = chunksManager->prefetchedChunks,
+		.prefetchHits = chunksManager->prefetchHits,
+		.loaderGeneratedChunks = chunksManager->loaderGeneratedChunks,
+		.chunkStates = chunksManager->getChunkStateCounts()
+	};
 }
 
+void Engine::readFramePixels(std::vector<unsigned char>& pixels) {
+	pixels.resize(static_cast<size_t>(currentWidth) * currentHeight * 3);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, outputFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, currentWidth, currentHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
@@ -7,16 +7,49 @@
 #include "ChunksManager.h"
 #include "PhysicsEngine.h"
 #include "Player.h"
+#include "UniformBuffer.h"
+
+// Window size, and the default size of headless frames
+const unsigned int DEFAULT_WIDTH = 1900;
+const unsigned int DEFAULT_HEIGHT = 1060;
+
+struct FrameStats {
+	float cpuMilliseconds; // Chunk streaming, culling and command submission
+	unsigned int drawCalls; // GL draw calls, the voxel terrain is a single multi-draw and the horizon one per level
+	unsigned int chunkDraws; // Commands inside the terrain multi-draw
+	unsigned int triangles;
+
+	// Running totals since startup, for resource churn
+	unsigned int chunksAllocated; // Chunk objects created rather than taken from the pool
+	unsigned int chunksRecycled;
+	uint64_t glObjectsCreated;
+	unsigned int cancelledChunkJobs;
+	unsigned int staleChunkResults;
+	unsigned int prefetchedChunks;
+	unsigned int prefetchHits; // Prefetched chunks the loader has used
+	unsigned int loaderGeneratedChunks; // Chunks the loader had to generate itself
+
+	std::array<unsigned int, CHUNK_STATE_COUNT> chunkStates; // Chunks in each ChunkState at the end of the frame
+};
 
 class Engine {
 public:
-	Engine();
+	Engine(const bool headless = false, const unsigned int width = DEFAULT_WIDTH, const unsigned int height = DEFAULT_HEIGHT);
 	~Engine();
 
 	void run();
 
 	void onWindowResize();
 
+	// Scripted frames for the headless benchmark, the player and the inputs are bypassed
+	void setCameraPose(const glm::vec3& position, const float yaw, const float pitch);
+	void waitForChunkStreaming(); // Blocks until every chunk around the camera is loaded
+	FrameStats renderFrame();
+	void readFramePixels(std::vector<unsigned char>& pixels); // Tightly packed RGB, bottom row first
+
+	unsigned int getWidth() const { return currentWidth; }
+	unsigned int getHeight() const { return currentHeight; }
+
 private:
 
 	void tick();
@@ -28,16 +61,22 @@ private:
 	void initializeWorld();
 	void initializeDeferredRendering();
 	void initializeFullscreenQuad();
+	void initializeOutputFramebuffer();
+
+	glm::vec3 getCameraChunkPosition() const;
 
 	void handleCameraInput();
+	void handleEditInput();
 	void registerEvents();
 
 	Window* window;
+	bool headless;
 
 	unsigned int currentWidth;
 	unsigned int currentHeight;
 
 	float deltaTime;
+	float physicsAccumulator; // Frame time not yet consumed by fixed physics steps
 
 	// DEBUG
 
@@ -46,14 +85,18 @@ private:
 	PhysicsEngine* physicsEngine;
 	Player* player;
 	Mesh* fullScreenQuad;
+	UniformBuffer* cameraUniformBuffer;
 
 	GLuint gBuffer;
 
-	GLuint gPosition;
-	GLuint rboDepth;
+	GLuint gDepth;
 	GLuint gNormal;
 	GLuint gSkyMaterial;
 
+	// Where the deferred pass lands: 0 for the window, an offscreen target when headless
+	GLuint outputFramebuffer;
+	GLuint outputColor;
+
 
 
 	double lastX;
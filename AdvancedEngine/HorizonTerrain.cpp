@@ -0,0 +1,159 @@
+#include "HorizonTerrain.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+const unsigned int HORIZON_LEVELS = 7;
+const unsigned int HORIZON_GRID_QUADS = 64; // Quads per side of every level, must be a multiple of 4
+const float HORIZON_BASE_SPACING = 8.0f; // Meters between the vertices of the finest level, the coarsest level is 32 km wide
+const float HORIZON_MATERIAL = 2.0f; // Same as the voxel surface
+const float HORIZON_BLEND_DROP = 3.0f; // Meters the horizon is sunk under the voxel terrain where they overlap
+
+HorizonTerrain::HorizonTerrain(TerrainGenerator* terrainGenerator, WorkerPool* workerPool, const float voxelRadius) : lastDrawCount(0), lastTriangleCount(0), terrainGenerator(terrainGenerator), workerPool(workerPool), voxelRadius(voxelRadius), holeRadius(0.0f) {
+	material = new HorizonGBufferMaterial();
+	levels.resize(HORIZON_LEVELS, { nullptr, glm::ivec2(0, 0), glm::ivec2(0, 0), false });
+}
+
+HorizonTerrain::~HorizonTerrain() {
+	for (Level& level : levels) {
+		delete level.mesh;
+	}
+	delete material;
+}
+
+glm::ivec2 HorizonTerrain::getLevelOrigin(const unsigned int level, const glm::vec3& cameraPosition) const {
+	// Centers snap to every other vertex, so the finer level inside always starts on a vertex of this one
+	const float spacing = HORIZON_BASE_SPACING * static_cast<float>(1u << level);
+	const int centerX = 2 * static_cast<int>(std::round(cameraPosition.x / (2.0f * spacing)));
+	const int centerZ = 2 * static_cast<int>(std::round(cameraPosition.z / (2.0f * spacing)));
+	return glm::ivec2(centerX - static_cast<int>(HORIZON_GRID_QUADS / 2), centerZ - static_cast<int>(HORIZON_GRID_QUADS / 2));
+}
+
+void HorizonTerrain::buildLevel(LevelGrid& grid) {
+	PROFILE_ZONE("Build horizon level");
+
+	const unsigned int vertexSide = HORIZON_GRID_QUADS + 1;
+	const float spacing = HORIZON_BASE_SPACING * static_cast<float>(1u << grid.level);
+
+	// One extra sample on every side for the normals
+	const unsigned int heightSide = vertexSide + 2;
+	std::vector<float> heights;
+	terrainGenerator->generateHeights(grid.origin.x - 1, grid.origin.y - 1, heightSide, spacing, heights);
+	auto height = [&](const unsigned int i, const unsigned int j) { return heights[(j + 1) * heightSide + (i + 1)]; };
+
+	std::vector<float> vertexHeights(vertexSide * vertexSide);
+	for (unsigned int j = 0; j < vertexSide; j++) {
+		for (unsigned int i = 0; i < vertexSide; i++) {
+			vertexHeights[j * vertexSide + i] = height(i, j);
+		}
+	}
+
+	// The coarser level only has every other vertex of the outer edge, the ones between are moved onto its edges
+	if (grid.level + 1 < HORIZON_LEVELS) {
+		for (unsigned int k = 1; k < vertexSide - 1; k += 2) {
+			const unsigned int last = vertexSide - 1;
+			vertexHeights[k] = (vertexHeights[k - 1] + vertexHeights[k + 1]) * 0.5f;
+			vertexHeights[last * vertexSide + k] = (vertexHeights[last * vertexSide + k - 1] + vertexHeights[last * vertexSide + k + 1]) * 0.5f;
+			vertexHeights[k * vertexSide] = (vertexHeights[(k - 1) * vertexSide] + vertexHeights[(k + 1) * vertexSide]) * 0.5f;
+			vertexHeights[k * vertexSide + last] = (vertexHeights[(k - 1) * vertexSide + last] + vertexHeights[(k + 1) * vertexSide + last]) * 0.5f;
+		}
+	}
+
+	grid.vertices.reserve(vertexSide * vertexSide * N_TERRAIN_VA);
+	for (unsigned int j = 0; j < vertexSide; j++) {
+		for (unsigned int i = 0; i < vertexSide; i++) {
+			const glm::vec3 normal = glm::normalize(glm::vec3(
+				(height(i - 1, j) - height(i + 1, j)) / (2.0f * spacing),
+				1.0f,
+				(height(i, j - 1) - height(i, j + 1)) / (2.0f * spacing)
+			));
+
+			grid.vertices.push_back((grid.origin.x + static_cast<int>(i)) * spacing);
+			grid.vertices.push_back(vertexHeights[j * vertexSide + i]);
+			grid.vertices.push_back((grid.origin.y + static_cast<int>(j)) * spacing);
+			grid.vertices.push_back(normal.x);
+			grid.vertices.push_back(normal.y);
+			grid.vertices.push_back(normal.z);
+			grid.vertices.push_back(HORIZON_MATERIAL);
+		}
+	}
+
+	// Quads covered by the finer level are left out. Its origin is a whole number of this level's quads
+	const glm::ivec2 innerMin = grid.innerOrigin / 2 - grid.origin;
+	const glm::ivec2 innerMax = innerMin + glm::ivec2(HORIZON_GRID_QUADS / 2, HORIZON_GRID_QUADS / 2);
+	const bool hasInner = grid.level > 0;
+
+	grid.indices.reserve(HORIZON_GRID_QUADS * HORIZON_GRID_QUADS * 6);
+	for (unsigned int j = 0; j < HORIZON_GRID_QUADS; j++) {
+		for (unsigned int i = 0; i < HORIZON_GRID_QUADS; i++) {
+			const int x = static_cast<int>(i);
+			const int z = static_cast<int>(j);
+			if (hasInner && x >= innerMin.x && x < innerMax.x && z >= innerMin.y && z < innerMax.y) continue;
+
+			const unsigned int v00 = j * vertexSide + i;
+			const unsigned int v10 = v00 + 1;
+			const unsigned int v01 = v00 + vertexSide;
+			const unsigned int v11 = v01 + 1;
+
+			// Counter clockwise seen from above
+			grid.indices.insert(grid.indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+}
+
+void HorizonTerrain::update(const glm::vec3& cameraPosition) {
+	std::vector<LevelGrid> grids;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		grids.swap(finishedLevels);
+	}
+
+	// A stale grid still beats no grid, it is replaced by the rebuild submitted below
+	for (LevelGrid& grid : grids) {
+		Level& level = levels[grid.level];
+		delete level.mesh;
+		level.mesh = grid.indices.empty() ? nullptr : new Mesh(grid.vertices, grid.indices, material);
+		level.origin = grid.origin;
+		level.innerOrigin = grid.innerOrigin;
+		level.building = false;
+	}
+
+	for (unsigned int i = 0; i < HORIZON_LEVELS; i++) {
+		Level& level = levels[i];
+		if (level.building) continue;
+
+		const glm::ivec2 origin = getLevelOrigin(i, cameraPosition);
+		const glm::ivec2 innerOrigin = i > 0 ? getLevelOrigin(i - 1, cameraPosition) : glm::ivec2(0, 0);
+		if (level.mesh != nullptr && level.origin == origin && level.innerOrigin == innerOrigin) continue;
+
+		level.building = true;
+		LevelGrid grid = { i, origin, innerOrigin, {}, {} };
+		workerPool->submit([this, grid]() mutable {
+			buildLevel(grid);
+
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			finishedLevels.push_back(std::move(grid));
+		});
+	}
+
+	// The loaded chunks are a sphere around the camera, the higher above the ground the less of the surface they cover
+	std::vector<float> groundHeight;
+	terrainGenerator->generateHeights(static_cast<int>(std::floor(cameraPosition.x)), static_cast<int>(std::floor(cameraPosition.z)), 1, 1.0f, groundHeight);
+	const float heightAboveGround = cameraPosition.y - groundHeight[0];
+	holeRadius = std::sqrt(std::max(voxelRadius * voxelRadius - heightAboveGround * heightAboveGround, 0.0f));
+}
+
+void HorizonTerrain::render() {
+	material->use();
+	material->setHole(holeRadius, HORIZON_BLEND_DROP);
+
+	lastDrawCount = 0;
+	lastTriangleCount = 0;
+	for (Level& level : levels) {
+		if (level.mesh == nullptr) continue;
+
+		level.mesh->render();
+		lastDrawCount++;
+		lastTriangleCount += level.mesh->ebo->numberOfElements / 3;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <mutex>
+#include <vector>
+#include "TerrainGenerator.h"
+#include "WorkerPool.h"
+#include "Mesh.h"
+#include "MoreMaterials.h"
+
+/*
+Far terrain beyond the voxel chunks: a geometry clipmap of the heightmap surface.
+
+Every level is a square grid of the same number of quads centered on the camera, each one twice as
+coarse and twice as wide as the previous. A level leaves out the square covered by the finer level
+inside it, and the outer edge of each level is bent to follow the coarser level so they meet without
+cracks. Grids are rebuilt on the workers when the camera has moved far enough for a level to shift.
+
+Near the camera the voxel terrain is drawn instead: the shader drops the horizon below it where
+both overlap and discards it inside the loaded chunks.
+*/
+class HorizonTerrain {
+public:
+	HorizonTerrain(TerrainGenerator* terrainGenerator, WorkerPool* workerPool, const float voxelRadius);
+	~HorizonTerrain(); // The worker pool must be stopped first
+
+	void update(const glm::vec3& cameraPosition); // Main thread, submits rebuilds and uploads finished levels
+	void render(); // During the G-buffer pass
+
+	unsigned int lastDrawCount; // One draw per built level
+	unsigned int lastTriangleCount;
+
+private:
+	struct LevelGrid {
+		unsigned int level;
+		glm::ivec2 origin; // In units of the level's spacing
+		glm::ivec2 innerOrigin; // Of the finer level, in units of its own spacing
+		std::vector<float> vertices;
+		std::vector<unsigned int> indices;
+	};
+
+	struct Level {
+		Mesh* mesh;
+		glm::ivec2 origin;
+		glm::ivec2 innerOrigin;
+		bool building;
+	};
+
+	glm::ivec2 getLevelOrigin(const unsigned int level, const glm::vec3& cameraPosition) const;
+	void buildLevel(LevelGrid& grid);
+
+	TerrainGenerator* terrainGenerator;
+	WorkerPool* workerPool;
+	HorizonGBufferMaterial* material;
+	float voxelRadius;
+	float holeRadius;
+
+	std::vector<Level> levels;
+
+	std::mutex finishedMutex;
+	std::vector<LevelGrid> finishedLevels;
+};
@@ -1,7 +1,12 @@
 #include <iostream>
 #include "Engine.h"
+#include "Benchmarks.h"
+#include "Tests.h"
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <string>
+#include <vector>
 
 void fixNewLines(std::string& msg) {
 	std::string::size_type pos = 0;
@@ -13,11 +18,19 @@ void fixNewLines(std::string& msg) {
 	
 }
 
-int main() {
+int main(int argc, char** argv) {
 
 	try {
 		std::cout << "Hello, Advanced Engine!" << std::endl;
 
+		if (argc >= 3 && std::string(argv[1]) == "--bench") {
+			const std::vector<std::string> options(argv + 3, argv + argc);
+			return runBenchmark(argv[2], options) ? 0 : 1;
+		}
+		if (argc >= 3 && std::string(argv[1]) == "--test") {
+			return runTest(argv[2]) ? 0 : 1;
+		}
+
 		Engine* engine = new Engine();
 
 		engine->run();
@@ -27,9 +40,13 @@ int main() {
 	}
 	catch (const std::exception& e) {
 		std::string bottomText = std::string("The game has crashed with the following error: \n\n") + e.what();
-		fixNewLines(bottomText);
 
+#ifdef _WIN32
+		fixNewLines(bottomText);
 		MessageBoxA(NULL, bottomText.c_str(), "Unhandled exception: Game crashed!", MB_OK | MB_ICONERROR);
+#else
+		std::cerr << bottomText << std::endl;
+#endif
 
 		return 1;
 	}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+A read-only memory mapped file. The pages are loaded by the OS on first access, nothing is copied.
+isOpen() is false when the file doesn't exist or can't be mapped, empty files are never mapped.
+*/
+class MappedFile {
+public:
+	MappedFile();
+	MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	const unsigned char* data;
+	size_t size;
+
+private:
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
@@ -1,6 +1,7 @@
 #include "MarchingCubesGenerator.h"
 #include "Settings.h"
 #include "TriangulationTables.h"
+#include "ChunkHalo.h"
 #include <cmath>
 #include <unordered_map>
 #include <glm/glm.hpp>
@@ -38,21 +39,18 @@ MarchingCubeGenerator::MarchingCubeGenerator(const float& threshold) : threshold
 
 }
 
-std::vector<float> MarchingCubeGenerator::generateMesh(std::vector<float> densities, std::vector<unsigned int> materials, const unsigned int& detailLevel) {
+std::vector<float> MarchingCubeGenerator::generateMesh(const std::vector<float>& densities, const std::vector<unsigned int>& materials, const unsigned int& detailLevel, const ChunkHalo* halo) {
 	std::vector<float> vertices = {};
 	
 	size_t notEmptyCount = 0;
 
-	std::cout << "Densities has a length of: " << densities.size() << std::endl;
-
-
 	for (unsigned int y = 0; y < ((CHUNK_SIZE) / detailLevel); y++) {
 		for (unsigned int x = 0; x < ((CHUNK_SIZE) / detailLevel); x++) {
 			for (unsigned int z = 0; z < ((CHUNK_SIZE) / detailLevel); z++) {
 
 				
 
-				const std::vector<float> cellVertices = buildCell(x, y, z, densities, materials, detailLevel);
+				const std::vector<float> cellVertices = buildCell(x, y, z, densities, materials, detailLevel, halo);
 
 				for (const float vertex : cellVertices) {
 					notEmptyCount++;
@@ -67,7 +65,20 @@ std::vector<float> MarchingCubeGenerator::generateMesh(std::vector<float> densit
 	return vertices;
 }
 
-float MarchingCubeGenerator::getDensityAtPoint(std::vector<float>& densities, const unsigned int& x, const unsigned int& y, const unsigned int& z) {
+void MarchingCubeGenerator::generateCells(const std::vector<float>& densities, const std::vector<unsigned int>& materials, const glm::ivec3& min, const glm::ivec3& max, std::vector<float>& vertices, std::vector<unsigned int>& cellVertexCounts, const ChunkHalo* halo) {
+	for (int y = min.y; y < max.y; y++) {
+		for (int x = min.x; x < max.x; x++) {
+			for (int z = min.z; z < max.z; z++) {
+				const std::vector<float> cellVertices = buildCell(x, y, z, densities, materials, 1, halo);
+
+				vertices.insert(vertices.end(), cellVertices.begin(), cellVertices.end());
+				cellVertexCounts.push_back(cellVertices.size() / N_TERRAIN_VA);
+			}
+		}
+	}
+}
+
+float MarchingCubeGenerator::getDensityAtPoint(const std::vector<float>& densities, const unsigned int& x, const unsigned int& y, const unsigned int& z) {
 #ifdef _DEBUG
 	const unsigned int index = z + x * (CHUNK_SIZE + 1) + y * (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1);
 	if (index >= densities.size()) {
@@ -118,35 +129,49 @@ struct VertexMapItem {
 	unsigned int index;
 };
 
-void addVertex(const Vector3& a, const Vector3& b, const Vector3& c, std::vector<float>& vertices, float material) {
+// Densities grow towards the solid side, the surface normal is the opposite of the gradient
+static glm::vec3 getGradientNormal(const ChunkHalo* halo, const glm::vec3& position, const glm::vec3& faceNormal) {
+	if (halo == nullptr) return faceNormal;
+
+	const glm::vec3 gradient = halo->getGradient(position);
+	const float length = glm::length(gradient);
+	if (length < 1e-6f) return faceNormal; // Flat density, e.g. inside a fully carved sample
+
+	return gradient * (-1.0f / length);
+}
+
+void addVertex(const Vector3& a, const Vector3& b, const Vector3& c, std::vector<float>& vertices, float material, const ChunkHalo* halo) {
 	glm::vec3 A = glm::vec3(a.x, a.y, a.z);
 	glm::vec3 B = glm::vec3(b.x, b.y, b.z);
 	glm::vec3 C = glm::vec3(c.x, c.y, c.z);
 
 	glm::vec3 normal = glm::normalize(glm::cross(B - A, C - A));
+	const glm::vec3 normalA = getGradientNormal(halo, A, normal);
+	const glm::vec3 normalB = getGradientNormal(halo, B, normal);
+	const glm::vec3 normalC = getGradientNormal(halo, C, normal);
 
 	vertices.push_back(a.x);
 	vertices.push_back(a.y);
 	vertices.push_back(a.z);
-	vertices.push_back(normal.x);
-	vertices.push_back(normal.y);
-	vertices.push_back(normal.z);
+	vertices.push_back(normalA.x);
+	vertices.push_back(normalA.y);
+	vertices.push_back(normalA.z);
 	vertices.push_back(material);
 
 	vertices.push_back(b.x);
 	vertices.push_back(b.y);
 	vertices.push_back(b.z);
-	vertices.push_back(normal.x);
-	vertices.push_back(normal.y);
-	vertices.push_back(normal.z);
+	vertices.push_back(normalB.x);
+	vertices.push_back(normalB.y);
+	vertices.push_back(normalB.z);
 	vertices.push_back(material);
 
 	vertices.push_back(c.x);
 	vertices.push_back(c.y);
 	vertices.push_back(c.z);
-	vertices.push_back(normal.x);
-	vertices.push_back(normal.y);
-	vertices.push_back(normal.z);
+	vertices.push_back(normalC.x);
+	vertices.push_back(normalC.y);
+	vertices.push_back(normalC.z);
 	vertices.push_back(material);
 
 
@@ -154,7 +179,7 @@ void addVertex(const Vector3& a, const Vector3& b, const Vector3& c, std::vector
 
 
 
-std::vector<float> MarchingCubeGenerator::buildCell(const unsigned int& localX, const unsigned int& localY, const unsigned int& localZ, std::vector<float>& densities, std::vector<unsigned int>& materials, const unsigned int& detailLevel) {
+std::vector<float> MarchingCubeGenerator::buildCell(const unsigned int& localX, const unsigned int& localY, const unsigned int& localZ, const std::vector<float>& densities, const std::vector<unsigned int>& materials, const unsigned int& detailLevel, const ChunkHalo* halo) {
 	std::vector<float> vertices;
 	
 	const Vector3 point0 = { static_cast<float>(localX), static_cast<float>(localY), static_cast<float>(localZ) };
@@ -231,7 +256,7 @@ std::vector<float> MarchingCubeGenerator::buildCell(const unsigned int& localX,
 
 
 
-		addVertex(v1, v3, v2, vertices, static_cast<float>(materials[index]));
+		addVertex(v1, v3, v2, vertices, static_cast<float>(materials[index]), halo);
 	
 	}
 
@@ -239,4 +264,60 @@ std::vector<float> MarchingCubeGenerator::buildCell(const unsigned int& localX,
 
 	return vertices;
 	
-}
\ No newline at end of file
+}
+
+// Corner offsets and edges in the same order as point0..point7 in buildCell
+const unsigned int cellCornerOffsets[8][3] = {
+	{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1},
+	{0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}
+};
+
+const unsigned int cellEdgeCorners[12][2] = {
+	{0, 1}, {1, 2}, {2, 3}, {3, 0},
+	{4, 5}, {5, 6}, {6, 7}, {7, 4},
+	{0, 4}, {1, 5}, {2, 6}, {3, 7}
+};
+
+unsigned int MarchingCubeGenerator::triangulateCell(const float* densities, const unsigned int& x, const unsigned int& y, const unsigned int& z, const float& isoLevel, glm::vec3* outVertices) {
+	Vector3 cornerPositions[8];
+	float cornerDensities[8];
+	unsigned int cubeIndex = 0;
+
+	for (unsigned int i = 0; i < 8; i++) {
+		const unsigned int cornerX = x + cellCornerOffsets[i][0];
+		const unsigned int cornerY = y + cellCornerOffsets[i][1];
+		const unsigned int cornerZ = z + cellCornerOffsets[i][2];
+
+		cornerPositions[i] = { static_cast<float>(cornerX), static_cast<float>(cornerY), static_cast<float>(cornerZ) };
+		cornerDensities[i] = densities[sampleIndex(cornerX, cornerY, cornerZ)];
+
+		if (cornerDensities[i] < isoLevel) cubeIndex |= 1 << i;
+	}
+
+	if (edgeTable[cubeIndex] == 0) {
+		return 0;
+	}
+
+	Vector3 edgeVertices[12];
+	for (unsigned int edge = 0; edge < 12; edge++) {
+		if (edgeTable[cubeIndex] & (1 << edge)) {
+			const unsigned int a = cellEdgeCorners[edge][0];
+			const unsigned int b = cellEdgeCorners[edge][1];
+			edgeVertices[edge] = VertexInterp(isoLevel, cornerPositions[a], cornerPositions[b], cornerDensities[a], cornerDensities[b]);
+		}
+	}
+
+	unsigned int numVertices = 0;
+	for (unsigned int i = 0; triTable[cubeIndex][i] != -1; i += 3) {
+		const Vector3& v1 = edgeVertices[triTable[cubeIndex][i]];
+		const Vector3& v2 = edgeVertices[triTable[cubeIndex][i + 1]];
+		const Vector3& v3 = edgeVertices[triTable[cubeIndex][i + 2]];
+
+		// Same v1, v3, v2 order as buildCell uses
+		outVertices[numVertices++] = glm::vec3(v1.x, v1.y, v1.z);
+		outVertices[numVertices++] = glm::vec3(v3.x, v3.y, v3.z);
+		outVertices[numVertices++] = glm::vec3(v2.x, v2.y, v2.z);
+	}
+
+	return numVertices / 3;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <vector>
+#include <glm/glm.hpp>
+
+class ChunkHalo;
 
 struct MarchingCubesResult {
 	std::vector<float> vertices; // x, y, z, nx, ny, nz
@@ -11,11 +14,18 @@ class MarchingCubeGenerator {
 public:
 	MarchingCubeGenerator(const float& threshold);
 
-	std::vector<float> generateMesh(std::vector<float> densities, std::vector<unsigned int> materials, const unsigned int& detailLevel);
+	// With a halo the normals are the density gradient, smooth across cells and chunk borders, otherwise each triangle gets its face normal
+	std::vector<float> generateMesh(const std::vector<float>& densities, const std::vector<unsigned int>& materials, const unsigned int& detailLevel, const ChunkHalo* halo = nullptr);
+
+	// Meshes the cells in [min, max) at full detail, appending their vertices in the same order as generateMesh and the vertex count of each cell to cellVertexCounts
+	void generateCells(const std::vector<float>& densities, const std::vector<unsigned int>& materials, const glm::ivec3& min, const glm::ivec3& max, std::vector<float>& vertices, std::vector<unsigned int>& cellVertexCounts, const ChunkHalo* halo = nullptr);
+
+	// Triangulates a single cell of a chunk density grid into outVertices (room for 15), with the same corners and winding as generateMesh. Returns the number of triangles.
+	static unsigned int triangulateCell(const float* densities, const unsigned int& x, const unsigned int& y, const unsigned int& z, const float& isoLevel, glm::vec3* outVertices);
 
 	float threshold;
 private:
-	std::vector<float> buildCell(const unsigned int& localX, const unsigned int& localY, const unsigned int& localZ, std::vector<float>& densities, std::vector<unsigned int>& materials, const unsigned int& detailLevel);
+	std::vector<float> buildCell(const unsigned int& localX, const unsigned int& localY, const unsigned int& localZ, const std::vector<float>& densities, const std::vector<unsigned int>& materials, const unsigned int& detailLevel, const ChunkHalo* halo);
 
-	float getDensityAtPoint(std::vector<float>& densities, const unsigned int& x, const unsigned int& y, const unsigned int& z);
+	float getDensityAtPoint(const std::vector<float>& densities, const unsigned int& x, const unsigned int& y, const unsigned int& z);
 };
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "Material.h"
+#include "ProgramBinaryCache.h"
+#include <chrono>
 #include <stdexcept>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -8,29 +10,40 @@ Material::Material(const char* vertexShaderSource, const char* fragmentShaderSou
 	}
 
 	shaderProgram = new ShaderProgram();
-	Shader vertexShader(vertexShaderSource, GL_VERTEX_SHADER);
-	vertexShader.compile();
-	shaderProgram->attachShader(vertexShader);
-	Shader fragmentShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
-	fragmentShader.compile();
-	shaderProgram->attachShader(fragmentShader);
-	shaderProgram->link();
-	
+
+	const uint64_t cacheKey = ProgramBinaryCache::makeKey({ vertexShaderSource, fragmentShaderSource });
+	if (!ProgramBinaryCache::load(*shaderProgram, cacheKey)) {
+		// A rejected binary leaves the program unlinked, start over with a fresh one
+		delete shaderProgram;
+		shaderProgram = new ShaderProgram();
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		Shader vertexShader(vertexShaderSource, GL_VERTEX_SHADER);
+		vertexShader.compile();
+		shaderProgram->attachShader(vertexShader);
+		Shader fragmentShader(fragmentShaderSource, GL_FRAGMENT_SHADER);
+		fragmentShader.compile();
+		shaderProgram->attachShader(fragmentShader);
+		shaderProgram->link();
+
+		const double compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		ProgramBinaryCache::recordCompile(compileMilliseconds);
+		ProgramBinaryCache::store(*shaderProgram, cacheKey, compileMilliseconds);
+	}
+
+	modelMatrixLocation = getUniformLocation("uModelMatrix");
 
 	this->vertexAttributes = vertexAttributes;
 }
 
-void Material::use() {
-	shaderProgram->use();
+Material::~Material() {
+	delete shaderProgram;
 }
-void Material::setMatrices(Camera* camera) {
-	int viewMatrixLoc = getUniformLocation("uViewMatrix");
-	int projectionMatrixLoc = getUniformLocation("uProjectionMatrix");
 
-	glUniformMatrix4fv(viewMatrixLoc, 1, GL_FALSE, glm::value_ptr(camera->viewMatrix));
-	glUniformMatrix4fv(projectionMatrixLoc, 1, GL_FALSE, glm::value_ptr(camera->projectionMatrix));
+void Material::use() {
+	shaderProgram->use();
 }
-
 int Material::getUniformLocation(const char* name) {
 	return shaderProgram->getUniformLocation(name);
 }	
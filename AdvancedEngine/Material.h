@@ -7,13 +7,15 @@
 class Material {
 public:
 	Material(const char* vertexShaderSource, const char* fragmentShaderSource, std::vector<VertexAttribute> vertexAttributes);
+	virtual ~Material(); // Deletes the shader program
 
 	ShaderProgram* shaderProgram;
 
 	virtual void use();
 	virtual void use2(Camera* camera);
 	int getUniformLocation(const char* name);
-	void setMatrices(Camera* camera);
+
+	int modelMatrixLocation; // -1 when the shader has no uModelMatrix
 
 
 
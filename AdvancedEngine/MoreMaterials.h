@@ -5,13 +5,21 @@
 #include <glad/gl.h>
 #include "Settings.h"
 
+// Camera uniforms shared by every shader, filled once per frame from a UniformBuffer, see CameraUniforms.
+// A literal so the sources below stay compile time constants, it goes after their #version line
+#define CAMERA_DATA_BLOCK \
+	"layout (std140, binding = 0) uniform CameraData {\n" \
+	"	mat4 uViewMatrix;\n" \
+	"	mat4 uProjectionMatrix;\n" \
+	"	mat4 uInverseViewProjection;\n" \
+	"	vec4 uCameraPosition;\n" \
+	"};\n"
+
 constexpr const char* transformVertexShaderSource = R"(
 #version 460 core
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-
+)" CAMERA_DATA_BLOCK R"(
 layout (location = 0) in vec3 aPos;
 
 void main() {
@@ -23,9 +31,7 @@ constexpr const char* terrainVertexShaderSource = R"(
 #version 460 core
 
 uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
-
+)" CAMERA_DATA_BLOCK R"(
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 
@@ -116,9 +122,11 @@ void main() {
 constexpr const char* gBufferTerrainVertexShaderSource = R"(
 #version 460 core
 
-uniform mat4 uModelMatrix;
-uniform mat4 uViewMatrix;
-uniform mat4 uProjectionMatrix;
+)" CAMERA_DATA_BLOCK R"(
+// One origin per chunk of the multi draw, indexed by gl_DrawID
+layout (std430, binding = 0) readonly buffer ChunkOffsets {
+	vec4 uChunkOffsets[];
+};
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
@@ -129,7 +137,7 @@ out vec3 vPos;
 flat out uint vMaterial;
 
 void main() {
-	vec4 worldPos = uModelMatrix * vec4(aPos, 1.0);
+	vec4 worldPos = vec4(aPos + uChunkOffsets[gl_DrawID].xyz, 1.0);
 	gl_Position = uProjectionMatrix * uViewMatrix * worldPos;
 	vNormal = aNormal;
 	vPos = worldPos.xyz;
@@ -144,19 +152,26 @@ constexpr const char* gBufferTerrainFragmentShaderSource = R"(
 uniform int uAtlasWidth;
 uniform int uAtlasHeight;
 
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec2 gSkyMaterial;
+// World position isn't stored, the deferred pass rebuilds it from the depth buffer
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec2 gSkyMaterial;
 
 in vec3 vNormal;
 in vec3 vPos;
 flat in uint vMaterial;
 
+// Octahedral encoding, the unit sphere folded onto a square, remapped to [0, 1] for the RG16 target
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return n.xy * 0.5 + 0.5;
+}
 
 void main() {
 	
-	gPosition = vPos;
-	gNormal = (vNormal * 0.5) + vec3(0.5);
+	gNormal = encodeNormal(normalize(vNormal));
     gSkyMaterial = vec2(1.0, float(vMaterial) / 255.0);
 
 }
@@ -196,6 +211,90 @@ public:
 
 };
 
+constexpr const char* gBufferHorizonVertexShaderSource = R"(
+#version 460 core
+
+)" CAMERA_DATA_BLOCK R"(
+uniform float uHoleRadius;
+uniform float uBlendDrop;
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in float aMaterial;
+
+out vec3 vNormal;
+out vec3 vPos;
+flat out uint vMaterial;
+
+void main() {
+	// Sunk under the voxel terrain near the loaded chunks so the detailed surface wins the depth test
+	float distance = length(aPos.xz - uCameraPosition.xz);
+	vec3 pos = aPos;
+	pos.y -= uBlendDrop * (1.0 - smoothstep(uHoleRadius, 2.0 * uHoleRadius, distance));
+
+	gl_Position = uProjectionMatrix * uViewMatrix * vec4(pos, 1.0);
+	vNormal = aNormal;
+	vPos = pos;
+	vMaterial = uint(aMaterial);
+}
+
+)";
+
+constexpr const char* gBufferHorizonFragmentShaderSource = R"(
+#version 460 core
+
+// Fragments closer than this are inside the loaded chunks
+uniform float uHoleRadius;
+
+)" CAMERA_DATA_BLOCK R"(
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec2 gSkyMaterial;
+
+in vec3 vNormal;
+in vec3 vPos;
+flat in uint vMaterial;
+
+// Same encoding as the voxel terrain
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return n.xy * 0.5 + 0.5;
+}
+
+void main() {
+	if (length(vPos.xz - uCameraPosition.xz) < uHoleRadius) discard;
+
+	gNormal = encodeNormal(normalize(vNormal));
+	gSkyMaterial = vec2(1.0, float(vMaterial) / 255.0);
+}
+)";
+
+class HorizonGBufferMaterial : public Material {
+public:
+	HorizonGBufferMaterial() : Material(gBufferHorizonVertexShaderSource, gBufferHorizonFragmentShaderSource,
+
+		{
+			{ sizeof(float) * 3, 3, GL_FLOAT, GL_FALSE }, // position
+			{ sizeof(float) * 3, 3, GL_FLOAT, GL_FALSE },  // normal
+			{ sizeof(float) * 1, 1, GL_FLOAT, GL_FALSE}, // material
+		}
+	)
+	{
+	};
+
+	void use() override {
+		shaderProgram->use();
+	}
+
+	void setHole(const float holeRadius, const float blendDrop) {
+		glUniform1f(getUniformLocation("uHoleRadius"), holeRadius);
+		glUniform1f(getUniformLocation("uBlendDrop"), blendDrop);
+	}
+
+};
+
 constexpr const char* deferredShadingVertex = R"(
 #version 460 core
 
@@ -215,10 +314,9 @@ constexpr const char* deferredShadingFragment = R"(
 #version 460 core
 
 uniform sampler2D gNormal;
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gSkyMaterial;
-uniform vec3 uCameraPosition;
-
+)" CAMERA_DATA_BLOCK R"(
 uniform sampler2D uAlbedo;
 uniform sampler2D uNormal;
 uniform sampler2D uRoughness;
@@ -426,6 +524,21 @@ vec3 PBRLighting(vec3 N, vec3 V, vec3 L,
 
 }
 
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv) {
+    float depth = texture(gDepth, uv).r;
+    vec4 clipPosition = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    vec4 worldPosition = uInverseViewProjection * clipPosition;
+    return worldPosition.xyz / worldPosition.w;
+}
+
 const vec3 lightDirection = normalize(vec3(-1.0, -1.0, -1.0));
 const vec3 lightColor = vec3(4.0);
 const float CULLING_DISTANCE_SQUARED = 150.0 * 150.0;
@@ -436,11 +549,11 @@ void main() {
     if (skyMaterial.r < 1.0) discard;
     float material = float(skyMaterial.y * 255.0);
 
-    vec3 fragPosition = texture(gPosition, vUv).rgb;
+    vec3 fragPosition = reconstructPosition(vUv);
 
-    float distanceSquared = dot(fragPosition - uCameraPosition, fragPosition - uCameraPosition);
+    float distanceSquared = dot(fragPosition - uCameraPosition.xyz, fragPosition - uCameraPosition.xyz);
 
-    vec3 vNormal = ((texture(gNormal, vUv).rgb) * 2) - vec3(1.0);
+    vec3 vNormal = decodeNormal(texture(gNormal, vUv).rg);
     vec3 albedo = pow(getTextureColor(uAlbedo, fragPosition, vNormal, material), vec3(2.2));
 
     if (distanceSquared < CULLING_DISTANCE_SQUARED) {
@@ -455,7 +568,7 @@ void main() {
             ///// Physically based rendering /////
     
 
-            vec3 V = normalize(uCameraPosition - fragPosition);
+            vec3 V = normalize(uCameraPosition.xyz - fragPosition);
             vec3 L = normalize(-lightDirection);
     
             vec3 Lo =  PBRLighting(normal, V, L, albedo, metallic, roughness, lightColor);
@@ -496,9 +609,25 @@ public:
 			{ sizeof(float) * 3, 3, GL_FLOAT, GL_FALSE }, // position
 			{ sizeof(float) * 2, 2, GL_FLOAT, GL_FALSE }, // uv
 		}
-	), normalMapTexture(nullptr), albedoTexture(nullptr), roughnessTexture(nullptr), metallicTexture(nullptr)
+	), normalMapTexture(nullptr), albedoTexture(nullptr), roughnessTexture(nullptr), metallicTexture(nullptr), aoTexture(nullptr)
 	{
+		// Texture units and sizes never change, so they are set once here. The camera comes from the CameraData block.
+		shaderProgram->use();
 
+		glUniform1i(getUniformLocation("gDepth"), 0);
+		glUniform1i(getUniformLocation("gNormal"), 1);
+		glUniform1i(getUniformLocation("gSkyMaterial"), 2);
+
+		glUniform1i(getUniformLocation("uAlbedo"), 4);
+		glUniform1i(getUniformLocation("uNormal"), 5);
+		glUniform1i(getUniformLocation("uRoughness"), 6);
+		glUniform1i(getUniformLocation("uMetallic"), 7);
+		glUniform1i(getUniformLocation("uAo"), 8);
+
+		glUniform1i(getUniformLocation("uWidth"), PBR_SIZE);
+		glUniform1i(getUniformLocation("uHeight"), PBR_SIZE * N_MATERIALS);
+
+		glUseProgram(0);
 	}
 
 	void use() override {
@@ -509,20 +638,6 @@ public:
     void use2(Camera* camera) override {
         shaderProgram->use();
 
-        int gNormalLoc = getUniformLocation("gNormal");
-        //int gAlbedoLoc = getUniformLocation("gAlbedo");
-        int gPositionLoc = getUniformLocation("gPosition");
-       // int gRoughnessMetallicAo = getUniformLocation("gRoughnessMetallicAo");
-        int uCameraPositionLoc = getUniformLocation("uCameraPosition");
-        int gSkyMaterialLoc = getUniformLocation("gSkyMaterial");
-
-        glUniform1i(gPositionLoc, 0);
-       // glUniform1i(gAlbedoLoc, 1);
-        glUniform1i(gNormalLoc, 1);
-        //glUniform1i(gRoughnessMetallicAo, 3);
-        glUniform3f(uCameraPositionLoc, camera->position.x, camera->position.y, camera->position.z);
-        glUniform1i(gSkyMaterialLoc, 2);
-
         if (albedoTexture != nullptr) {
             glActiveTexture(GL_TEXTURE4);
             glBindTexture(GL_TEXTURE_2D, albedoTexture->textureID);
@@ -546,24 +661,6 @@ public:
             glActiveTexture(GL_TEXTURE8);
             glBindTexture(GL_TEXTURE_2D, aoTexture->textureID);
         }
-
-        int albedoTextureLoc = getUniformLocation("uAlbedo");
-        int normalTextureLoc = getUniformLocation("uNormal");
-        int roughnessTextureLoc = getUniformLocation("uRoughness");
-        int metallicTextureLoc = getUniformLocation("uMetallic");
-        int aoTextureLoc = getUniformLocation("uAo");
-
-        glUniform1i(albedoTextureLoc, 4);
-        glUniform1i(normalTextureLoc, 5);
-        glUniform1i(roughnessTextureLoc, 6);
-        glUniform1i(metallicTextureLoc, 7);
-        glUniform1i(aoTextureLoc, 8);
-
-        int uWidthLoc = getUniformLocation("uWidth");
-        int uHeightLoc = getUniformLocation("uHeight");
-
-        glUniform1i(uWidthLoc, PBR_SIZE);
-        glUniform1i(uHeightLoc, PBR_SIZE * N_MATERIALS);
     }
 
     Texture* normalMapTexture;
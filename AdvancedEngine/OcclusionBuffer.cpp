@@ -0,0 +1,227 @@
+#include "OcclusionBuffer.h"
+#include "Settings.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Occluders are built from blocks of this many cells per axis
+const unsigned int OCCLUDER_BLOCK_SIZE = 8;
+const unsigned int OCCLUDER_BLOCKS = (CHUNK_SIZE + OCCLUDER_BLOCK_SIZE - 1) / OCCLUDER_BLOCK_SIZE;
+
+// Points closer than this (in clip space w) can't be projected reliably
+const float MIN_PROJECTED_W = 0.1f;
+
+std::vector<OccluderBox> buildOccluderBoxes(const std::vector<float>& densities, const float isoLevel) {
+	const unsigned int blockCount = OCCLUDER_BLOCKS * OCCLUDER_BLOCKS * OCCLUDER_BLOCKS;
+	auto blockIndex = [](const unsigned int x, const unsigned int y, const unsigned int z) {
+		return x + z * OCCLUDER_BLOCKS + y * OCCLUDER_BLOCKS * OCCLUDER_BLOCKS;
+	};
+
+	// A block is solid when all the samples of its cells are, then the surface can't pass through it
+	std::vector<bool> solid(blockCount, false);
+
+	for (unsigned int by = 0; by < OCCLUDER_BLOCKS; by++) {
+		for (unsigned int bx = 0; bx < OCCLUDER_BLOCKS; bx++) {
+			for (unsigned int bz = 0; bz < OCCLUDER_BLOCKS; bz++) {
+				const unsigned int endX = std::min((bx + 1) * OCCLUDER_BLOCK_SIZE, CHUNK_SIZE);
+				const unsigned int endY = std::min((by + 1) * OCCLUDER_BLOCK_SIZE, CHUNK_SIZE);
+				const unsigned int endZ = std::min((bz + 1) * OCCLUDER_BLOCK_SIZE, CHUNK_SIZE);
+
+				bool isSolid = true;
+				for (unsigned int y = by * OCCLUDER_BLOCK_SIZE; y <= endY && isSolid; y++) {
+					for (unsigned int x = bx * OCCLUDER_BLOCK_SIZE; x <= endX && isSolid; x++) {
+						for (unsigned int z = bz * OCCLUDER_BLOCK_SIZE; z <= endZ && isSolid; z++) {
+							isSolid = densities[sampleIndex(x, y, z)] >= isoLevel;
+						}
+					}
+				}
+				solid[blockIndex(bx, by, bz)] = isSolid;
+			}
+		}
+	}
+
+	// Greedy merge into as few boxes as possible: grow along z, then x, then y
+	std::vector<OccluderBox> boxes;
+	std::vector<bool> used(blockCount, false);
+
+	for (unsigned int by = 0; by < OCCLUDER_BLOCKS; by++) {
+		for (unsigned int bx = 0; bx < OCCLUDER_BLOCKS; bx++) {
+			for (unsigned int bz = 0; bz < OCCLUDER_BLOCKS; bz++) {
+				if (!solid[blockIndex(bx, by, bz)] || used[blockIndex(bx, by, bz)]) continue;
+
+				auto isFree = [&](const unsigned int x, const unsigned int y, const unsigned int z) {
+					return solid[blockIndex(x, y, z)] && !used[blockIndex(x, y, z)];
+				};
+
+				unsigned int endZ = bz + 1;
+				while (endZ < OCCLUDER_BLOCKS && isFree(bx, by, endZ)) endZ++;
+
+				unsigned int endX = bx + 1;
+				while (endX < OCCLUDER_BLOCKS) {
+					bool rowFree = true;
+					for (unsigned int z = bz; z < endZ && rowFree; z++) rowFree = isFree(endX, by, z);
+					if (!rowFree) break;
+					endX++;
+				}
+
+				unsigned int endY = by + 1;
+				while (endY < OCCLUDER_BLOCKS) {
+					bool layerFree = true;
+					for (unsigned int x = bx; x < endX && layerFree; x++) {
+						for (unsigned int z = bz; z < endZ && layerFree; z++) layerFree = isFree(x, endY, z);
+					}
+					if (!layerFree) break;
+					endY++;
+				}
+
+				for (unsigned int y = by; y < endY; y++) {
+					for (unsigned int x = bx; x < endX; x++) {
+						for (unsigned int z = bz; z < endZ; z++) used[blockIndex(x, y, z)] = true;
+					}
+				}
+
+				boxes.push_back({
+					glm::vec3(bx, by, bz) * static_cast<float>(OCCLUDER_BLOCK_SIZE),
+					glm::min(glm::vec3(endX, endY, endZ) * static_cast<float>(OCCLUDER_BLOCK_SIZE), glm::vec3(CHUNK_SIZE))
+				});
+			}
+		}
+	}
+
+	return boxes;
+}
+
+OcclusionBuffer::OcclusionBuffer(const unsigned int width, const unsigned int height) : width(width), height(height), depth(width * height, 1.0f), viewProjection(1.0f) {
+
+}
+
+void OcclusionBuffer::setViewProjection(const glm::mat4& viewProjection) {
+	this->viewProjection = viewProjection;
+}
+
+void OcclusionBuffer::clearRows(const unsigned int firstRow, const unsigned int endRow) {
+	std::fill(depth.begin() + firstRow * width, depth.begin() + endRow * width, 1.0f);
+}
+
+bool OcclusionBuffer::projectPoint(const glm::vec3& point, glm::vec3& outScreen) const {
+	const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+	if (clip.w < MIN_PROJECTED_W) return false;
+
+	outScreen = glm::vec3(
+		(clip.x / clip.w * 0.5f + 0.5f) * width,
+		(clip.y / clip.w * 0.5f + 0.5f) * height,
+		clip.z / clip.w
+	);
+	return true;
+}
+
+void OcclusionBuffer::rasterizeBox(const OccluderBox& box, const unsigned int firstRow, const unsigned int endRow) {
+	glm::vec3 corners[8];
+	for (unsigned int i = 0; i < 8; i++) {
+		const glm::vec3 corner(
+			(i & 1) ? box.max.x : box.min.x,
+			(i & 2) ? box.max.y : box.min.y,
+			(i & 4) ? box.max.z : box.min.z
+		);
+		// Occluders crossing the near plane are skipped, that only loses some occlusion
+		if (!projectPoint(corner, corners[i])) return;
+	}
+
+	static const unsigned int faces[6][4] = {
+		{ 0, 2, 6, 4 }, { 1, 3, 7, 5 }, // -x, +x
+		{ 0, 1, 5, 4 }, { 2, 3, 7, 6 }, // -y, +y
+		{ 0, 1, 3, 2 }, { 4, 5, 7, 6 }  // -z, +z
+	};
+
+	// Back faces are always behind the front ones, so they never win the depth test
+	for (const auto& face : faces) {
+		const glm::vec3 faceCorners[4] = { corners[face[0]], corners[face[1]], corners[face[2]], corners[face[3]] };
+		rasterizeQuad(faceCorners, firstRow, endRow);
+	}
+}
+
+void OcclusionBuffer::rasterizeQuad(const glm::vec3* corners, const unsigned int firstRow, const unsigned int endRow) {
+	float area = 0.0f;
+	for (unsigned int i = 0; i < 4; i++) {
+		const glm::vec3& from = corners[i];
+		const glm::vec3& to = corners[(i + 1) % 4];
+		area += from.x * to.y - to.x * from.y;
+	}
+	if (std::abs(area) < 1e-6f) return; // Seen edge-on
+
+	// Edge functions of the form e(x, y) = stepX * x + stepY * y + offset, positive inside whatever the winding
+	const float sign = area > 0.0f ? 1.0f : -1.0f;
+	float stepX[4], stepY[4], offset[4];
+	for (unsigned int i = 0; i < 4; i++) {
+		const glm::vec3& from = corners[i];
+		const glm::vec3& to = corners[(i + 1) % 4];
+		stepX[i] = -(to.y - from.y) * sign;
+		stepY[i] = (to.x - from.x) * sign;
+		offset[i] = -(stepX[i] * from.x + stepY[i] * from.y);
+
+		// Evaluate at the pixel corner furthest outside, so only fully covered pixels pass
+		offset[i] -= 0.5f * (std::abs(stepX[i]) + std::abs(stepY[i]));
+	}
+
+	// The farthest corner keeps the written depth conservative
+	glm::vec3 quadMin = corners[0];
+	glm::vec3 quadMax = corners[0];
+	for (unsigned int i = 1; i < 4; i++) {
+		quadMin = glm::min(quadMin, corners[i]);
+		quadMax = glm::max(quadMax, corners[i]);
+	}
+	const float quadDepth = quadMax.z;
+
+	const int minX = std::max(0, static_cast<int>(std::floor(quadMin.x)));
+	const int maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(quadMax.x)));
+	const int minY = std::max(static_cast<int>(firstRow), static_cast<int>(std::floor(quadMin.y)));
+	const int maxY = std::min(static_cast<int>(endRow) - 1, static_cast<int>(std::ceil(quadMax.y)));
+
+	for (int y = minY; y <= maxY; y++) {
+		const float centerY = y + 0.5f;
+		float* row = depth.data() + y * width;
+
+		for (int x = minX; x <= maxX; x++) {
+			const float centerX = x + 0.5f;
+			bool covered = true;
+			for (unsigned int i = 0; i < 4 && covered; i++) {
+				covered = stepX[i] * centerX + stepY[i] * centerY + offset[i] >= 0.0f;
+			}
+			if (!covered) continue;
+
+			row[x] = std::min(row[x], quadDepth);
+		}
+	}
+}
+
+bool OcclusionBuffer::isBoxVisible(const glm::vec3& min, const glm::vec3& max) const {
+	glm::vec3 screenMin(FLT_MAX);
+	glm::vec3 screenMax(-FLT_MAX);
+
+	for (unsigned int i = 0; i < 8; i++) {
+		const glm::vec3 corner(
+			(i & 1) ? max.x : min.x,
+			(i & 2) ? max.y : min.y,
+			(i & 4) ? max.z : min.z
+		);
+		glm::vec3 screen;
+		if (!projectPoint(corner, screen)) return true; // Reaches the camera
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+	}
+
+	const int minX = std::max(0, static_cast<int>(std::floor(screenMin.x)));
+	const int maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::floor(screenMax.x)));
+	const int minY = std::max(0, static_cast<int>(std::floor(screenMin.y)));
+	const int maxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::floor(screenMax.y)));
+
+	if (minX > maxX || minY > maxY) return true; // Off screen, left to frustum culling
+
+	for (int y = minY; y <= maxY; y++) {
+		const float* row = depth.data() + y * width;
+		for (int x = minX; x <= maxX; x++) {
+			if (row[x] > screenMin.z) return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Axis aligned box of solid terrain
+struct OccluderBox {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Chunk-local boxes that are entirely solid, merged from blocks of cells whose samples are all above the iso level.
+// Safe on a worker thread.
+std::vector<OccluderBox> buildOccluderBoxes(const std::vector<float>& densities, const float isoLevel);
+
+/*
+Low resolution software depth buffer for occlusion culling.
+
+Occluders are rasterized conservatively: a pixel is only written when the triangle covers all of it,
+with the farthest depth of the triangle. A box is hidden when every pixel under its screen rectangle
+holds something nearer than the box's nearest corner.
+
+Rows can be rasterized and cleared in independent bands, so the work splits over threads without
+locking and the result doesn't depend on the order. No OpenGL involved.
+*/
+class OcclusionBuffer {
+public:
+	OcclusionBuffer(const unsigned int width, const unsigned int height);
+
+	void setViewProjection(const glm::mat4& viewProjection);
+
+	// The row range [firstRow, endRow) is the band owned by the calling thread
+	void clearRows(const unsigned int firstRow, const unsigned int endRow);
+	void rasterizeBox(const OccluderBox& box, const unsigned int firstRow, const unsigned int endRow);
+
+	bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+	unsigned int width;
+	unsigned int height;
+	std::vector<float> depth; // NDC depth, 1 is the far plane
+
+private:
+	// Returns false when the point is behind or too close to the camera
+	bool projectPoint(const glm::vec3& point, glm::vec3& outScreen) const;
+	// The corners are in order around a convex face. Quads rather than triangles, so the diagonal doesn't leave a row of unwritten pixels.
+	void rasterizeQuad(const glm::vec3* corners, const unsigned int firstRow, const unsigned int endRow);
+
+	glm::mat4 viewProjection;
+};
@@ -1,4 +1,6 @@
 #include "PhysicsEngine.h"
+#include "DensityFieldShape.h"
+#include "Profiler.h"
 
 PhysicsEngine::PhysicsEngine() {
 	JPH::RegisterDefaultAllocator();
@@ -6,6 +8,7 @@ PhysicsEngine::PhysicsEngine() {
 	sInstance = new JPH::Factory();
 	JPH::Factory::sInstance = sInstance;
 	JPH::RegisterTypes();
+	DensityFieldShape::sRegister();
 	
 	jobSystem = new JPH::JobSystemThreadPool(JPH::cMaxPhysicsJobs, JPH::cMaxPhysicsBarriers, JPH::thread::hardware_concurrency() - 1);
 	physicsSystem = new JPH::PhysicsSystem();
@@ -15,12 +18,30 @@ PhysicsEngine::PhysicsEngine() {
 	bodyInterface = (&physicsSystem->GetBodyInterface());
 }
 
+PhysicsEngine::~PhysicsEngine() {
+	delete physicsSystem;
+	delete jobSystem;
+	delete tempAllocator;
+
+	JPH::UnregisterTypes();
+	JPH::Factory::sInstance = nullptr;
+	delete sInstance;
+}
+
 void PhysicsEngine::addObject(JPH::Body* body) {
 	bodyInterface->AddBody(body->GetID(), JPH::EActivation::Activate);
 }
 
 void PhysicsEngine::step(float deltaTime) {
-	physicsSystem->Update(deltaTime, 4, tempAllocator, jobSystem);
+	PROFILE_ZONE("PhysicsEngine::step");
+
+	// Sync points for the batched body states: gameplay changes go in before the step, results come out after it
+	writeBodyStates(trackedBodyStates);
+
+	// Called with a fixed 60 Hz timestep, one collision step is enough at that rate
+	physicsSystem->Update(deltaTime, 1, tempAllocator, jobSystem);
+
+	readBodyStates(trackedBodyStates);
 }
 
 JPH::Vec3 PhysicsEngine::getBodyLocation(JPH::Body& b) {
@@ -69,4 +90,65 @@ void PhysicsEngine::bodyWriteAngularVelocity(JPH::Vec3& velocity, JPH::Body& b)
 
 		body.SetAngularVelocity(velocity);
 	}
+}
+
+std::vector<JPH::Vec3> PhysicsEngine::getDynamicBodyPositions() {
+	// Called between steps, no locking needed
+	const JPH::BodyInterface& noLockInterface = physicsSystem->GetBodyInterfaceNoLock();
+
+	JPH::BodyIDVector activeBodies;
+	physicsSystem->GetActiveBodies(JPH::EBodyType::RigidBody, activeBodies);
+
+	std::vector<JPH::Vec3> positions;
+	positions.reserve(activeBodies.size());
+
+	for (const JPH::BodyID& id : activeBodies) {
+		if (noLockInterface.GetMotionType(id) != JPH::EMotionType::Dynamic) continue;
+		positions.push_back(noLockInterface.GetCenterOfMassPosition(id));
+	}
+
+	return positions;
+}
+
+unsigned int PhysicsEngine::trackBody(const JPH::BodyID& bodyID) {
+	trackedBodyStates.push_back({
+		.bodyID = bodyID,
+		.position = JPH::Vec3::sZero(),
+		.linearVelocity = JPH::Vec3::sZero(),
+		.angularVelocity = JPH::Vec3::sZero(),
+		.velocityDirty = false
+	});
+
+	std::vector<BodyState> newState = { trackedBodyStates.back() };
+	readBodyStates(newState);
+	trackedBodyStates.back() = newState[0];
+
+	return trackedBodyStates.size() - 1;
+}
+
+BodyState& PhysicsEngine::getBodyState(const unsigned int handle) {
+	return trackedBodyStates[handle];
+}
+
+void PhysicsEngine::readBodyStates(std::vector<BodyState>& states) {
+	const JPH::BodyInterface& noLockInterface = physicsSystem->GetBodyInterfaceNoLock();
+
+	for (BodyState& state : states) {
+		state.position = noLockInterface.GetCenterOfMassPosition(state.bodyID);
+		noLockInterface.GetLinearAndAngularVelocity(state.bodyID, state.linearVelocity, state.angularVelocity);
+		state.velocityDirty = false;
+	}
+}
+
+void PhysicsEngine::writeBodyStates(std::vector<BodyState>& states) {
+	JPH::BodyInterface& noLockInterface = physicsSystem->GetBodyInterfaceNoLock();
+
+	for (BodyState& state : states) {
+		if (!state.velocityDirty) continue;
+
+		if (noLockInterface.GetMotionType(state.bodyID) == JPH::EMotionType::Dynamic) {
+			noLockInterface.SetLinearAndAngularVelocity(state.bodyID, state.linearVelocity, state.angularVelocity);
+		}
+		state.velocityDirty = false;
+	}
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include <Jolt/Core/Factory.h>
 #include <Jolt/Core/TempAllocator.h>
 #include <Jolt/Core/JobSystemThreadPool.h>
+#include <vector>
 
 // --- Boilerplate --- //
 
@@ -99,6 +100,15 @@ public:
 
 ///  ---- Physics engine ----
 
+// Snapshot of a body, exchanged with gameplay code in batches between physics steps
+struct BodyState {
+	JPH::BodyID bodyID;
+	JPH::Vec3 position; // Center of mass
+	JPH::Vec3 linearVelocity;
+	JPH::Vec3 angularVelocity;
+	bool velocityDirty; // Set by gameplay code to have the velocities written back before the next step
+};
+
 class PhysicsEngine {
 public:
 	PhysicsEngine();
@@ -112,6 +122,14 @@ public:
 	void bodyWriteVelocity(JPH::Vec3& velocity, JPH::Body& b);
 	JPH::Vec3 bodyReadVelocity(JPH::Body& b);
 	void bodyWriteAngularVelocity(JPH::Vec3& angularVelocity, JPH::Body& b);
+	std::vector<JPH::Vec3> getDynamicBodyPositions();
+
+	// Batched, lock free body access. Only valid between steps, when the simulation isn't touching bodies:
+	// tracked bodies are written back at the start of step() and read again at its end.
+	unsigned int trackBody(const JPH::BodyID& bodyID);
+	BodyState& getBodyState(const unsigned int handle);
+	void readBodyStates(std::vector<BodyState>& states);
+	void writeBodyStates(std::vector<BodyState>& states);
 
 
 	JPH::BodyInterface* bodyInterface;
@@ -124,6 +142,8 @@ private:
 	BPLayerInterfaceImpl broadPhaseLayerInterface;
 	ObjectVsBroadPhaseLayerFilterImpl objectVsBroadphaseLayerFilter;
 	ObjectLayerPairFilterImpl objectVsObjectLayerFilter;
+
+	std::vector<BodyState> trackedBodyStates;
 	
 
 };
\ No newline at end of file
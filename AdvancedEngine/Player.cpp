@@ -7,7 +7,7 @@ const float MOVEMENT_SPEED = 5.0f;
 const float radius = 0.5f;
 const float height = 1.8f;
 
-Player::Player(const glm::vec3& startingPosition, Camera* camera, PhysicsEngine* physicsEngine) : camera(camera), physicsEngine(physicsEngine) {
+Player::Player(const glm::vec3& startingPosition, Camera* camera, PhysicsEngine* physicsEngine) : camera(camera), physicsEngine(physicsEngine), previousPosition(startingPosition), currentPosition(startingPosition) {
 
 
 
@@ -24,14 +24,15 @@ Player::Player(const glm::vec3& startingPosition, Camera* camera, PhysicsEngine*
 
 	playerBody = physicsEngine->bodyInterface->CreateBody(bcs);
 	physicsEngine->addObject(playerBody);
+
+	bodyStateHandle = physicsEngine->trackBody(playerBody->GetID());
 }
 
 void Player::processInputs(Window* window, const float deltaTime) {
 
-	//std::cout << "process inputs begin read vel" << std::endl;
-	JPH::Vec3 currentVelocity = physicsEngine->bodyReadVelocity(*playerBody);
-	//std::cout << "end read vel begin read inputs" << std::endl;
-	JPH::Vec3 newVelocity = currentVelocity;
+	BodyState& bodyState = physicsEngine->getBodyState(bodyStateHandle);
+
+	JPH::Vec3 newVelocity = bodyState.linearVelocity;
 
 	glm::vec3 movementVelocity = glm::vec3(0);
 
@@ -77,18 +78,23 @@ void Player::processInputs(Window* window, const float deltaTime) {
 		movementVelocity.z
 	);
 
-	//std::cout << "end read inputs begin write vel" << std::endl;
-	physicsEngine->bodyWriteVelocity(newVelocity, *playerBody);
+	// Written back in one batch at the start of the next physics step
+	bodyState.linearVelocity = newVelocity;
+	bodyState.angularVelocity = JPH::Vec3::sZero();
+	bodyState.velocityDirty = true;
 
-	JPH::Vec3 zero = JPH::Vec3::sZero();
+}
 
-	physicsEngine->bodyWriteAngularVelocity(zero, *playerBody);
+void Player::postUpdate() {
+	const JPH::Vec3& bodyPosition = physicsEngine->getBodyState(bodyStateHandle).position;
 
+	previousPosition = currentPosition;
+	currentPosition = glm::vec3(bodyPosition.GetX(), bodyPosition.GetY(), bodyPosition.GetZ());
 }
 
-void Player::postUpdate() {
-	const JPH::Vec3& bodyPosition = physicsEngine->getBodyLocation(*playerBody);
+void Player::interpolate(const float alpha) {
+	const glm::vec3 renderPosition = glm::mix(previousPosition, currentPosition, alpha);
 
-	camera->position = glm::vec3(bodyPosition.GetX(), bodyPosition.GetY() + height * 0.8, bodyPosition.GetZ());
+	camera->position = glm::vec3(renderPosition.x, renderPosition.y + height * 0.8, renderPosition.z);
 	camera->recomputeMatrices();
 }
\ No newline at end of file
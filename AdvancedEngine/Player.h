@@ -12,8 +12,14 @@ public:
 	void processInputs(Window* window, const float deltaTime);
 	void createBody();
 	void postUpdate();
+	void interpolate(const float alpha); // Places the camera between the last two physics states
 
 	Camera* camera;
 	JPH::Body* playerBody;
 	PhysicsEngine* physicsEngine;
+	unsigned int bodyStateHandle; // Batched state of playerBody in the physics engine
+
+	// Body positions after the last two physics steps
+	glm::vec3 previousPosition;
+	glm::vec3 currentPosition;
 };
\ No newline at end of file
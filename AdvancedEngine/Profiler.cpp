@@ -0,0 +1,229 @@
+#include "Profiler.h"
+#include <glad/gl.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+// Zones kept per thread, about 400 KB each
+const unsigned int PROFILE_EVENTS_PER_THREAD = 16384;
+// GPU zones are read back this many frames after they were recorded
+const unsigned int GPU_PROFILE_FRAMES = 4;
+
+struct ProfileEvent {
+	const char* name;
+	int64_t start;
+	int64_t end;
+};
+
+struct ProfileThreadBuffer {
+	std::vector<ProfileEvent> events; // Ring, written % size is the next slot
+	uint64_t written = 0;
+	unsigned int threadId = 0;
+	std::string threadName;
+	std::mutex mutex; // Only contended while exporting
+
+	void push(const ProfileEvent& event) {
+		events[written % events.size()] = event;
+		written++;
+	}
+};
+
+struct GpuZone {
+	const char* name;
+	GLuint beginQuery;
+	GLuint endQuery;
+};
+
+struct OpenGpuZone {
+	unsigned int frame; // A zone may still be open when endFrame() moves on
+	unsigned int zone;
+};
+
+struct GpuFrame {
+	std::vector<GLuint> queries; // Reused every GPU_PROFILE_FRAMES frames, two per zone
+	std::vector<GpuZone> zones;
+};
+
+// Buffers are never freed, the zones of a thread stay exportable after it exits
+static std::mutex registryMutex;
+static std::vector<ProfileThreadBuffer*> threadBuffers;
+static unsigned int nextThreadId = 1;
+
+static thread_local ProfileThreadBuffer* currentThreadBuffer = nullptr;
+
+// Main thread only
+static GpuFrame gpuFrames[GPU_PROFILE_FRAMES];
+static unsigned int gpuFrameIndex = 0;
+static std::vector<OpenGpuZone> openGpuZones;
+static ProfileThreadBuffer* gpuBuffer = nullptr;
+
+static ProfileThreadBuffer* createThreadBuffer(const std::string& name) {
+	ProfileThreadBuffer* buffer = new ProfileThreadBuffer();
+	buffer->events.resize(PROFILE_EVENTS_PER_THREAD);
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	buffer->threadId = nextThreadId++;
+	buffer->threadName = name.empty() ? "Thread " + std::to_string(buffer->threadId) : name;
+	threadBuffers.push_back(buffer);
+	return buffer;
+}
+
+static ProfileThreadBuffer* getThreadBuffer() {
+	if (currentThreadBuffer == nullptr) {
+		currentThreadBuffer = createThreadBuffer("");
+	}
+	return currentThreadBuffer;
+}
+
+int64_t Profiler::now() {
+	static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void Profiler::setThreadName(const std::string& name) {
+	ProfileThreadBuffer* buffer = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	buffer->threadName = name;
+}
+
+void Profiler::recordCpuZone(const char* name, const int64_t start, const int64_t end) {
+	ProfileThreadBuffer* buffer = getThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	buffer->push({ name, start, end });
+}
+
+void Profiler::beginGpuZone(const char* name) {
+	GpuFrame& frame = gpuFrames[gpuFrameIndex];
+
+	const size_t zoneIndex = frame.zones.size();
+	if (frame.queries.size() < (zoneIndex + 1) * 2) {
+		const size_t oldSize = frame.queries.size();
+		frame.queries.resize(oldSize + 2);
+		glGenQueries(2, &frame.queries[oldSize]);
+	}
+
+	// Timestamps rather than GL_TIME_ELAPSED, elapsed queries can't nest
+	frame.zones.push_back({ name, frame.queries[zoneIndex * 2], frame.queries[zoneIndex * 2 + 1] });
+	glQueryCounter(frame.zones.back().beginQuery, GL_TIMESTAMP);
+	openGpuZones.push_back({ gpuFrameIndex, static_cast<unsigned int>(zoneIndex) });
+}
+
+void Profiler::endGpuZone() {
+	if (openGpuZones.empty()) return;
+
+	const OpenGpuZone open = openGpuZones.back();
+	openGpuZones.pop_back();
+
+	const GpuFrame& frame = gpuFrames[open.frame];
+	if (open.zone < frame.zones.size()) {
+		glQueryCounter(frame.zones[open.zone].endQuery, GL_TIMESTAMP);
+	}
+}
+
+void Profiler::endFrame() {
+	gpuFrameIndex = (gpuFrameIndex + 1) % GPU_PROFILE_FRAMES;
+
+	// The oldest frame, its queries are about to be reused
+	GpuFrame& frame = gpuFrames[gpuFrameIndex];
+	if (frame.zones.empty()) return;
+
+	// Drop the frame rather than stall if the GPU is that far behind
+	bool available = true;
+	for (const GpuZone& zone : frame.zones) {
+		GLint endAvailable = 0;
+		glGetQueryObjectiv(zone.endQuery, GL_QUERY_RESULT_AVAILABLE, &endAvailable);
+		available = available && endAvailable;
+	}
+
+	if (available) {
+		if (gpuBuffer == nullptr) {
+			gpuBuffer = createThreadBuffer("GPU");
+		}
+
+		// Moves the GPU timestamps onto the CPU clock
+		GLint64 gpuNow = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		const int64_t offset = now() - gpuNow;
+
+		std::lock_guard<std::mutex> lock(gpuBuffer->mutex);
+		for (const GpuZone& zone : frame.zones) {
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(zone.beginQuery, GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(zone.endQuery, GL_QUERY_RESULT, &end);
+			gpuBuffer->push({ zone.name, static_cast<int64_t>(begin) + offset, static_cast<int64_t>(end) + offset });
+		}
+	}
+
+	frame.zones.clear();
+}
+
+void Profiler::releaseGpuQueries() {
+	for (GpuFrame& frame : gpuFrames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries(frame.queries.size(), frame.queries.data());
+		}
+		frame.queries.clear();
+		frame.zones.clear();
+	}
+	openGpuZones.clear();
+}
+
+bool Profiler::exportChromeTrace(const std::string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "Failed to open " << path << " for the profiler trace" << std::endl;
+		return false;
+	}
+
+	std::vector<ProfileThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffers = threadBuffers;
+	}
+
+	// Microseconds with nanosecond precision
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[";
+
+	size_t exportedZones = 0;
+	bool first = true;
+	std::vector<ProfileEvent> events;
+
+	for (ProfileThreadBuffer* buffer : buffers) {
+		std::string threadName;
+		unsigned int threadId;
+		{
+			// Copy out so the thread isn't blocked while the file is written
+			std::lock_guard<std::mutex> lock(buffer->mutex);
+			const uint64_t count = std::min<uint64_t>(buffer->written, buffer->events.size());
+			events.clear();
+			for (uint64_t i = buffer->written - count; i < buffer->written; i++) {
+				events.push_back(buffer->events[i % buffer->events.size()]);
+			}
+			threadName = buffer->threadName;
+			threadId = buffer->threadId;
+		}
+
+		file << (first ? "\n" : ",\n");
+		first = false;
+		file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << threadId << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+
+		for (const ProfileEvent& event : events) {
+			file << ",\n{\"ph\":\"X\",\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << threadId
+				<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+		exportedZones += events.size();
+	}
+
+	file << "\n]}" << std::endl;
+
+	std::cout << "Exported " << exportedZones << " profiler zones to " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Set to 0 to compile every zone out of the build
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+/*
+Scoped zone profiler.
+
+PROFILE_ZONE("name") times the enclosing scope on the CPU, PROFILE_GPU_ZONE("name") times the GL
+commands issued in it with timestamp queries (main thread only). Zones nest.
+
+Every thread records into its own ring buffer, the oldest zones are overwritten when it's full.
+GPU results are read a few frames late in endFrame() so the CPU never waits on them.
+exportChromeTrace() writes everything still in the rings as Chrome trace_event JSON, open it in
+chrome://tracing or ui.perfetto.dev.
+
+Zone names must be string literals, only the pointer is stored.
+*/
+class Profiler {
+public:
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(const bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+	static int64_t now(); // Nanoseconds since the profiler started
+	static void setThreadName(const std::string& name);
+	static void recordCpuZone(const char* name, const int64_t start, const int64_t end);
+
+	static void beginGpuZone(const char* name);
+	static void endGpuZone();
+	static void endFrame(); // Call once per frame on the main thread, collects finished GPU zones
+	static void releaseGpuQueries(); // Before the GL context goes away
+
+	static bool exportChromeTrace(const std::string& path);
+
+	// GL buffers, vertex arrays, textures and framebuffers created since startup, to spot resource churn
+	static void countGlObjectsCreated(const unsigned int count) { glObjectsCreated.fetch_add(count, std::memory_order_relaxed); }
+	static uint64_t getGlObjectsCreated() { return glObjectsCreated.load(std::memory_order_relaxed); }
+
+private:
+	inline static std::atomic<bool> enabled{ true };
+	inline static std::atomic<uint64_t> glObjectsCreated{ 0 };
+};
+
+class ProfileZone {
+public:
+	ProfileZone(const char* name) : name(name), start(Profiler::isEnabled() ? Profiler::now() : -1) {}
+	~ProfileZone() {
+		if (start >= 0) {
+			Profiler::recordCpuZone(name, start, Profiler::now());
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name;
+	int64_t start;
+};
+
+class GpuProfileZone {
+public:
+	GpuProfileZone(const char* name) : active(Profiler::isEnabled()) {
+		if (active) {
+			Profiler::beginGpuZone(name);
+		}
+	}
+	~GpuProfileZone() {
+		if (active) {
+			Profiler::endGpuZone();
+		}
+	}
+
+	GpuProfileZone(const GpuProfileZone&) = delete;
+	GpuProfileZone& operator=(const GpuProfileZone&) = delete;
+
+private:
+	bool active;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if ENABLE_PROFILER
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_GPU_ZONE(name)
+#endif
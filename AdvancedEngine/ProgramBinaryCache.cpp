@@ -0,0 +1,136 @@
+#include "ProgramBinaryCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+const char* PROGRAM_CACHE_DIRECTORY = "shader_cache";
+const uint32_t PROGRAM_CACHE_MAGIC = 0x43425041; // "APBC"
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key; // Guards against a renamed or truncated file
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+	double compileMilliseconds;
+};
+
+// Startup statistics
+static unsigned int programsLoaded = 0;
+static unsigned int programsCompiled = 0;
+static double totalLoadMilliseconds = 0.0;
+static double totalCompileMilliseconds = 0.0;
+static double savedMilliseconds = 0.0;
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const char* data, const size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t hashString(const uint64_t hash, const char* string) {
+	if (string == nullptr) return hash;
+	// The terminator separates consecutive strings, "ab"+"c" and "a"+"bc" hash differently
+	return hashBytes(hash, string, std::strlen(string) + 1);
+}
+
+static bool isSupported() {
+	static const bool supported = [] {
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}();
+	return supported;
+}
+
+uint64_t ProgramBinaryCache::makeKey(const std::vector<const char*>& sources) {
+	uint64_t hash = 14695981039346656037ull;
+	for (const char* source : sources) {
+		hash = hashString(hash, source);
+	}
+
+	hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+	hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+	hash = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+	return hash;
+}
+
+std::string ProgramBinaryCache::getPath(const uint64_t key) {
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+	return (std::filesystem::path(PROGRAM_CACHE_DIRECTORY) / fileName).string();
+}
+
+bool ProgramBinaryCache::load(ShaderProgram& program, const uint64_t key) {
+	if (!isSupported()) return false;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	std::ifstream file(getPath(key), std::ios::binary);
+	if (!file) return false;
+
+	ProgramCacheHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+	if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != key) return false;
+
+	std::vector<char> binary(header.binaryLength);
+	if (!file.read(binary.data(), binary.size())) return false;
+
+	if (!program.loadBinary(header.binaryFormat, binary)) {
+		std::cout << "Shader cache entry " << getPath(key) << " was rejected by the driver, compiling from source" << std::endl;
+		return false;
+	}
+
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	programsLoaded++;
+	totalLoadMilliseconds += milliseconds;
+	savedMilliseconds += header.compileMilliseconds - milliseconds;
+	return true;
+}
+
+void ProgramBinaryCache::store(ShaderProgram& program, const uint64_t key, const double compileMilliseconds) {
+	if (!isSupported()) return;
+
+	GLenum binaryFormat = 0;
+	std::vector<char> binary;
+	if (!program.getBinary(binaryFormat, binary)) return;
+
+	std::error_code error;
+	std::filesystem::create_directories(PROGRAM_CACHE_DIRECTORY, error);
+
+	const std::string path = getPath(key);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "Could not write the shader cache entry " << path << std::endl;
+		return;
+	}
+
+	const ProgramCacheHeader header = {
+		.magic = PROGRAM_CACHE_MAGIC,
+		.version = PROGRAM_CACHE_VERSION,
+		.key = key,
+		.binaryFormat = binaryFormat,
+		.binaryLength = static_cast<uint32_t>(binary.size()),
+		.compileMilliseconds = compileMilliseconds
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(binary.data(), binary.size());
+}
+
+void ProgramBinaryCache::recordCompile(const double milliseconds) {
+	programsCompiled++;
+	totalCompileMilliseconds += milliseconds;
+}
+
+void ProgramBinaryCache::printStartupReport() {
+	std::cout << "Shaders: " << programsLoaded << " programs from the cache in " << totalLoadMilliseconds << " ms"
+		<< ", " << programsCompiled << " compiled in " << totalCompileMilliseconds << " ms"
+		<< ", about " << savedMilliseconds << " ms saved" << std::endl;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ShaderProgram.h"
+
+/*
+On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary), so the shaders
+are only compiled on the first launch.
+
+Entries are keyed by a hash of the shader sources and the driver's vendor, renderer and version
+strings: editing a shader or updating the driver misses the cache. The driver may still reject a
+binary, load() then returns false and the caller compiles from source as usual.
+*/
+class ProgramBinaryCache {
+public:
+	static uint64_t makeKey(const std::vector<const char*>& sources);
+
+	// Links the program from the cache, false if there is no usable entry
+	static bool load(ShaderProgram& program, const uint64_t key);
+	// compileMilliseconds is kept with the binary, it's what a later load saves
+	static void store(ShaderProgram& program, const uint64_t key, const double compileMilliseconds);
+
+	static void recordCompile(const double milliseconds);
+	static void printStartupReport();
+
+private:
+	static std::string getPath(const uint64_t key);
+};
@@ -0,0 +1,176 @@
+#include "RegionFile.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+const uint32_t REGION_MAGIC = 0x4E474552; // "REGN"
+const uint32_t REGION_VERSION = 2;
+
+// Compact on open once more than half of the file is old payloads, and at least this much
+const uint64_t COMPACT_MIN_DEAD_BYTES = 1024 * 1024;
+
+struct RegionHeader {
+	uint32_t magic;
+	uint32_t version;
+	RegionEntry entries[REGION_CHUNKS];
+};
+
+RegionFile::RegionFile(const std::string& path) : path(path), entries(REGION_CHUNKS, RegionEntry{ 0, 0 }), fileSize(0) {
+	MappedFile existing(path);
+	if (!existing.isOpen() || existing.size < sizeof(RegionHeader)) return;
+
+	const RegionHeader* header = reinterpret_cast<const RegionHeader*>(existing.data);
+	if (header->magic != REGION_MAGIC || header->version != REGION_VERSION) {
+		std::cout << "Ignoring region file " << path << " written by another version, it will be overwritten" << std::endl;
+		return;
+	}
+
+	uint64_t liveBytes = 0;
+	for (unsigned int i = 0; i < REGION_CHUNKS; i++) {
+		const RegionEntry& entry = header->entries[i];
+		// Left over from an interrupted write
+		if (static_cast<uint64_t>(entry.offset) + entry.size > existing.size) continue;
+		entries[i] = entry;
+		liveBytes += entry.size;
+	}
+	fileSize = existing.size;
+
+	const uint64_t deadBytes = fileSize - sizeof(RegionHeader) - liveBytes;
+	if (deadBytes > liveBytes && deadBytes >= COMPACT_MIN_DEAD_BYTES) {
+		compact(existing);
+	}
+}
+
+RegionFile::~RegionFile() {
+	commit();
+}
+
+void RegionFile::compact(MappedFile& existing) {
+	const std::string compactedPath = path + ".tmp";
+	std::ofstream compacted(compactedPath, std::ios::binary | std::ios::trunc);
+	if (!compacted) return;
+
+	RegionHeader* header = new RegionHeader();
+	std::memset(header, 0, sizeof(RegionHeader));
+	header->magic = REGION_MAGIC;
+	header->version = REGION_VERSION;
+
+	uint64_t offset = sizeof(RegionHeader);
+	compacted.seekp(offset);
+	for (unsigned int i = 0; i < REGION_CHUNKS; i++) {
+		if (entries[i].size == 0) continue;
+
+		compacted.write(reinterpret_cast<const char*>(existing.data + entries[i].offset), entries[i].size);
+		header->entries[i] = { static_cast<uint32_t>(offset), entries[i].size };
+		offset += entries[i].size;
+	}
+	compacted.seekp(0);
+	compacted.write(reinterpret_cast<const char*>(header), sizeof(RegionHeader));
+	compacted.close();
+	// A mapped file can't be replaced on Windows
+	existing.close();
+
+	if (compacted) {
+		std::error_code error;
+		std::filesystem::rename(compactedPath, path, error);
+		if (!error) {
+			std::cout << "Compacted region file " << path << " from " << fileSize << " to " << offset << " bytes" << std::endl;
+			std::memcpy(entries.data(), header->entries, sizeof(header->entries));
+			fileSize = offset;
+		}
+	}
+	delete header;
+
+	std::error_code error;
+	std::filesystem::remove(compactedPath, error);
+}
+
+unsigned int RegionFile::getChunkIndex(const glm::ivec3& localPosition) {
+	return localPosition.x + localPosition.z * REGION_SIZE + localPosition.y * REGION_SIZE * REGION_SIZE;
+}
+
+bool RegionFile::readChunk(const unsigned int index, std::vector<unsigned char>& payload) {
+	std::shared_ptr<MappedFile> view;
+	RegionEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		entry = entries[index];
+		if (entry.size == 0) return false;
+
+		const uint64_t end = static_cast<uint64_t>(entry.offset) + entry.size;
+		if (mapping == nullptr || mapping->size < end) {
+			// Written since the last mapping was made. Readers still using the old one keep it alive
+			std::shared_ptr<MappedFile> remapped = std::make_shared<MappedFile>(path);
+			if (!remapped->isOpen() || remapped->size < end) return false;
+			mapping = remapped;
+		}
+		view = mapping;
+	}
+
+	payload.assign(view->data + entry.offset, view->data + entry.offset + entry.size);
+	return true;
+}
+
+bool RegionFile::openForWriting() {
+	if (file.is_open()) return true;
+
+	if (fileSize == 0) {
+		// New file, or one from another version that gets replaced
+		file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file) return false;
+
+		RegionHeader* header = new RegionHeader();
+		std::memset(header, 0, sizeof(RegionHeader));
+		header->magic = REGION_MAGIC;
+		header->version = REGION_VERSION;
+		file.write(reinterpret_cast<const char*>(header), sizeof(RegionHeader));
+		delete header;
+
+		fileSize = sizeof(RegionHeader);
+	}
+	else {
+		file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	}
+	return file.good();
+}
+
+bool RegionFile::appendChunk(const unsigned int index, const std::vector<unsigned char>& payload) {
+	if (payload.empty() || !openForWriting()) return false;
+
+	if (fileSize + payload.size() > UINT32_MAX) {
+		std::cout << "Region file " << path << " is full, chunk not saved" << std::endl;
+		return false;
+	}
+
+	const RegionEntry entry = { static_cast<uint32_t>(fileSize), static_cast<uint32_t>(payload.size()) };
+
+	// Payload first, so a table entry never points at bytes that aren't written
+	file.seekp(fileSize);
+	file.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	file.seekp(offsetof(RegionHeader, entries) + index * sizeof(RegionEntry));
+	file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+
+	if (!file) {
+		std::cout << "Failed to write to region file " << path << std::endl;
+		file.close();
+		return false;
+	}
+
+	fileSize += payload.size();
+	uncommittedEntries.push_back({ index, entry });
+	return true;
+}
+
+void RegionFile::commit() {
+	if (uncommittedEntries.empty()) return;
+
+	// The bytes have to reach the file before a reader maps it for them
+	file.flush();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& [index, entry] : uncommittedEntries) {
+		entries[index] = entry;
+	}
+	uncommittedEntries.clear();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+constexpr unsigned int REGION_SIZE = 16; // Chunks per axis in one region file
+constexpr unsigned int REGION_CHUNKS = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+// Where a chunk's payload is in the file, size 0 when the chunk isn't stored
+struct RegionEntry {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/*
+The saved edits of 16x16x16 chunks: a header with an offset table, then one payload per chunk that was
+ever edited. Unedited chunks have no entry and take no space.
+
+Payloads are only ever appended, a chunk saved again gets a new payload and the old one becomes
+dead space, which is compacted away when the file is opened and mostly dead. Reads copy straight out
+of a memory mapping of the file, which is replaced when a read needs bytes written after it was made.
+Writes use regular file IO from a single thread: appendChunk() writes the payload, commit() flushes
+and only then makes the new entries visible to readers.
+*/
+class RegionFile {
+public:
+	RegionFile(const std::string& path);
+	~RegionFile();
+
+	// Thread safe, false when the chunk isn't stored
+	bool readChunk(const unsigned int index, std::vector<unsigned char>& payload);
+
+	// Writer thread only
+	bool appendChunk(const unsigned int index, const std::vector<unsigned char>& payload);
+	void commit();
+
+	static unsigned int getChunkIndex(const glm::ivec3& localPosition);
+
+private:
+	bool openForWriting();
+	void compact(MappedFile& existing); // Rewrites the file with only the live payloads
+
+	std::string path;
+
+	std::mutex mutex; // Guards entries and mapping
+	std::vector<RegionEntry> entries;
+	std::shared_ptr<MappedFile> mapping; // Readers keep their own reference while they decompress
+
+	// Writer thread state
+	std::fstream file;
+	uint64_t fileSize;
+	std::vector<std::pair<unsigned int, RegionEntry>> uncommittedEntries;
+};
@@ -1,6 +1,33 @@
 #pragma once
 
+#include <cstdint>
+#include <glm/glm.hpp>
+
 constexpr unsigned int CHUNK_SIZE = 31;
+constexpr unsigned int CHUNK_SAMPLES = CHUNK_SIZE + 1; // Density samples per axis, including the shared border
 constexpr unsigned int N_TERRAIN_VA = 7; // Number of vertex attributes for terrain mesh
 constexpr unsigned int N_MATERIALS = 3;
-constexpr unsigned int PBR_SIZE = 1024;// 1024x1024;
\ No newline at end of file
+constexpr unsigned int PBR_SIZE = 1024;// 1024x1024;
+constexpr unsigned int PHYSICS_RADIUS = 1; // Chunks around each dynamic body that get a collision shape
+
+// Index of a density/material sample in a chunk grid
+constexpr unsigned int sampleIndex(const unsigned int x, const unsigned int y, const unsigned int z) {
+	return z + x * CHUNK_SAMPLES + y * CHUNK_SAMPLES * CHUNK_SAMPLES;
+}
+
+// Chunk and region coordinates packed 21 bits per axis, the key of every chunk map and of the saved regions.
+// Distinct for every position within a million of the origin
+constexpr uint64_t packChunkPosition(const glm::ivec3& position) {
+	const uint64_t mask = (1ull << 21) - 1;
+	return (static_cast<uint64_t>(position.x) & mask)
+		| ((static_cast<uint64_t>(position.y) & mask) << 21)
+		| ((static_cast<uint64_t>(position.z) & mask) << 42);
+}
+
+constexpr unsigned int CHUNK_HALO = 1; // Samples added on every side of a chunk grid for gradients across its border, see ChunkHalo
+constexpr unsigned int HALO_SAMPLES = CHUNK_SAMPLES + 2 * CHUNK_HALO;
+
+// Index in a halo grid, chunk sample (0, 0, 0) is at (CHUNK_HALO, CHUNK_HALO, CHUNK_HALO)
+constexpr unsigned int haloSampleIndex(const unsigned int x, const unsigned int y, const unsigned int z) {
+	return z + x * HALO_SAMPLES + y * HALO_SAMPLES * HALO_SAMPLES;
+}
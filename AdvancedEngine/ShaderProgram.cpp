@@ -3,6 +3,7 @@
 
 ShaderProgram::ShaderProgram() {
 	shaderProgram = glCreateProgram();
+	glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 }
 
 ShaderProgram::~ShaderProgram() {
@@ -23,6 +24,57 @@ void ShaderProgram::link() {
 		glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
 		throw std::runtime_error("Shader program linking failed: " + std::string(infoLog));
 	}
+
+	cacheUniformLocations();
+}
+
+bool ShaderProgram::loadBinary(const GLenum binaryFormat, const std::vector<char>& binary) {
+	glProgramBinary(shaderProgram, binaryFormat, binary.data(), binary.size());
+
+	int success;
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	if (!success) return false;
+
+	cacheUniformLocations();
+	return true;
+}
+
+bool ShaderProgram::getBinary(GLenum& binaryFormat, std::vector<char>& binary) {
+	GLint length = 0;
+	glGetProgramiv(shaderProgram, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return false;
+
+	binary.resize(length);
+	GLsizei written = 0;
+	glGetProgramBinary(shaderProgram, length, &written, &binaryFormat, binary.data());
+	binary.resize(written);
+	return written > 0;
+}
+
+void ShaderProgram::cacheUniformLocations() {
+	uniformLocations.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+
+	for (GLint i = 0; i < uniformCount; i++) {
+		char name[256];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(shaderProgram, i, sizeof(name), &length, &size, &type, name);
+
+		const int location = glGetUniformLocation(shaderProgram, name);
+		if (location < 0) continue; // Member of a uniform block
+
+		std::string uniformName(name, length);
+		uniformLocations[uniformName] = location;
+
+		// Arrays are reported as "name[0]", they are also looked up by their plain name
+		if (uniformName.ends_with("[0]")) {
+			uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+		}
+	}
 }
 
 void ShaderProgram::use() {
@@ -32,5 +84,7 @@ void ShaderProgram::use() {
 
 
 int ShaderProgram::getUniformLocation(const char* name) {
-	return glGetUniformLocation(shaderProgram, name);
+	const auto it = uniformLocations.find(name);
+	if (it == uniformLocations.end()) return -1;
+	return it->second;
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Shader.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 class ShaderProgram {
 public:
@@ -9,8 +12,16 @@ public:
 
 	void attachShader(Shader& shader);
 	void link();
+	// Links from a driver binary instead of shaders, returns false when the driver rejects it
+	bool loadBinary(const GLenum binaryFormat, const std::vector<char>& binary);
+	bool getBinary(GLenum& binaryFormat, std::vector<char>& binary);
 	void use();
-	int getUniformLocation(const char* name);
+	int getUniformLocation(const char* name); // From the table filled at link time, -1 when the uniform doesn't exist
 
 	GLint shaderProgram;
+
+private:
+	void cacheUniformLocations();
+
+	std::unordered_map<std::string, int> uniformLocations;
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "StagingRing.h"
+#include "Profiler.h"
+#include <iostream>
+#include <stdexcept>
+
+const unsigned int STAGING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(const unsigned int size) : size(size), buffer(0), memory(nullptr), head(0), currentFrame(0), completedFrames(0) {
+	isPersistent = GLAD_GL_VERSION_4_4 != 0;
+
+	if (isPersistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glGenBuffers(1, &buffer);
+		Profiler::countGlObjectsCreated(1);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+		memory = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		if (memory == nullptr) {
+			throw std::runtime_error("Failed to map the staging buffer");
+		}
+	}
+	else {
+		memory = new char[size];
+		std::cout << "Buffer storage not available, chunk uploads use glBufferSubData" << std::endl;
+	}
+}
+
+StagingRing::~StagingRing() {
+	for (const FrameFence& frameFence : frameFences) {
+		glDeleteSync(frameFence.fence);
+	}
+
+	if (isPersistent) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	else {
+		delete[] memory;
+	}
+}
+
+StagingAllocation StagingRing::allocate(const unsigned int requestedSize) {
+	const unsigned int alignedSize = (requestedSize + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	if (alignedSize == 0 || alignedSize >= size) return { 0, 0, nullptr };
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	unsigned int offset;
+
+	if (blocks.empty()) {
+		offset = 0;
+	}
+	else {
+		const unsigned int tail = blocks.front().offset;
+
+		// head == tail never means full, so the wrapped case keeps one byte of gap
+		if (head >= tail) {
+			if (size - head >= alignedSize) offset = head;
+			else if (alignedSize < tail) offset = 0;
+			else return { 0, 0, nullptr };
+		}
+		else {
+			if (head + alignedSize < tail) offset = head;
+			else return { 0, 0, nullptr };
+		}
+	}
+
+	head = offset + alignedSize;
+	blocks.push_back({ offset, alignedSize, false, 0 });
+
+	return { offset, alignedSize, memory + offset };
+}
+
+void StagingRing::copyToBuffer(const StagingAllocation& allocation, const unsigned int sourceOffset, const unsigned int copySize, GLuint destinationBuffer, const unsigned int destinationOffset) {
+	glBindBuffer(GL_COPY_WRITE_BUFFER, destinationBuffer);
+
+	if (isPersistent) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset + sourceOffset, destinationOffset, copySize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	else {
+		glBufferSubData(GL_COPY_WRITE_BUFFER, destinationOffset, copySize, allocation.data + sourceOffset);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StagingRing::release(const StagingAllocation& allocation) {
+	if (!allocation.isValid()) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (Block& block : blocks) {
+		if (block.offset == allocation.offset && !block.released) {
+			block.released = true;
+			block.releaseFrame = currentFrame;
+			return;
+		}
+	}
+}
+
+void StagingRing::endFrame() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (isPersistent) {
+		frameFences.push_back({ currentFrame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+
+		while (!frameFences.empty()) {
+			const GLenum result = glClientWaitSync(frameFences.front().fence, 0, 0);
+			if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+
+			completedFrames = frameFences.front().frame + 1;
+			glDeleteSync(frameFences.front().fence);
+			frameFences.pop_front();
+		}
+	}
+	else {
+		// glBufferSubData already copied the data
+		completedFrames = currentFrame + 1;
+	}
+
+	currentFrame++;
+
+	while (!blocks.empty() && blocks.front().released && blocks.front().releaseFrame < completedFrames) {
+		blocks.pop_front();
+	}
+	if (blocks.empty()) {
+		head = 0;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// A piece of staging memory. data is written by the producer, then copied into a GL buffer by the main thread.
+struct StagingAllocation {
+	unsigned int offset;
+	unsigned int size;
+	char* data;
+
+	bool isValid() const { return data != nullptr; }
+};
+
+/*
+Ring of upload memory for streaming chunk meshes.
+
+With buffer storage (GL 4.4) it is one persistently and coherently mapped buffer: worker threads write
+meshes straight into it and the main thread only issues glCopyBufferSubData into the destination.
+A released range is reused once the fence of the frame that copied it has signaled.
+
+Without buffer storage the ring is plain memory and copies fall back to glBufferSubData.
+*/
+class StagingRing {
+public:
+	StagingRing(const unsigned int size);
+	~StagingRing();
+
+	// Any thread. Returns an invalid allocation instead of waiting when the ring is full.
+	StagingAllocation allocate(const unsigned int size);
+
+	// Main thread. Copies part of an allocation into a GL buffer.
+	void copyToBuffer(const StagingAllocation& allocation, const unsigned int sourceOffset, const unsigned int copySize, GLuint destinationBuffer, const unsigned int destinationOffset);
+
+	// Main thread. The allocation is reused once the copies issued this frame are done.
+	void release(const StagingAllocation& allocation);
+
+	// Main thread. Fences the copies issued since the last call and reclaims finished allocations.
+	void endFrame();
+
+	bool isPersistent;
+	unsigned int size;
+
+private:
+	struct Block {
+		unsigned int offset;
+		unsigned int size;
+		bool released;
+		uint64_t releaseFrame;
+	};
+
+	struct FrameFence {
+		uint64_t frame;
+		GLsync fence;
+	};
+
+	GLuint buffer;
+	char* memory; // Persistent mapping, or plain memory in the fallback path
+
+	std::deque<Block> blocks; // In allocation order, the front one is the tail of the ring
+	std::deque<FrameFence> frameFences;
+	unsigned int head;
+	uint64_t currentFrame;
+	uint64_t completedFrames; // Frames whose copies the GPU has finished
+
+	std::mutex mutex;
+};
@@ -0,0 +1,117 @@
+#include "TerrainDelta.h"
+#include "Settings.h"
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+constexpr unsigned int CHUNK_SAMPLE_COUNT = CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES;
+// Index gaps are 16 bit, every sample index of a chunk fits
+static_assert(CHUNK_SAMPLE_COUNT <= 65536);
+
+const int DELTA_COMPRESSION_QUALITY = 5; // stb's lowest, saving happens while the player is editing
+
+// Bytes per sample before compression: gap, density, material
+constexpr size_t SERIALIZED_SAMPLE_SIZE = sizeof(uint16_t) + sizeof(float) + 1;
+
+void TerrainDelta::set(const unsigned int index, const float density, const unsigned int material) {
+	samples[index] = { density, material };
+}
+
+void TerrainDelta::apply(std::vector<float>& densities, std::vector<unsigned int>& materials) const {
+	for (const auto& [index, sample] : samples) {
+		densities[index] = sample.density;
+		materials[index] = sample.material;
+	}
+}
+
+std::vector<unsigned char> TerrainDelta::serialize() const {
+	std::vector<unsigned int> indices;
+	indices.reserve(samples.size());
+	for (const auto& [index, sample] : samples) {
+		indices.push_back(index);
+	}
+	// Edits are local, sorted indices have small gaps that compress well
+	std::sort(indices.begin(), indices.end());
+
+	const size_t count = indices.size();
+	std::vector<unsigned char> raw(sizeof(uint32_t) + count * SERIALIZED_SAMPLE_SIZE);
+
+	const uint32_t storedCount = static_cast<uint32_t>(count);
+	std::memcpy(raw.data(), &storedCount, sizeof(storedCount));
+
+	unsigned char* gaps = raw.data() + sizeof(uint32_t);
+	unsigned char* densityPlanes = gaps + count * sizeof(uint16_t);
+	unsigned char* materialBytes = densityPlanes + count * sizeof(float);
+
+	unsigned int previous = 0;
+	for (size_t i = 0; i < count; i++) {
+		const SampleOverride& sample = samples.at(indices[i]);
+
+		const uint16_t gap = static_cast<uint16_t>(indices[i] - previous);
+		previous = indices[i];
+		std::memcpy(gaps + i * sizeof(uint16_t), &gap, sizeof(gap));
+
+		// Byte planes: dug out and filled samples are all 0.0 or 1.0, each plane is nearly constant
+		unsigned char bytes[sizeof(float)];
+		std::memcpy(bytes, &sample.density, sizeof(float));
+		for (size_t b = 0; b < sizeof(float); b++) {
+			densityPlanes[b * count + i] = bytes[b];
+		}
+
+		materialBytes[i] = static_cast<unsigned char>(sample.material);
+	}
+
+	int compressedSize = 0;
+	unsigned char* compressed = stbi_zlib_compress(raw.data(), static_cast<int>(raw.size()), &compressedSize, DELTA_COMPRESSION_QUALITY);
+	if (compressed == nullptr) return {};
+
+	std::vector<unsigned char> payload(compressed, compressed + compressedSize);
+	STBIW_FREE(compressed);
+	return payload;
+}
+
+bool TerrainDelta::deserialize(const unsigned char* data, const size_t size) {
+	samples.clear();
+
+	int rawSize = 0;
+	char* raw = stbi_zlib_decode_malloc(reinterpret_cast<const char*>(data), static_cast<int>(size), &rawSize);
+	if (raw == nullptr) return false;
+
+	uint32_t count = 0;
+	bool valid = static_cast<size_t>(rawSize) >= sizeof(uint32_t);
+	if (valid) {
+		std::memcpy(&count, raw, sizeof(count));
+		valid = count <= CHUNK_SAMPLE_COUNT && static_cast<size_t>(rawSize) == sizeof(uint32_t) + count * SERIALIZED_SAMPLE_SIZE;
+	}
+
+	const unsigned char* gaps = reinterpret_cast<const unsigned char*>(raw) + sizeof(uint32_t);
+	const unsigned char* densityPlanes = gaps + count * sizeof(uint16_t);
+	const unsigned char* materialBytes = densityPlanes + count * sizeof(float);
+
+	unsigned int index = 0;
+	for (uint32_t i = 0; valid && i < count; i++) {
+		uint16_t gap;
+		std::memcpy(&gap, gaps + i * sizeof(uint16_t), sizeof(gap));
+		index += gap;
+		if (index >= CHUNK_SAMPLE_COUNT) {
+			valid = false;
+			break;
+		}
+
+		unsigned char bytes[sizeof(float)];
+		for (size_t b = 0; b < sizeof(float); b++) {
+			bytes[b] = densityPlanes[b * count + i];
+		}
+		float density;
+		std::memcpy(&density, bytes, sizeof(float));
+
+		samples[index] = { density, materialBytes[i] };
+	}
+
+	stbi_image_free(raw);
+	if (!valid) samples.clear();
+	return valid;
+}
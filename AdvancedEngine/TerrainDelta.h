@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+struct SampleOverride {
+	float density;
+	unsigned int material;
+};
+
+/*
+The samples of one chunk that were edited, applied on top of the TerrainGenerator output.
+Only this is saved, so the world on disk grows with what the player changed and not with how much was explored.
+*/
+class TerrainDelta {
+public:
+	void set(const unsigned int index, const float density, const unsigned int material);
+	void apply(std::vector<float>& densities, std::vector<unsigned int>& materials) const;
+
+	bool empty() const { return samples.empty(); }
+	size_t size() const { return samples.size(); }
+
+	// zlib compressed: sorted sample indices as gaps, densities as byte planes, 8 bit materials
+	std::vector<unsigned char> serialize() const;
+	bool deserialize(const unsigned char* data, const size_t size); // False when the data is corrupt
+
+	std::unordered_map<unsigned int, SampleOverride> samples; // By sampleIndex()
+};
@@ -0,0 +1,92 @@
+#include "TerrainEdit.h"
+#include "Settings.h"
+#include <algorithm>
+#include <cmath>
+
+const float ISO_LEVEL = 0.5f;
+
+// Signed distance to the edit shape, negative inside
+static float getDistance(const TerrainEdit& edit, const glm::vec3& position) {
+	const glm::vec3 delta = position - edit.center;
+
+	if (edit.shape == TerrainEditShape::Sphere) {
+		return std::sqrt(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z) - edit.size.x;
+	}
+
+	const float qx = std::abs(delta.x) - edit.size.x;
+	const float qy = std::abs(delta.y) - edit.size.y;
+	const float qz = std::abs(delta.z) - edit.size.z;
+	const float ox = std::max(qx, 0.0f);
+	const float oy = std::max(qy, 0.0f);
+	const float oz = std::max(qz, 0.0f);
+	return std::sqrt(ox * ox + oy * oy + oz * oz) + std::min(std::max(qx, std::max(qy, qz)), 0.0f);
+}
+
+void getTerrainEditBounds(const TerrainEdit& edit, glm::vec3& min, glm::vec3& max) {
+	const glm::vec3 extents = edit.shape == TerrainEditShape::Sphere ? glm::vec3(edit.size.x) : edit.size;
+	// Samples up to one unit outside the surface are blended, see getCoverage
+	min = edit.center - extents - glm::vec3(1.0f);
+	max = edit.center + extents + glm::vec3(1.0f);
+}
+
+// 1 inside the shape, 0 outside, with a one sample ramp so the new surface lands exactly on the shape
+static float getCoverage(const float distance) {
+	return std::clamp(ISO_LEVEL - distance, 0.0f, 1.0f);
+}
+
+bool applyTerrainEdit(const TerrainEdit& edit, const glm::ivec3& chunkPosition, std::vector<float>& densities, std::vector<unsigned int>& materials, TerrainDelta& delta, glm::ivec3& dirtyMin, glm::ivec3& dirtyMax) {
+	glm::vec3 boundsMin, boundsMax;
+	getTerrainEditBounds(edit, boundsMin, boundsMax);
+
+	// Edit bounds in the chunk's sample coordinates
+	const glm::vec3 chunkOrigin = glm::vec3(chunkPosition) * static_cast<float>(CHUNK_SIZE);
+	const int last = static_cast<int>(CHUNK_SAMPLES) - 1;
+	const int minX = std::max(static_cast<int>(std::ceil(boundsMin.x - chunkOrigin.x)), 0);
+	const int minY = std::max(static_cast<int>(std::ceil(boundsMin.y - chunkOrigin.y)), 0);
+	const int minZ = std::max(static_cast<int>(std::ceil(boundsMin.z - chunkOrigin.z)), 0);
+	const int maxX = std::min(static_cast<int>(std::floor(boundsMax.x - chunkOrigin.x)), last);
+	const int maxY = std::min(static_cast<int>(std::floor(boundsMax.y - chunkOrigin.y)), last);
+	const int maxZ = std::min(static_cast<int>(std::floor(boundsMax.z - chunkOrigin.z)), last);
+
+	bool changed = false;
+	dirtyMin = glm::ivec3(last, last, last);
+	dirtyMax = glm::ivec3(0, 0, 0);
+
+	for (int y = minY; y <= maxY; y++) {
+		for (int x = minX; x <= maxX; x++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				const float coverage = getCoverage(getDistance(edit, chunkOrigin + glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z))));
+				if (coverage <= 0.0f) continue;
+
+				const unsigned int index = sampleIndex(x, y, z);
+				const float oldDensity = densities[index];
+				float density = oldDensity;
+
+				switch (edit.mode) {
+				case TerrainEditMode::Dig:
+					density = std::min(density, 1.0f - coverage);
+					break;
+				case TerrainEditMode::Place:
+					density = std::max(density, coverage);
+					break;
+				case TerrainEditMode::Brush:
+					density = std::clamp(density + edit.strength * coverage, 0.0f, 1.0f);
+					break;
+				}
+
+				if (density == oldDensity) continue;
+
+				densities[index] = density;
+				if (oldDensity < ISO_LEVEL && density >= ISO_LEVEL) {
+					materials[index] = edit.material;
+				}
+				delta.set(index, density, materials[index]);
+
+				changed = true;
+				dirtyMin = glm::ivec3(std::min(dirtyMin.x, x), std::min(dirtyMin.y, y), std::min(dirtyMin.z, z));
+				dirtyMax = glm::ivec3(std::max(dirtyMax.x, x), std::max(dirtyMax.y, y), std::max(dirtyMax.z, z));
+			}
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "TerrainDelta.h"
+
+enum class TerrainEditShape {
+	Sphere, // size.x is the radius
+	Box // size is the half extents
+};
+
+enum class TerrainEditMode {
+	Dig, // Carves the shape out of the terrain
+	Place, // Fills the shape with material
+	Brush // Adds strength inside the shape, fading out at its surface. Negative strength removes
+};
+
+// A density edit in world space, queued with ChunksManager::queueEdit()
+struct TerrainEdit {
+	TerrainEditShape shape;
+	TerrainEditMode mode;
+	glm::vec3 center;
+	glm::vec3 size;
+	float strength; // Brush only
+	unsigned int material; // Given to the samples that Place or Brush turn solid
+};
+
+// World space box of the samples the edit can change
+void getTerrainEditBounds(const TerrainEdit& edit, glm::vec3& min, glm::vec3& max);
+
+// Applies the edit to one chunk's samples and records the changed ones in delta. Returns false when no sample changed, otherwise the changed samples are within [dirtyMin, dirtyMax]
+bool applyTerrainEdit(const TerrainEdit& edit, const glm::ivec3& chunkPosition, std::vector<float>& densities, std::vector<unsigned int>& materials, TerrainDelta& delta, glm::ivec3& dirtyMin, glm::ivec3& dirtyMax);
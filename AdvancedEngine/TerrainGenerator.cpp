@@ -1,6 +1,8 @@
 #include "TerrainGenerator.h"
 #include "Settings.h"
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
 TerrainGenerator::TerrainGenerator() {
 
@@ -14,6 +16,32 @@ TerrainGenerator::TerrainGenerator() {
 	fnCaveFractal->SetOctaveCount(5);
 }
 
+const float HEIGHTMAP_SCALE = 0.002f;
+const int TERRAIN_SEED = 69420;
+
+const float CAVE_SCALE = 0.005f;
+const float SURFACE_TRANSITION = 1.0f; // Meters over which the density goes from solid to air at the surface
+
+// The heightmap noise is in [-1, 1], cubed so most of the world is low with a few tall mountains
+static float getSurfaceHeight(const float noise) {
+	const float heightMapValue = (noise + 1) / 2.0f;
+	return powf(heightMapValue, 3) * 250.0f;
+}
+
+static float getDensity(const float surfaceHeight, const int worldY, const float caveNoise) {
+	const float caveDensity = std::clamp((0.95f - caveNoise) / SURFACE_TRANSITION, 0.0f, 1.0f);
+
+	float density = (surfaceHeight - worldY) / SURFACE_TRANSITION;
+	// Now density crosses 0 at surfaceHeight
+	density = std::clamp(density * 0.5f + 0.5f, 0.0f, 1.0f);
+
+	return density * caveDensity;
+}
+
+static unsigned int getMaterial(const float surfaceHeight, const int worldY) {
+	return worldY < surfaceHeight - 2 ? 0 : 2;
+}
+
 GeneratedTerrainResult TerrainGenerator::generateTerrain(const unsigned int& chunkPosX, const unsigned int& chunkPosY, const unsigned int& chunkPosZ) {
 	GeneratedTerrainResult result;
 
@@ -24,12 +52,8 @@ GeneratedTerrainResult TerrainGenerator::generateTerrain(const unsigned int& chu
 	std::vector<float> heightmap((CHUNK_SIZE + 1) * (CHUNK_SIZE + 1));
 	std::vector<float> caveMap((CHUNK_SIZE + 1) * (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1));
 
-	const float scale = 0.002f;
-	const float caveScale = 0.005f;
-	const float transition = 1.0f;
-
-	fnFractal->GenUniformGrid2D(heightmap.data(), chunkPosX * CHUNK_SIZE, chunkPosZ * CHUNK_SIZE, CHUNK_SIZE + 1, CHUNK_SIZE + 1, scale, 69420);
-	fnCaveFractal->GenUniformGrid3D(caveMap.data(), chunkPosX * CHUNK_SIZE, chunkPosY * CHUNK_SIZE, chunkPosZ * CHUNK_SIZE, CHUNK_SIZE + 1, CHUNK_SIZE + 1, CHUNK_SIZE + 1, caveScale, 69420);
+	fnFractal->GenUniformGrid2D(heightmap.data(), chunkPosX * CHUNK_SIZE, chunkPosZ * CHUNK_SIZE, CHUNK_SIZE + 1, CHUNK_SIZE + 1, HEIGHTMAP_SCALE, TERRAIN_SEED);
+	fnCaveFractal->GenUniformGrid3D(caveMap.data(), chunkPosX * CHUNK_SIZE, chunkPosY * CHUNK_SIZE, chunkPosZ * CHUNK_SIZE, CHUNK_SIZE + 1, CHUNK_SIZE + 1, CHUNK_SIZE + 1, CAVE_SCALE, TERRAIN_SEED);
 
 	for (unsigned int y = 0; y < CHUNK_SIZE + 1; y++) {
 		for (unsigned int x = 0; x < CHUNK_SIZE + 1; x++) {
@@ -38,26 +62,13 @@ GeneratedTerrainResult TerrainGenerator::generateTerrain(const unsigned int& chu
 
 
 
-				const int worldX = x + chunkPosX * CHUNK_SIZE;
 				const int worldY = y + chunkPosY * CHUNK_SIZE;
-				const int worldZ = z + chunkPosZ * CHUNK_SIZE;
 
 				const unsigned index = z + x * (CHUNK_SIZE + 1) + y * (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1);
 				const unsigned indexCave = x + y * (CHUNK_SIZE + 1) + z * (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1);
 
-				float caveDensity = (0.95f - caveMap[indexCave]) / transition;
-				caveDensity = std::clamp(caveDensity, 0.0f, 1.0f);
-
-				const float heightMapValue = (heightmap[z * (CHUNK_SIZE + 1) + x] + 1) / 2.0f;
-
-				const float realHeight = powf(heightMapValue, 3);
-
 				//const float heightMapValue = fnSimplex->GenSingle2D((float)(x + chunkPosX * (CHUNK_SIZE + 1)) * scale, (float)(z + chunkPosZ * (CHUNK_SIZE + 1)) * scale, 69420);
-				const float surfaceHeight = realHeight * 250.0f;
-
-				float density = (surfaceHeight - worldY) / transition;
-				// Now density crosses 0 at surfaceHeight
-				density = std::clamp(density * 0.5f + 0.5f, 0.0f, 1.0f);
+				const float surfaceHeight = getSurfaceHeight(heightmap[z * (CHUNK_SIZE + 1) + x]);
 
 				if (index > (CHUNK_SIZE + 1)* (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1)) {
 					std::cerr << "Index out of bounds: " << index << std::endl;
@@ -65,14 +76,8 @@ GeneratedTerrainResult TerrainGenerator::generateTerrain(const unsigned int& chu
 
 
 
-				densities[index] = density * caveDensity;
-				
-				if (worldY < surfaceHeight - 2) {
-					materials[index] = 0;
-				}
-				else {
-					materials[index] = 2;
-				}
+				densities[index] = getDensity(surfaceHeight, worldY, caveMap[indexCave]);
+				materials[index] = getMaterial(surfaceHeight, worldY);
 
 
 				
@@ -82,8 +87,61 @@ GeneratedTerrainResult TerrainGenerator::generateTerrain(const unsigned int& chu
 	}
 
 	return {
-		.densities = densities,
-		.materials = materials
+		.densities = std::move(densities),
+		.materials = std::move(materials)
 	};
 }
 
+void TerrainGenerator::generateHeights(const int gridX, const int gridZ, const unsigned int size, const float spacing, std::vector<float>& heights) {
+	heights.resize(size * size);
+
+	// Same noise coordinates as generateTerrain: the grid index times the frequency is world position * HEIGHTMAP_SCALE
+	fnFractal->GenUniformGrid2D(heights.data(), gridX, gridZ, size, size, HEIGHTMAP_SCALE * spacing, TERRAIN_SEED);
+
+	for (float& height : heights) {
+		height = getSurfaceHeight(height);
+	}
+}
+
+void TerrainGenerator::generateDensities(const int originX, const int originY, const int originZ, const unsigned int sizeX, const unsigned int sizeY, const unsigned int sizeZ, std::vector<float>& densities) {
+	std::vector<float> heightmap(sizeX * sizeZ);
+	std::vector<float> caveMap(sizeX * sizeY * sizeZ);
+	fnFractal->GenUniformGrid2D(heightmap.data(), originX, originZ, sizeX, sizeZ, HEIGHTMAP_SCALE, TERRAIN_SEED);
+	fnCaveFractal->GenUniformGrid3D(caveMap.data(), originX, originY, originZ, sizeX, sizeY, sizeZ, CAVE_SCALE, TERRAIN_SEED);
+
+	densities.resize(sizeX * sizeY * sizeZ);
+
+	for (unsigned int y = 0; y < sizeY; y++) {
+		for (unsigned int x = 0; x < sizeX; x++) {
+			for (unsigned int z = 0; z < sizeZ; z++) {
+				const float surfaceHeight = getSurfaceHeight(heightmap[z * sizeX + x]);
+				densities[z + x * sizeZ + y * sizeX * sizeZ] = getDensity(surfaceHeight, originY + static_cast<int>(y), caveMap[x + y * sizeX + z * sizeX * sizeY]);
+			}
+		}
+	}
+}
+
+float TerrainGenerator::getAirHeight(const float surfaceHeight) {
+	return surfaceHeight + SURFACE_TRANSITION;
+}
+
+void TerrainGenerator::generateBlock(const int originX, const int originY, const int originZ, const unsigned int size, const float* heights, const unsigned int heightsStride, std::vector<float>& densities, std::vector<unsigned char>& materials) {
+	std::vector<float> caveMap(size * size * size);
+	fnCaveFractal->GenUniformGrid3D(caveMap.data(), originX, originY, originZ, size, size, size, CAVE_SCALE, TERRAIN_SEED);
+
+	densities.resize(size * size * size);
+	materials.resize(size * size * size);
+
+	for (unsigned int y = 0; y < size; y++) {
+		for (unsigned int x = 0; x < size; x++) {
+			for (unsigned int z = 0; z < size; z++) {
+				const int worldY = originY + static_cast<int>(y);
+				const float surfaceHeight = heights[z * heightsStride + x];
+				const unsigned int index = z + x * size + y * size * size;
+
+				densities[index] = getDensity(surfaceHeight, worldY, caveMap[x + y * size + z * size * size]);
+				materials[index] = static_cast<unsigned char>(getMaterial(surfaceHeight, worldY));
+			}
+		}
+	}
+}
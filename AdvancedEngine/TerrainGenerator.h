@@ -15,6 +15,19 @@ public:
 
 	GeneratedTerrainResult generateTerrain(const unsigned int& chunkPosX, const unsigned int& chunkPosY, const unsigned int& chunkPosZ);
 
+	// Surface height of generateTerrain without the caves, on a size x size grid with x fastest. Grid point (i, j) is at world (gridX + i, gridZ + j) * spacing
+	void generateHeights(const int gridX, const int gridZ, const unsigned int size, const float spacing, std::vector<float>& heights);
+
+	// Samples of generateTerrain on a size^3 box of the world starting at origin, in the chunk layout (z fastest, then x, then y).
+	// heights are the surface heights of its columns from generateHeights, heights[z * heightsStride + x]
+	void generateBlock(const int originX, const int originY, const int originZ, const unsigned int size, const float* heights, const unsigned int heightsStride, std::vector<float>& densities, std::vector<unsigned char>& materials);
+
+	// Densities of generateTerrain on any box of the world, in the chunk layout with the given sizes (z fastest, then x, then y)
+	void generateDensities(const int originX, const int originY, const int originZ, const unsigned int sizeX, const unsigned int sizeY, const unsigned int sizeZ, std::vector<float>& densities);
+
+	// Samples at or above this height have density 0 whatever the caves
+	static float getAirHeight(const float surfaceHeight);
+
 	FastNoise::SmartNode<FastNoise::FractalFBm> fnFractal;
 	FastNoise::SmartNode<FastNoise::Simplex> fnSimplex;
 	FastNoise::SmartNode<FastNoise::FractalFBm> fnCaveFractal;
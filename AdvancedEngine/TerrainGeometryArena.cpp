@@ -0,0 +1,166 @@
+#include "TerrainGeometryArena.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+TerrainGeometryArena::TerrainGeometryArena(const std::vector<VertexAttribute>& vertexAttributes, const unsigned int vertexCapacity, const unsigned int indexCapacity) : vertexArena(vertexCapacity), indexArena(indexCapacity), lastDrawCount(0), lastTriangleCount(0), vertexAttributes(vertexAttributes) {
+	floatsPerVertex = 0;
+	for (const auto& attribute : vertexAttributes) {
+		floatsPerVertex += attribute.sizeInBytes / sizeof(float);
+	}
+
+	vbo = new VBO(vertexCapacity * floatsPerVertex, GL_DYNAMIC_DRAW);
+	vao = new VAO(vertexAttributes, vbo);
+	ebo = new EBO(indexCapacity, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &indirectBuffer);
+	glGenBuffers(1, &chunkOffsetsBuffer);
+	glGenBuffers(1, &growScratchBuffer);
+	Profiler::countGlObjectsCreated(3);
+}
+
+TerrainGeometryArena::~TerrainGeometryArena() {
+	delete vao;
+	delete vbo;
+	delete ebo;
+
+	glDeleteBuffers(1, &indirectBuffer);
+	glDeleteBuffers(1, &chunkOffsetsBuffer);
+	glDeleteBuffers(1, &growScratchBuffer);
+}
+
+ChunkGeometry TerrainGeometryArena::upload(const std::vector<float>& vertices, const std::vector<unsigned int>& indices) {
+	const unsigned int numVertices = vertices.size() / floatsPerVertex;
+	if (numVertices == 0 || indices.empty()) return { { 0, 0 }, { 0, 0 } };
+
+	const ChunkGeometry geometry = allocateGeometry(numVertices, indices.size());
+
+	// Uploads go through the copy target so the element buffer binding of whatever VAO is bound stays untouched
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo->vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, geometry.vertices.offset * floatsPerVertex * sizeof(float), numVertices * floatsPerVertex * sizeof(float), vertices.data());
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo->ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, geometry.indices.offset * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	return geometry;
+}
+
+ChunkGeometry TerrainGeometryArena::uploadFromStaging(StagingRing* stagingRing, const StagingAllocation& staging, const unsigned int numVertices, const unsigned int numIndices) {
+	if (numVertices == 0 || numIndices == 0) return { { 0, 0 }, { 0, 0 } };
+
+	const ChunkGeometry geometry = allocateGeometry(numVertices, numIndices);
+
+	const unsigned int vertexBytes = numVertices * floatsPerVertex * sizeof(float);
+	stagingRing->copyToBuffer(staging, 0, vertexBytes, vbo->vbo, geometry.vertices.offset * floatsPerVertex * sizeof(float));
+	stagingRing->copyToBuffer(staging, vertexBytes, numIndices * sizeof(unsigned int), ebo->ebo, geometry.indices.offset * sizeof(unsigned int));
+
+	return geometry;
+}
+
+void TerrainGeometryArena::release(ChunkGeometry& geometry) {
+	vertexArena.free(geometry.vertices);
+	indexArena.free(geometry.indices);
+	geometry = { { 0, 0 }, { 0, 0 } };
+}
+
+void TerrainGeometryArena::addDraw(const ChunkGeometry& geometry, const glm::vec3& chunkOrigin) {
+	if (!geometry.isValid()) return;
+
+	drawCommands.push_back({
+		.count = geometry.indices.size,
+		.instanceCount = 1,
+		.firstIndex = geometry.indices.offset,
+		.baseVertex = static_cast<GLint>(geometry.vertices.offset),
+		.baseInstance = 0
+	});
+	chunkOffsets.emplace_back(chunkOrigin, 0.0f);
+}
+
+void TerrainGeometryArena::draw() {
+	lastDrawCount = drawCommands.size();
+	lastTriangleCount = 0;
+	if (drawCommands.empty()) return;
+
+	for (const DrawElementsIndirectCommand& command : drawCommands) {
+		lastTriangleCount += command.count / 3;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, drawCommands.size() * sizeof(DrawElementsIndirectCommand), drawCommands.data(), GL_STREAM_DRAW);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, chunkOffsetsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, chunkOffsets.size() * sizeof(glm::vec4), chunkOffsets.data(), GL_STREAM_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CHUNK_OFFSETS_BINDING, chunkOffsetsBuffer);
+
+	vao->bind();
+	ebo->bind();
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, drawCommands.size(), 0);
+	vao->unbind();
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	drawCommands.clear();
+	chunkOffsets.clear();
+}
+
+ChunkGeometry TerrainGeometryArena::allocateGeometry(const unsigned int numVertices, const unsigned int numIndices) {
+	ChunkGeometry geometry = { vertexArena.allocate(numVertices), indexArena.allocate(numIndices) };
+
+	if (!geometry.vertices.isValid()) {
+		growVertexBuffer(numVertices);
+		geometry.vertices = vertexArena.allocate(numVertices);
+	}
+	if (!geometry.indices.isValid()) {
+		growIndexBuffer(numIndices);
+		geometry.indices = indexArena.allocate(numIndices);
+	}
+
+	if (!geometry.vertices.isValid() || !geometry.indices.isValid()) {
+		throw std::runtime_error("Failed to allocate terrain geometry");
+	}
+
+	return geometry;
+}
+
+void TerrainGeometryArena::growVertexBuffer(const unsigned int requiredVertices) {
+	const unsigned int newCapacity = std::max(vertexArena.capacity * 2, vertexArena.capacity + requiredVertices);
+
+	// Same buffer name, so the VAO keeps pointing at it
+	resizeBuffer(vbo->vbo, vbo->size * sizeof(float), newCapacity * floatsPerVertex * sizeof(float));
+	vbo->size = newCapacity * floatsPerVertex;
+
+	vertexArena.grow(newCapacity);
+
+	std::cout << "Terrain vertex arena grown to " << newCapacity << " vertices" << std::endl;
+}
+
+void TerrainGeometryArena::growIndexBuffer(const unsigned int requiredIndices) {
+	const unsigned int newCapacity = std::max(indexArena.capacity * 2, indexArena.capacity + requiredIndices);
+
+	resizeBuffer(ebo->ebo, ebo->numberOfElements * sizeof(unsigned int), newCapacity * sizeof(unsigned int));
+	ebo->numberOfElements = newCapacity;
+
+	indexArena.grow(newCapacity);
+
+	std::cout << "Terrain index arena grown to " << newCapacity << " indices" << std::endl;
+}
+
+void TerrainGeometryArena::resizeBuffer(const GLuint buffer, const unsigned int oldBytes, const unsigned int newBytes) {
+	// The contents wait in the scratch buffer while glBufferData orphans the old storage and gives the name a bigger one
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, growScratchBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, oldBytes, nullptr, GL_STREAM_COPY);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+
+	glBufferData(GL_COPY_READ_BUFFER, newBytes, nullptr, GL_DYNAMIC_DRAW);
+	glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, oldBytes);
+
+	// Orphaned too, the driver frees it once the copy is done
+	glBufferData(GL_COPY_WRITE_BUFFER, 0, nullptr, GL_STREAM_COPY);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
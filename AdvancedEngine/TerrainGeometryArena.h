@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "BufferArena.h"
+#include "VAO.h"
+#include "VBO.h"
+#include "EBO.h"
+#include "StagingRing.h"
+
+// Binding point of the chunk offsets SSBO read by the terrain vertex shader
+const unsigned int CHUNK_OFFSETS_BINDING = 0;
+
+// Where a chunk's geometry lives inside the arena buffers
+struct ChunkGeometry {
+	ArenaRange vertices;
+	ArenaRange indices;
+
+	bool isValid() const { return indices.isValid(); }
+};
+
+// Layout of one command in the GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/*
+One vertex buffer and one index buffer shared by all terrain chunks, sub-allocated with BufferArena.
+
+Chunks queue themselves with addDraw() every frame, then draw() renders all of them with a single
+glMultiDrawElementsIndirect. The chunk origins go to an SSBO indexed by gl_DrawID.
+The buffers double in size when they run out of space, keeping their GL names.
+*/
+class TerrainGeometryArena {
+public:
+	TerrainGeometryArena(const std::vector<VertexAttribute>& vertexAttributes, const unsigned int vertexCapacity, const unsigned int indexCapacity);
+	~TerrainGeometryArena();
+
+	ChunkGeometry upload(const std::vector<float>& vertices, const std::vector<unsigned int>& indices);
+	// The staging allocation holds the vertices followed by the indices
+	ChunkGeometry uploadFromStaging(StagingRing* stagingRing, const StagingAllocation& staging, const unsigned int numVertices, const unsigned int numIndices);
+	void release(ChunkGeometry& geometry);
+
+	void addDraw(const ChunkGeometry& geometry, const glm::vec3& chunkOrigin);
+	void draw(); // Draws everything queued since the last call
+
+	BufferArena vertexArena;
+	BufferArena indexArena;
+
+	unsigned int lastDrawCount;
+	unsigned int lastTriangleCount;
+
+private:
+	ChunkGeometry allocateGeometry(const unsigned int numVertices, const unsigned int numIndices);
+	void growVertexBuffer(const unsigned int requiredVertices);
+	void growIndexBuffer(const unsigned int requiredIndices);
+	void resizeBuffer(const GLuint buffer, const unsigned int oldBytes, const unsigned int newBytes); // Keeps the first oldBytes
+
+	std::vector<VertexAttribute> vertexAttributes;
+	unsigned int floatsPerVertex;
+
+	VBO* vbo;
+	VAO* vao;
+	EBO* ebo;
+	GLuint indirectBuffer;
+	GLuint chunkOffsetsBuffer;
+	GLuint growScratchBuffer; // Holds the old contents while a buffer is resized
+
+	std::vector<DrawElementsIndirectCommand> drawCommands;
+	std::vector<glm::vec4> chunkOffsets;
+};
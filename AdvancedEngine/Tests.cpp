@@ -0,0 +1,122 @@
+#include "Tests.h"
+#include "BufferArena.h"
+#include <iostream>
+
+static unsigned int failedChecks = 0;
+
+static void check(const bool condition, const char* test, const char* description) {
+	if (condition) return;
+
+	std::cerr << "[" << test << "] Failed: " << description << std::endl;
+	failedChecks++;
+}
+
+bool runTest(const std::string& name) {
+	const bool all = name == "all";
+	bool ran = false;
+	bool passed = true;
+
+	if (all || name == "arena") {
+		passed = testBufferArena() && passed;
+		ran = true;
+	}
+
+	if (!ran) {
+		std::cerr << "Unknown test: " << name << std::endl;
+		return false;
+	}
+
+	std::cout << (passed ? "All tests passed" : "Some tests failed") << std::endl;
+	return passed;
+}
+
+bool testBufferArena() {
+	const unsigned int failedBefore = failedChecks;
+	const char* test = "arena";
+
+	// Allocation is contiguous from the start of an empty arena
+	{
+		BufferArena arena(100);
+		const ArenaRange a = arena.allocate(10);
+		const ArenaRange b = arena.allocate(20);
+		const ArenaRange c = arena.allocate(30);
+
+		check(a.offset == 0 && a.size == 10, test, "first range starts at 0");
+		check(b.offset == 10 && b.size == 20, test, "second range follows the first");
+		check(c.offset == 30 && c.size == 30, test, "third range follows the second");
+		check(arena.usedSize == 60, test, "used size counts the three ranges");
+		check(arena.freeBlockCount() == 1 && arena.largestFreeBlock() == 40, test, "the tail is one free block");
+
+		check(!arena.allocate(0).isValid(), test, "empty allocations fail");
+		check(!arena.allocate(41).isValid(), test, "allocations larger than the free space fail");
+		check(arena.usedSize == 60, test, "failed allocations don't change the used size");
+
+		// Freeing the middle leaves a hole, freeing its neighbours merges everything back
+		arena.free(b);
+		check(arena.freeBlockCount() == 2, test, "a freed range between used ones stays separate");
+		check(arena.usedSize == 40, test, "used size drops by the freed range");
+
+		arena.free(a);
+		check(arena.freeBlockCount() == 2 && arena.largestFreeBlock() == 40, test, "a freed range merges with the free block after it");
+
+		arena.free(c);
+		check(arena.freeBlockCount() == 1 && arena.largestFreeBlock() == 100, test, "a freed range merges with the blocks on both sides");
+		check(arena.usedSize == 0, test, "everything freed");
+
+		const ArenaRange whole = arena.allocate(100);
+		check(whole.offset == 0 && whole.size == 100, test, "the merged arena fits one full allocation");
+		arena.free({ 0, 0 });
+		check(arena.usedSize == 100, test, "freeing an invalid range does nothing");
+	}
+
+	// Best fit takes the smallest block that is large enough, not the first one
+	{
+		BufferArena arena(100);
+		const ArenaRange a = arena.allocate(30);
+		arena.allocate(5);
+		const ArenaRange c = arena.allocate(10);
+		arena.allocate(55);
+		arena.free(a); // 30 free at 0
+		arena.free(c); // 10 free at 35
+
+		const ArenaRange fit = arena.allocate(8);
+		check(fit.offset == 35 && fit.size == 8, test, "best fit picks the 10 block over the 30 one");
+		check(arena.largestFreeBlock() == 30, test, "the larger block is untouched");
+
+		const ArenaRange exact = arena.allocate(30);
+		check(exact.offset == 0, test, "an exact fit uses the whole block");
+		check(arena.freeBlockCount() == 1 && arena.largestFreeBlock() == 2, test, "only the rest of the split block is free");
+
+		const ArenaRange rest = arena.allocate(2);
+		check(rest.offset == 43, test, "the split remainder is reused");
+		check(arena.freeBlockCount() == 0 && arena.largestFreeBlock() == 0, test, "the arena is full");
+		check(!arena.allocate(1).isValid(), test, "a full arena fails allocations");
+	}
+
+	// Growing appends space and merges it with a free block at the end, existing ranges keep their offsets
+	{
+		BufferArena arena(50);
+		const ArenaRange a = arena.allocate(30);
+		arena.grow(80);
+
+		check(arena.capacity == 80, test, "grow sets the capacity");
+		check(arena.usedSize == 30, test, "grow doesn't change the used size");
+		check(arena.freeBlockCount() == 1 && arena.largestFreeBlock() == 50, test, "the new space merges with the free tail");
+
+		const ArenaRange b = arena.allocate(50);
+		check(b.offset == 30, test, "the grown space is allocated after the existing range");
+		check(a.offset == 0, test, "the existing range keeps its offset");
+
+		arena.grow(60);
+		check(arena.capacity == 80, test, "grow never shrinks");
+
+		arena.grow(100);
+		check(arena.freeBlockCount() == 1 && arena.largestFreeBlock() == 20, test, "grow of a full arena adds one block");
+		const ArenaRange c = arena.allocate(20);
+		check(c.offset == 80, test, "the block added by grow starts at the old capacity");
+	}
+
+	const bool passed = failedChecks == failedBefore;
+	std::cout << "BufferArena: " << (passed ? "passed" : "failed") << std::endl;
+	return passed;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Headless self tests, started with "--test <name>" on the command line ("--test all" runs every one).
+// Failed checks are printed to stderr, the process exits with 1 if any failed.
+
+bool runTest(const std::string& name);
+
+bool testBufferArena(); // Allocation, freeing and coalescing, best fit choice and growth, "--test arena"
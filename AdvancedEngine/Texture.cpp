@@ -1,69 +1,208 @@
 #include "Texture.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <iostream>
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 
-Texture::Texture(std::vector<const char*> paths) {
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* data = nullptr; // Owned by stb_image
+};
+
+static DecodedImage decodeImage(const char* path) {
+    DecodedImage image;
+    image.data = stbi_load(path, &image.width, &image.height, &image.channels, 0);
+    if (!image.data) {
+        throw std::runtime_error(std::string("Failed to load texture: ") + path);
+    }
+    return image;
+}
+
+static void freeImages(std::vector<DecodedImage>& images) {
+    for (DecodedImage& image : images) {
+        if (image.data) {
+            stbi_image_free(image.data);
+            image.data = nullptr;
+        }
+    }
+}
+
+// Stacks the images vertically into level 0, frees them, then builds the mip chain
+static void buildAtlas(const std::vector<const char*>& paths, std::vector<DecodedImage>& images, TextureAtlasInfo& info, std::vector<unsigned char>& pixels) {
+    const int width = images[0].width;
+    const int channels = images[0].channels;
+    int totalHeight = 0;
+
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].width != width || images[i].channels != channels) {
+            const std::string message = std::string("All textures must have the same width and channel count to stack vertically. ") + std::to_string(images[i].width) + " != " + std::to_string(width) + " or " + std::to_string(images[i].channels) + " != " + std::to_string(channels) + ". Problematic texture: " + std::string(paths[i]);
+            freeImages(images);
+            throw std::runtime_error(message);
+        }
+        totalHeight += images[i].height;
+    }
+
+    info = { static_cast<unsigned int>(width), static_cast<unsigned int>(totalHeight), static_cast<unsigned int>(channels), 1 };
+    pixels.resize(TextureCache::getLevelSize(info, 0));
+
+    // The images are tightly packed with the same row size, each one is a single copy
+    size_t offset = 0;
+    for (DecodedImage& image : images) {
+        const size_t imageSize = static_cast<size_t>(image.width) * image.height * image.channels;
+        memcpy(pixels.data() + offset, image.data, imageSize);
+        offset += imageSize;
+    }
+    freeImages(images);
+
+    TextureCache::generateMipmaps(info, pixels);
+}
+
+static GLenum getFormat(const unsigned int channels) {
+    switch (channels) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+static GLenum getInternalFormat(const unsigned int channels) {
+    switch (channels) {
+    case 1: return GL_R8;
+    case 2: return GL_RG8;
+    case 3: return GL_RGB8;
+    default: return GL_RGBA8;
+    }
+}
+
+Texture::Texture() {
     glGenTextures(1, &textureID);
+    Profiler::countGlObjectsCreated(1);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-    int width = 0, totalHeight = 0, channels = 0;
-    std::vector<unsigned char*> images;
-    std::vector<int> heights;
+std::vector<Texture*> Texture::loadTextures(const std::vector<std::vector<const char*>>& pathSets, WorkerPool* workerPool) {
+    const auto start = std::chrono::high_resolution_clock::now();
 
-    // Load all textures
-    for (auto path : paths) {
-        int w, h, c;
-        unsigned char* data = stbi_load(path, &w, &h, &c, 0);
-        if (!data) {
-            throw std::runtime_error(std::string("Failed to load texture: ") + path);
-        }
-        if (width == 0) {
-            width = w;
-            channels = c;
+    std::vector<Texture*> textures;
+    std::vector<unsigned int> missingSets;
+
+    for (unsigned int set = 0; set < pathSets.size(); set++) {
+        textures.push_back(new Texture());
+
+        TextureAtlasInfo info;
+        MappedFile cacheFile;
+        const unsigned char* cachedPixels = nullptr;
+        if (TextureCache::open(pathSets[set], cacheFile, info, cachedPixels)) {
+            textures[set]->upload(info, cachedPixels);
         }
         else {
-            if (w != width || c != channels) {
-                throw std::runtime_error(std::string("All textures must have the same width and channel count to stack vertically. ") + std::to_string(w) + " != " + std::to_string(width) + " or " + std::to_string(c) + " != " + std::to_string(channels) + ". Problematic texture: " + std::string(path));
-            }
+            missingSets.push_back(set);
         }
-        images.push_back(data);
-        heights.push_back(h);
-        totalHeight += h;
     }
 
-    // Allocate a big buffer
-    size_t imageSize = width * totalHeight * channels;
-    unsigned char* stackedData = new unsigned char[imageSize];
+    if (!missingSets.empty()) {
+        // Exceptions can't leave a worker, the first error is rethrown here
+        std::mutex errorMutex;
+        std::string error;
+        auto recordError = [&](const std::exception& e) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (error.empty()) error = e.what();
+        };
 
-    // Copy images into stackedData at the right offset
-    int yOffset = 0;
-    for (size_t i = 0; i < images.size(); i++) {
-        int h = heights[i];
-        size_t rowSize = width * channels;
-        for (int row = 0; row < h; row++) {
-            memcpy(
-                stackedData + ((yOffset + row) * rowSize),
-                images[i] + (row * rowSize),
-                rowSize
-            );
+        // Every image of every missing texture is one task, they are the slow part
+        struct ImageJob {
+            unsigned int set;
+            unsigned int image;
+        };
+        std::vector<std::vector<DecodedImage>> images(pathSets.size());
+        std::vector<ImageJob> imageJobs;
+        for (const unsigned int set : missingSets) {
+            images[set].resize(pathSets[set].size());
+            for (unsigned int image = 0; image < pathSets[set].size(); image++) {
+                imageJobs.push_back({ set, image });
+            }
+        }
+
+        workerPool->parallelFor(imageJobs.size(), [&](const unsigned int job) {
+            const ImageJob& imageJob = imageJobs[job];
+            try {
+                images[imageJob.set][imageJob.image] = decodeImage(pathSets[imageJob.set][imageJob.image]);
+            }
+            catch (const std::exception& e) {
+                recordError(e);
+            }
+        });
+
+        std::vector<TextureAtlasInfo> infos(pathSets.size());
+        std::vector<std::vector<unsigned char>> atlases(pathSets.size());
+
+        if (error.empty()) {
+            workerPool->parallelFor(missingSets.size(), [&](const unsigned int task) {
+                const unsigned int set = missingSets[task];
+                try {
+                    buildAtlas(pathSets[set], images[set], infos[set], atlases[set]);
+                    TextureCache::store(pathSets[set], infos[set], atlases[set]);
+                }
+                catch (const std::exception& e) {
+                    recordError(e);
+                }
+            });
+        }
+
+        if (!error.empty()) {
+            for (std::vector<DecodedImage>& setImages : images) {
+                freeImages(setImages);
+            }
+            for (Texture* texture : textures) {
+                glDeleteTextures(1, &texture->textureID);
+                delete texture;
+            }
+            throw std::runtime_error(error);
+        }
+
+        for (const unsigned int set : missingSets) {
+            textures[set]->upload(infos[set], atlases[set].data());
         }
-        yOffset += h;
-        stbi_image_free(images[i]);
     }
 
-    // Upload to OpenGL
-    GLenum format = (channels == 3) ? GL_RGB : GL_RGBA;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, totalHeight, 0, format, GL_UNSIGNED_BYTE, stackedData);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Loaded " << textures.size() << " textures in " << elapsed << " ms, " << textures.size() - missingSets.size() << " from the cache" << std::endl;
+
+    return textures;
+}
+
+void Texture::upload(const TextureAtlasInfo& info, const unsigned char* pixels) {
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexStorage2D(GL_TEXTURE_2D, info.levels, getInternalFormat(info.channels), info.width, info.height);
+
+    // Levels are tightly packed, the small ones have rows that aren't a multiple of 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const GLenum format = getFormat(info.channels);
+    size_t offset = 0;
+    for (unsigned int level = 0; level < info.levels; level++) {
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, TextureCache::getLevelWidth(info, level), TextureCache::getLevelHeight(info, level), format, GL_UNSIGNED_BYTE, pixels + offset);
+        offset += TextureCache::getLevelSize(info, level);
+    }
 
-    delete[] stackedData;
-}
\ No newline at end of file
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
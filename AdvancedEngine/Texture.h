@@ -2,12 +2,23 @@
 
 #include <glad/gl.h>
 #include <vector>
+#include "TextureCache.h"
 
+class WorkerPool;
+
+// Images of the same width stacked vertically into one texture, with mipmaps
 class Texture {
 public:
-	Texture(std::vector<const char*> paths);
+	// Loads several textures at once. Cached atlases are mapped and uploaded, the others are decoded
+	// and mipmapped on the workers, then cached for the next launch. Uploads happen on the calling thread
+	static std::vector<Texture*> loadTextures(const std::vector<std::vector<const char*>>& pathSets, WorkerPool* workerPool);
 
 	void load();
 
 	GLuint textureID;
-};
\ No newline at end of file
+
+private:
+	Texture();
+
+	void upload(const TextureAtlasInfo& info, const unsigned char* pixels);
+};
@@ -0,0 +1,171 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+const char* TEXTURE_CACHE_DIRECTORY = "texture_cache";
+const uint32_t TEXTURE_CACHE_MAGIC = 0x43545441; // "ATTC"
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+struct TextureCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceKey; // Changes with the size or modification time of any image
+	uint32_t width;
+	uint32_t height;
+	uint32_t channels;
+	uint32_t levels;
+};
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void* data, const size_t length) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t hashPaths(const std::vector<const char*>& paths) {
+	uint64_t hash = 14695981039346656037ull;
+	for (const char* path : paths) {
+		hash = hashBytes(hash, path, std::strlen(path) + 1);
+	}
+	return hash;
+}
+
+static uint64_t getSourceKey(const std::vector<const char*>& paths) {
+	uint64_t hash = hashPaths(paths);
+	for (const char* path : paths) {
+		std::error_code error;
+		const uint64_t size = std::filesystem::file_size(path, error);
+		const int64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		hash = hashBytes(hash, &size, sizeof(size));
+		hash = hashBytes(hash, &modified, sizeof(modified));
+	}
+	return hash;
+}
+
+static std::string getCachePath(const std::vector<const char*>& paths) {
+	char fileName[32];
+	std::snprintf(fileName, sizeof(fileName), "%016llx.tex", static_cast<unsigned long long>(hashPaths(paths)));
+	return (std::filesystem::path(TEXTURE_CACHE_DIRECTORY) / fileName).string();
+}
+
+bool TextureCache::open(const std::vector<const char*>& paths, MappedFile& file, TextureAtlasInfo& info, const unsigned char*& pixels) {
+	if (!file.open(getCachePath(paths))) return false;
+
+	TextureCacheHeader header;
+	if (file.size < sizeof(header)) return false;
+	std::memcpy(&header, file.data, sizeof(header));
+
+	if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION) return false;
+	if (header.sourceKey != getSourceKey(paths)) return false;
+	if (header.channels < 1 || header.channels > 4 || header.levels != getLevelCount(header.width, header.height)) return false;
+
+	info = { header.width, header.height, header.channels, header.levels };
+	if (file.size != sizeof(header) + getAtlasSize(info)) return false;
+
+	pixels = file.data + sizeof(header);
+	return true;
+}
+
+void TextureCache::store(const std::vector<const char*>& paths, const TextureAtlasInfo& info, const std::vector<unsigned char>& pixels) {
+	std::error_code error;
+	std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, error);
+
+	const std::string path = getCachePath(paths);
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		std::cout << "Could not write the texture cache entry " << path << std::endl;
+		return;
+	}
+
+	const TextureCacheHeader header = {
+		.magic = TEXTURE_CACHE_MAGIC,
+		.version = TEXTURE_CACHE_VERSION,
+		.sourceKey = getSourceKey(paths),
+		.width = info.width,
+		.height = info.height,
+		.channels = info.channels,
+		.levels = info.levels
+	};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(pixels.data()), getAtlasSize(info));
+}
+
+unsigned int TextureCache::getLevelCount(const unsigned int width, const unsigned int height) {
+	unsigned int levels = 1;
+	unsigned int size = std::max(width, height);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+unsigned int TextureCache::getLevelWidth(const TextureAtlasInfo& info, const unsigned int level) {
+	return std::max(1u, info.width >> level);
+}
+
+unsigned int TextureCache::getLevelHeight(const TextureAtlasInfo& info, const unsigned int level) {
+	return std::max(1u, info.height >> level);
+}
+
+size_t TextureCache::getLevelSize(const TextureAtlasInfo& info, const unsigned int level) {
+	return static_cast<size_t>(getLevelWidth(info, level)) * getLevelHeight(info, level) * info.channels;
+}
+
+size_t TextureCache::getAtlasSize(const TextureAtlasInfo& info) {
+	size_t size = 0;
+	for (unsigned int level = 0; level < info.levels; level++) {
+		size += getLevelSize(info, level);
+	}
+	return size;
+}
+
+void TextureCache::generateMipmaps(TextureAtlasInfo& info, std::vector<unsigned char>& pixels) {
+	info.levels = getLevelCount(info.width, info.height);
+	pixels.resize(getAtlasSize(info));
+
+	const unsigned int channels = info.channels;
+	size_t sourceOffset = 0;
+
+	for (unsigned int level = 1; level < info.levels; level++) {
+		const unsigned int sourceWidth = getLevelWidth(info, level - 1);
+		const unsigned int sourceHeight = getLevelHeight(info, level - 1);
+		const unsigned int width = getLevelWidth(info, level);
+		const unsigned int height = getLevelHeight(info, level);
+
+		const unsigned char* source = pixels.data() + sourceOffset;
+		unsigned char* destination = pixels.data() + sourceOffset + getLevelSize(info, level - 1);
+
+		for (unsigned int y = 0; y < height; y++) {
+			// A side that is already 1 pixel wide samples the same row/column twice
+			const unsigned int y0 = std::min(y * 2, sourceHeight - 1);
+			const unsigned int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+
+			for (unsigned int x = 0; x < width; x++) {
+				const unsigned int x0 = std::min(x * 2, sourceWidth - 1);
+				const unsigned int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+
+				for (unsigned int c = 0; c < channels; c++) {
+					const unsigned int sum =
+						source[(static_cast<size_t>(y0) * sourceWidth + x0) * channels + c] +
+						source[(static_cast<size_t>(y0) * sourceWidth + x1) * channels + c] +
+						source[(static_cast<size_t>(y1) * sourceWidth + x0) * channels + c] +
+						source[(static_cast<size_t>(y1) * sourceWidth + x1) * channels + c];
+					destination[(static_cast<size_t>(y) * width + x) * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+
+		sourceOffset += getLevelSize(info, level - 1);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "MappedFile.h"
+
+// Size of a stacked texture atlas and its mip chain
+struct TextureAtlasInfo {
+	unsigned int width;
+	unsigned int height; // All the images stacked vertically
+	unsigned int channels;
+	unsigned int levels;
+};
+
+/*
+Disk cache of texture atlases ready for upload: the images stacked vertically with every mip level
+already built, stored raw one level after the other. A hit is a memory map and a glTexSubImage2D
+per level, no PNG decoding and no glGenerateMipmap.
+
+Entries live in texture_cache/, named after the image paths. They are rebuilt when one of the
+images changes size or modification time.
+*/
+class TextureCache {
+public:
+	// Maps the entry for these images, pixels points into the mapping. False on a miss or a stale entry
+	static bool open(const std::vector<const char*>& paths, MappedFile& file, TextureAtlasInfo& info, const unsigned char*& pixels);
+	static void store(const std::vector<const char*>& paths, const TextureAtlasInfo& info, const std::vector<unsigned char>& pixels);
+
+	// Levels are tightly packed, level 0 first
+	static unsigned int getLevelCount(const unsigned int width, const unsigned int height);
+	static unsigned int getLevelWidth(const TextureAtlasInfo& info, const unsigned int level);
+	static unsigned int getLevelHeight(const TextureAtlasInfo& info, const unsigned int level);
+	static size_t getLevelSize(const TextureAtlasInfo& info, const unsigned int level);
+	static size_t getAtlasSize(const TextureAtlasInfo& info);
+
+	// pixels holds level 0 on input and the whole chain on output, 2x2 box filter like glGenerateMipmap
+	static void generateMipmaps(TextureAtlasInfo& info, std::vector<unsigned char>& pixels);
+};
@@ -0,0 +1,22 @@
+#include "UniformBuffer.h"
+#include "Profiler.h"
+
+UniformBuffer::UniformBuffer(const unsigned int size, const unsigned int binding) : size(size), binding(binding) {
+	glGenBuffers(1, &ubo);
+	Profiler::countGlObjectsCreated(1);
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
+
+UniformBuffer::~UniformBuffer() {
+	glDeleteBuffers(1, &ubo);
+}
+
+void UniformBuffer::update(const void* data, const unsigned int size) {
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// Binding point of the CameraData uniform block shared by the shaders
+const unsigned int CAMERA_UNIFORMS_BINDING = 0;
+
+// CPU side of the CameraData block, std140 layout
+struct CameraUniforms {
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 inverseViewProjection; // Rebuilds world positions from the depth buffer
+	glm::vec4 cameraPosition; // w is unused
+};
+
+/*
+A uniform buffer bound to a fixed binding point, shared by every program declaring the block with
+layout (std140, binding = ...). Updated once per frame instead of setting uniforms per program.
+*/
+class UniformBuffer {
+public:
+	UniformBuffer(const unsigned int size, const unsigned int binding);
+	~UniformBuffer();
+
+	void update(const void* data, const unsigned int size);
+
+	GLuint ubo;
+	unsigned int size;
+	unsigned int binding;
+};
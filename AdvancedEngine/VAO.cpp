@@ -1,4 +1,5 @@
 #include "VAO.h"
+#include "Profiler.h"
 #include <iostream>
 #include <stdexcept>
 
@@ -10,6 +11,7 @@ VAO::VAO(std::vector<VertexAttribute> vertexAttributes, VBO* vbo) {
 	this->vbo = vbo;
 	
 	glGenVertexArrays(1, &vao);
+	Profiler::countGlObjectsCreated(1);
 	bind();
 	vbo->bind();
 	
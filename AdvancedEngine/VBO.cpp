@@ -1,4 +1,5 @@
 #include "VBO.h"
+#include "Profiler.h"
 
 
 VBO::VBO(std::vector<float> vertices, GLenum usage) {
@@ -6,11 +7,23 @@ VBO::VBO(std::vector<float> vertices, GLenum usage) {
 	size = vertices.size();
 
 	glGenBuffers(1, &vbo);
+	Profiler::countGlObjectsCreated(1);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), usage);
 }
 
+VBO::VBO(const unsigned int size, GLenum usage) {
+
+	this->size = size;
+
+	glGenBuffers(1, &vbo);
+	Profiler::countGlObjectsCreated(1);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	glBufferData(GL_ARRAY_BUFFER, size * sizeof(float), nullptr, usage);
+}
+
 void VBO::bind() {
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 }
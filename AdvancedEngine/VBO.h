@@ -6,6 +6,7 @@
 class VBO {
 public:
 	VBO(std::vector<float> vertices, GLenum usage);
+	VBO(const unsigned int size, GLenum usage); // Allocates storage for size floats without uploading anything
 	~VBO();
 
 	GLuint vbo;
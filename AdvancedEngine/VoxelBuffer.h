@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+
+/*
+The samples of one chunk, CHUNK_SAMPLES^3 by sampleIndex().
+
+Moved out of the TerrainGenerator once, then shared as std::shared_ptr<const VoxelBuffer> by knownChunks,
+the Chunk, its collision shape, the mesher and the voxel queries. A shared buffer is never written: edits
+copy it, change the copy and swap it in, and whoever still holds the old one keeps a consistent snapshot.
+*/
+struct VoxelBuffer {
+	std::vector<float> densities;
+	std::vector<unsigned int> materials;
+};
@@ -0,0 +1,209 @@
+#include "VoxelOctree.h"
+#include "Settings.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <limits>
+
+const uint32_t AIR_MATERIAL = 2; // What generateTerrain gives above the surface
+
+constexpr unsigned int BRICK_SAMPLE_COUNT = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+
+static unsigned int brickSampleIndex(const unsigned int x, const unsigned int y, const unsigned int z) {
+	return z + x * BRICK_SAMPLES + y * BRICK_SAMPLES * BRICK_SAMPLES;
+}
+
+static glm::ivec3 getChildOffset(const unsigned int child) {
+	return glm::ivec3(child & 1, (child >> 1) & 1, (child >> 2) & 1);
+}
+
+static bool isUniformLeaf(const OctreeNode& node) {
+	return node.children == OCTREE_LEAF && node.brick == OCTREE_UNIFORM;
+}
+
+VoxelOctree::VoxelOctree(TerrainGenerator* terrainGenerator, const glm::ivec3& rootPosition) : origin(rootPosition * static_cast<int>(OCTREE_ROOT_CELLS)) {
+	PROFILE_ZONE("Build voxel octree");
+
+	// Surface heights of every column of the root, shared by all of its nodes
+	std::vector<float> heights;
+	terrainGenerator->generateHeights(origin.x, origin.z, OCTREE_ROOT_CELLS + 1, 1.0f, heights);
+
+	nodes.push_back({ OCTREE_LEAF, OCTREE_UNIFORM, 0.0f, AIR_MATERIAL });
+	buildNode(terrainGenerator, heights, 0, glm::ivec3(0, 0, 0), OCTREE_LEVELS - 1);
+
+	nodes.shrink_to_fit();
+	brickDensities.shrink_to_fit();
+	brickMaterials.shrink_to_fit();
+}
+
+void VoxelOctree::buildNode(TerrainGenerator* terrainGenerator, const std::vector<float>& heights, const uint32_t index, const glm::ivec3& min, const unsigned int level) {
+	const unsigned int cells = BRICK_CELLS << level;
+	const unsigned int heightsStride = OCTREE_ROOT_CELLS + 1;
+
+	// Above every column's surface the density is 0 whatever the caves, the whole subtree is pruned before any 3D noise
+	float maxSurfaceHeight = -std::numeric_limits<float>::max();
+	for (unsigned int z = min.z; z <= min.z + cells; z++) {
+		for (unsigned int x = min.x; x <= min.x + cells; x++) {
+			maxSurfaceHeight = std::max(maxSurfaceHeight, heights[z * heightsStride + x]);
+		}
+	}
+	if (static_cast<float>(origin.y + min.y) > TerrainGenerator::getAirHeight(maxSurfaceHeight)) {
+		nodes[index] = { OCTREE_LEAF, OCTREE_UNIFORM, 0.0f, AIR_MATERIAL };
+		return;
+	}
+
+	if (level == 0) {
+		std::vector<float> densities;
+		std::vector<unsigned char> materials;
+		terrainGenerator->generateBlock(origin.x + min.x, origin.y + min.y, origin.z + min.z, BRICK_SAMPLES, &heights[min.z * heightsStride + min.x], heightsStride, densities, materials);
+
+		bool uniform = true;
+		for (unsigned int i = 1; i < BRICK_SAMPLE_COUNT && uniform; i++) {
+			uniform = densities[i] == densities[0] && materials[i] == materials[0];
+		}
+		if (uniform) {
+			nodes[index] = { OCTREE_LEAF, OCTREE_UNIFORM, densities[0], materials[0] };
+			return;
+		}
+
+		nodes[index] = { OCTREE_LEAF, static_cast<uint32_t>(brickDensities.size() / BRICK_SAMPLE_COUNT), 0.0f, 0 };
+		brickDensities.insert(brickDensities.end(), densities.begin(), densities.end());
+		brickMaterials.insert(brickMaterials.end(), materials.begin(), materials.end());
+		return;
+	}
+
+	const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+	nodes.resize(firstChild + 8);
+	for (unsigned int child = 0; child < 8; child++) {
+		buildNode(terrainGenerator, heights, firstChild + child, min + getChildOffset(child) * static_cast<int>(cells / 2), level - 1);
+	}
+
+	// Children that are all the same single value merge back. They have no descendants, so they are the last nodes
+	const OctreeNode& first = nodes[firstChild];
+	bool uniform = true;
+	for (unsigned int child = 0; child < 8 && uniform; child++) {
+		const OctreeNode& node = nodes[firstChild + child];
+		uniform = isUniformLeaf(node) && node.density == first.density && node.material == first.material;
+	}
+	if (uniform) {
+		nodes[index] = first;
+		nodes.resize(firstChild);
+		return;
+	}
+
+	nodes[index] = { firstChild, OCTREE_UNIFORM, 0.0f, 0 };
+}
+
+void VoxelOctree::sample(const glm::ivec3& worldSample, float& density, unsigned int& material) const {
+	const glm::ivec3 local = worldSample - origin;
+
+	uint32_t index = 0;
+	glm::ivec3 min(0, 0, 0);
+	unsigned int level = OCTREE_LEVELS - 1;
+	while (nodes[index].children != OCTREE_LEAF) {
+		// Samples on the face between two children are in both, either one has the same value
+		const int half = static_cast<int>(BRICK_CELLS << (level - 1));
+		const unsigned int child = (local.x >= min.x + half ? 1 : 0) | (local.y >= min.y + half ? 2 : 0) | (local.z >= min.z + half ? 4 : 0);
+
+		min = min + getChildOffset(child) * half;
+		index = nodes[index].children + child;
+		level--;
+	}
+
+	const OctreeNode& node = nodes[index];
+	if (node.brick == OCTREE_UNIFORM) {
+		density = node.density;
+		material = node.material;
+		return;
+	}
+
+	const glm::ivec3 brickSample = local - min;
+	const size_t sampleIndex = static_cast<size_t>(node.brick) * BRICK_SAMPLE_COUNT + brickSampleIndex(brickSample.x, brickSample.y, brickSample.z);
+	density = brickDensities[sampleIndex];
+	material = brickMaterials[sampleIndex];
+}
+
+void VoxelOctree::selectLod(const glm::vec3& viewer, const float lodDistance, std::vector<OctreeLodNode>& selected) const {
+	selectNode(viewer, lodDistance, 0, glm::ivec3(0, 0, 0), OCTREE_LEVELS - 1, selected);
+}
+
+void VoxelOctree::selectNode(const glm::vec3& viewer, const float lodDistance, const uint32_t index, const glm::ivec3& min, const unsigned int level, std::vector<OctreeLodNode>& selected) const {
+	const OctreeNode& node = nodes[index];
+	// A single value has no surface in any of its cells
+	if (isUniformLeaf(node)) return;
+
+	const unsigned int cells = BRICK_CELLS << level;
+	const glm::vec3 boxMin = glm::vec3(origin + min);
+	const glm::vec3 boxMax = boxMin + glm::vec3(static_cast<float>(cells));
+	const glm::vec3 closest = glm::clamp(viewer, boxMin, boxMax);
+	const float distance = glm::length(viewer - closest);
+
+	if (node.children == OCTREE_LEAF || distance >= lodDistance * static_cast<float>(cells)) {
+		selected.push_back({ origin + min, level, index });
+		return;
+	}
+
+	for (unsigned int child = 0; child < 8; child++) {
+		selectNode(viewer, lodDistance, node.children + child, min + getChildOffset(child) * static_cast<int>(cells / 2), level - 1, selected);
+	}
+}
+
+void VoxelOctree::extractBrick(const OctreeLodNode& lodNode, std::vector<float>& densities, std::vector<unsigned int>& materials) const {
+	densities.resize(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES);
+	materials.resize(CHUNK_SAMPLES * CHUNK_SAMPLES * CHUNK_SAMPLES);
+
+	const OctreeNode& node = nodes[lodNode.node];
+	const int step = 1 << lodNode.level;
+	for (unsigned int y = 0; y < BRICK_SAMPLES; y++) {
+		for (unsigned int x = 0; x < BRICK_SAMPLES; x++) {
+			for (unsigned int z = 0; z < BRICK_SAMPLES; z++) {
+				float density;
+				unsigned int material;
+				if (node.children == OCTREE_LEAF && node.brick != OCTREE_UNIFORM) {
+					const size_t index = static_cast<size_t>(node.brick) * BRICK_SAMPLE_COUNT + brickSampleIndex(x, y, z);
+					density = brickDensities[index];
+					material = brickMaterials[index];
+				}
+				else {
+					// Coarser levels take every other sample of the level below
+					sample(lodNode.origin + glm::ivec3(x, y, z) * step, density, material);
+				}
+
+				densities[sampleIndex(x, y, z)] = density;
+				materials[sampleIndex(x, y, z)] = material;
+			}
+		}
+	}
+}
+
+std::vector<float> VoxelOctree::meshNode(MarchingCubeGenerator* meshGenerator, const OctreeLodNode& node) const {
+	std::vector<float> densities;
+	std::vector<unsigned int> materials;
+	extractBrick(node, densities, materials);
+
+	std::vector<float> vertices;
+	std::vector<unsigned int> cellVertexCounts;
+	meshGenerator->generateCells(densities, materials, glm::ivec3(0, 0, 0), glm::ivec3(BRICK_CELLS), vertices, cellVertexCounts);
+
+	const float step = static_cast<float>(1 << node.level);
+	for (size_t i = 0; i < vertices.size(); i += N_TERRAIN_VA) {
+		vertices[i] *= step;
+		vertices[i + 1] *= step;
+		vertices[i + 2] *= step;
+	}
+	return vertices;
+}
+
+size_t VoxelOctree::getMemoryUsage() const {
+	return sizeof(VoxelOctree)
+		+ nodes.capacity() * sizeof(OctreeNode)
+		+ brickDensities.capacity() * sizeof(float)
+		+ brickMaterials.capacity() * sizeof(unsigned char);
+}
+
+unsigned int VoxelOctree::getNodeCount() const {
+	return static_cast<unsigned int>(nodes.size());
+}
+
+unsigned int VoxelOctree::getBrickCount() const {
+	return static_cast<unsigned int>(brickDensities.size() / BRICK_SAMPLE_COUNT);
+}
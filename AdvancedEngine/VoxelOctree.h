@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "TerrainGenerator.h"
+#include "MarchingCubesGenerator.h"
+
+constexpr unsigned int BRICK_CELLS = 8;
+constexpr unsigned int BRICK_SAMPLES = BRICK_CELLS + 1; // Including the border shared with the next brick
+constexpr unsigned int OCTREE_LEVELS = 4; // Bricks are level 0, the root is level 3
+constexpr unsigned int OCTREE_ROOT_CELLS = BRICK_CELLS << (OCTREE_LEVELS - 1);
+
+constexpr uint32_t OCTREE_LEAF = UINT32_MAX;
+constexpr uint32_t OCTREE_UNIFORM = UINT32_MAX;
+
+struct OctreeNode {
+	uint32_t children; // Index of the first of the 8 children in nodes, x is bit 0, y bit 1, z bit 2. OCTREE_LEAF for leaves
+	uint32_t brick; // Leaves: index of the brick, OCTREE_UNIFORM when every sample of the node is density and material
+	float density;
+	uint32_t material;
+};
+
+// A node picked by selectLod(), meshed on its own at its level's sample spacing
+struct OctreeLodNode {
+	glm::ivec3 origin; // World position of the node's first sample
+	unsigned int level; // Samples are 1 << level apart
+	uint32_t node;
+};
+
+/*
+The terrain of a 64x64x64 cube stored as an octree instead of a grid: nodes whose samples all have the same
+density and material are a single leaf, the others split down to 8x8x8 cell bricks of samples.
+
+It is built top down from the TerrainGenerator. The heightmap of the whole cube is generated first, and a node
+entirely above the surface of its columns is air without sampling the caves. Bricks that still turn out to be
+a single value, and parents whose 8 children are the same single value, collapse after the fact. Samples are
+exactly those of generateTerrain, so a mesh of the bricks matches the chunk meshes.
+
+Neighbouring nodes meshed at different levels are not stitched.
+*/
+class VoxelOctree {
+public:
+	VoxelOctree(TerrainGenerator* terrainGenerator, const glm::ivec3& rootPosition); // In units of OCTREE_ROOT_CELLS
+
+	void sample(const glm::ivec3& worldSample, float& density, unsigned int& material) const; // The sample has to be inside the root
+
+	// Nodes that contain surface, as coarse as possible while their size is below distance / lodDistance from the viewer
+	void selectLod(const glm::vec3& viewer, const float lodDistance, std::vector<OctreeLodNode>& selected) const;
+
+	// The node's samples at its level, written to the first BRICK_SAMPLES per axis of chunk sized grids
+	void extractBrick(const OctreeLodNode& node, std::vector<float>& densities, std::vector<unsigned int>& materials) const;
+	std::vector<float> meshNode(MarchingCubeGenerator* meshGenerator, const OctreeLodNode& node) const; // Positions relative to node.origin
+
+	size_t getMemoryUsage() const;
+	unsigned int getNodeCount() const;
+	unsigned int getBrickCount() const;
+
+	glm::ivec3 origin;
+
+private:
+	void buildNode(TerrainGenerator* terrainGenerator, const std::vector<float>& heights, const uint32_t index, const glm::ivec3& min, const unsigned int level);
+	void selectNode(const glm::vec3& viewer, const float lodDistance, const uint32_t index, const glm::ivec3& min, const unsigned int level, std::vector<OctreeLodNode>& selected) const;
+
+	std::vector<OctreeNode> nodes; // The root is nodes[0]
+	std::vector<float> brickDensities; // BRICK_SAMPLES^3 per brick, in the chunk sample layout
+	std::vector<unsigned char> brickMaterials;
+};
@@ -0,0 +1,614 @@
+#include "VoxelQueries.h"
+#include "Settings.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+const unsigned int RAYS_PER_TASK = 256; // Batches go to the workers in tasks of this many rays
+const unsigned int SWEEPS_PER_TASK = 16;
+const unsigned int ROOT_ITERATIONS = 24; // Bisection steps, roots are found to a cell / 2^24
+const unsigned int SEARCH_ITERATIONS = 32; // Golden section steps for the closest approach of a sweep to a box
+const unsigned int SWEEP_SUBDIVISIONS = 4; // Partly solid cells are split down to 1/16 of a cell for sweeps
+
+const float VoxelQueries::SWEEP_TOLERANCE = std::sqrt(3.0f) / (1 << SWEEP_SUBDIVISIONS);
+
+const uint64_t NO_CHUNK = ~0ull;
+const VoxelHit MISS = { -1.0f, glm::vec3(0.0f), glm::vec3(0.0f) };
+
+// Floor division, cell -1 is in chunk -1 and not chunk 0
+static int floorDivide(const int value, const int divisor) {
+	return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+// Corners are indexed x + 2y + 4z
+static float getMaxCorner(const float* corners) {
+	float maxValue = corners[0];
+	for (unsigned int corner = 1; corner < 8; corner++) {
+		maxValue = std::max(maxValue, corners[corner]);
+	}
+	return maxValue;
+}
+
+static float trilinear(const float* corners, const glm::vec3& p) {
+	const float bottom = (corners[0] * (1 - p.x) + corners[1] * p.x) * (1 - p.y) + (corners[2] * (1 - p.x) + corners[3] * p.x) * p.y;
+	const float top = (corners[4] * (1 - p.x) + corners[5] * p.x) * (1 - p.y) + (corners[6] * (1 - p.x) + corners[7] * p.x) * p.y;
+	return bottom * (1 - p.z) + top * p.z;
+}
+
+static glm::vec3 getCellGradient(const float* c, const glm::vec3& p) {
+	const float u = p.x;
+	const float v = p.y;
+	const float w = p.z;
+	return glm::vec3(
+		(1 - v) * (1 - w) * (c[1] - c[0]) + v * (1 - w) * (c[3] - c[2]) + (1 - v) * w * (c[5] - c[4]) + v * w * (c[7] - c[6]),
+		(1 - u) * (1 - w) * (c[2] - c[0]) + u * (1 - w) * (c[3] - c[1]) + (1 - u) * w * (c[6] - c[4]) + u * w * (c[7] - c[5]),
+		(1 - u) * (1 - v) * (c[4] - c[0]) + u * (1 - v) * (c[5] - c[1]) + (1 - u) * v * (c[6] - c[2]) + u * v * (c[7] - c[3])
+	);
+}
+
+// The field along a segment of a cell starting at a, as a cubic in the distance s travelled along d.
+// Each corner's weight is a product of three factors linear in s: u or 1 - u, v or 1 - v, w or 1 - w
+static void getCellCubic(const float* corners, const glm::vec3& a, const glm::vec3& d, float* coefficients) {
+	coefficients[0] = coefficients[1] = coefficients[2] = coefficients[3] = 0.0f;
+
+	for (unsigned int corner = 0; corner < 8; corner++) {
+		const float x0 = (corner & 1) ? a.x : 1 - a.x;
+		const float x1 = (corner & 1) ? d.x : -d.x;
+		const float y0 = (corner & 2) ? a.y : 1 - a.y;
+		const float y1 = (corner & 2) ? d.y : -d.y;
+		const float z0 = (corner & 4) ? a.z : 1 - a.z;
+		const float z1 = (corner & 4) ? d.z : -d.z;
+
+		const float q0 = x0 * y0;
+		const float q1 = x0 * y1 + x1 * y0;
+		const float q2 = x1 * y1;
+
+		coefficients[0] += corners[corner] * q0 * z0;
+		coefficients[1] += corners[corner] * (q0 * z1 + q1 * z0);
+		coefficients[2] += corners[corner] * (q1 * z1 + q2 * z0);
+		coefficients[3] += corners[corner] * q2 * z1;
+	}
+}
+
+static float evaluateCubic(const float* c, const float s) {
+	return ((c[3] * s + c[2]) * s + c[1]) * s + c[0];
+}
+
+// First s in [0, length] where the cubic becomes >= 0. It is monotonic between its turning points,
+// so each piece has at most one crossing, found by bisection
+static bool findFirstRoot(const float* c, const float length, float& outS) {
+	float splits[4];
+	unsigned int splitCount = 0;
+
+	// Turning points: roots of 3 c3 s^2 + 2 c2 s + c1
+	const float a = 3 * c[3];
+	const float b = 2 * c[2];
+	if (std::fabs(a) > 1e-12f) {
+		const float discriminant = b * b - 4 * a * c[1];
+		if (discriminant >= 0) {
+			const float root = std::sqrt(discriminant);
+			float s0 = (-b - root) / (2 * a);
+			float s1 = (-b + root) / (2 * a);
+			if (s0 > s1) std::swap(s0, s1);
+			if (s0 > 0 && s0 < length) splits[splitCount++] = s0;
+			if (s1 > 0 && s1 < length) splits[splitCount++] = s1;
+		}
+	}
+	else if (std::fabs(b) > 1e-12f) {
+		const float s0 = -c[1] / b;
+		if (s0 > 0 && s0 < length) splits[splitCount++] = s0;
+	}
+	splits[splitCount++] = length;
+
+	float start = 0.0f;
+	if (evaluateCubic(c, start) >= 0) {
+		outS = 0.0f;
+		return true;
+	}
+
+	for (unsigned int i = 0; i < splitCount; i++) {
+		const float end = splits[i];
+		if (evaluateCubic(c, end) >= 0) {
+			float low = start;
+			float high = end;
+			for (unsigned int iteration = 0; iteration < ROOT_ITERATIONS; iteration++) {
+				const float middle = (low + high) * 0.5f;
+				if (evaluateCubic(c, middle) >= 0) {
+					high = middle;
+				}
+				else {
+					low = middle;
+				}
+			}
+			outS = high;
+			return true;
+		}
+		start = end;
+	}
+	return false;
+}
+
+// DDA state of one ray: the cell it is in and the distances at which it crosses the next cell boundary on each axis
+struct RayWalk {
+	glm::ivec3 cell;
+	glm::ivec3 step;
+	glm::vec3 tMax;
+	glm::vec3 tDelta;
+	float t;
+};
+
+static void beginWalk(const VoxelRay& ray, RayWalk& walk) {
+	const float infinity = std::numeric_limits<float>::infinity();
+	walk.cell = glm::ivec3(glm::floor(ray.origin));
+	walk.t = 0.0f;
+
+	for (int axis = 0; axis < 3; axis++) {
+		const float direction = ray.direction[axis];
+		if (direction > 0) {
+			walk.step[axis] = 1;
+			walk.tMax[axis] = (walk.cell[axis] + 1 - ray.origin[axis]) / direction;
+			walk.tDelta[axis] = 1 / direction;
+		}
+		else if (direction < 0) {
+			walk.step[axis] = -1;
+			walk.tMax[axis] = (walk.cell[axis] - ray.origin[axis]) / direction;
+			walk.tDelta[axis] = -1 / direction;
+		}
+		else {
+			walk.step[axis] = 0;
+			walk.tMax[axis] = infinity;
+			walk.tDelta[axis] = infinity;
+		}
+	}
+}
+
+// The axis whose boundary comes first, ties go to x then y in both the scalar and the AVX2 walks
+static int getNextAxis(const glm::vec3& tMax) {
+	if (tMax.x <= tMax.y && tMax.x <= tMax.z) return 0;
+	return tMax.y <= tMax.z ? 1 : 2;
+}
+
+VoxelQueries::VoxelQueries(const float isoLevel) : isoLevel(isoLevel) {
+
+}
+
+void VoxelQueries::setChunk(const glm::ivec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels) {
+	if (voxels == nullptr) {
+		chunks.erase(packChunkPosition(chunkPosition));
+	}
+	else {
+		chunks[packChunkPosition(chunkPosition)] = voxels;
+	}
+}
+
+unsigned int VoxelQueries::getChunkCount() const {
+	return chunks.size();
+}
+
+bool VoxelQueries::loadCell(const glm::ivec3& cell, ChunkCache& cache, float* corners) const {
+	const glm::ivec3 chunk(floorDivide(cell.x, CHUNK_SIZE), floorDivide(cell.y, CHUNK_SIZE), floorDivide(cell.z, CHUNK_SIZE));
+	const uint64_t key = packChunkPosition(chunk);
+	if (key != cache.key) {
+		const auto found = chunks.find(key);
+		cache.key = key;
+		cache.densities = found != chunks.end() ? found->second->densities.data() : nullptr;
+	}
+	if (cache.densities == nullptr) return false;
+
+	// Cells are [0, CHUNK_SIZE) in their chunk, so their far corners are still in its grid
+	const glm::ivec3 local = cell - chunk * static_cast<int>(CHUNK_SIZE);
+	for (unsigned int corner = 0; corner < 8; corner++) {
+		corners[corner] = cache.densities[sampleIndex(local.x + (corner & 1), local.y + ((corner >> 1) & 1), local.z + (corner >> 2))];
+	}
+	return true;
+}
+
+bool VoxelQueries::hitCell(const VoxelRay& ray, const glm::ivec3& cell, const float* corners, const float tEnter, const float tExit, VoxelHit& hit) const {
+	const glm::vec3 entry = glm::clamp(ray.origin + ray.direction * tEnter - glm::vec3(cell), glm::vec3(0.0f), glm::vec3(1.0f));
+
+	float coefficients[4];
+	getCellCubic(corners, entry, ray.direction, coefficients);
+	coefficients[0] -= isoLevel;
+
+	float s;
+	if (!findFirstRoot(coefficients, tExit - tEnter, s)) return false;
+
+	const glm::vec3 local = glm::clamp(entry + ray.direction * s, glm::vec3(0.0f), glm::vec3(1.0f));
+	const glm::vec3 gradient = getCellGradient(corners, local);
+	const float gradientLength = glm::length(gradient);
+
+	hit.distance = tEnter + s;
+	hit.position = glm::vec3(cell) + local;
+	hit.normal = gradientLength > 1e-6f ? gradient * (-1.0f / gradientLength) : ray.direction * -1.0f;
+	return true;
+}
+
+VoxelHit VoxelQueries::raycast(const VoxelRay& ray) const {
+	RayWalk walk;
+	beginWalk(ray, walk);
+
+	ChunkCache cache = { NO_CHUNK, nullptr };
+	float corners[8];
+	VoxelHit hit = MISS;
+
+	while (walk.t <= ray.maxDistance) {
+		const int axis = getNextAxis(walk.tMax);
+		const float tExit = std::min(walk.tMax[axis], ray.maxDistance);
+
+		if (loadCell(walk.cell, cache, corners) && getMaxCorner(corners) >= isoLevel && hitCell(ray, walk.cell, corners, walk.t, tExit, hit)) {
+			return hit;
+		}
+
+		walk.t = walk.tMax[axis];
+		walk.cell[axis] += walk.step[axis];
+		walk.tMax[axis] += walk.tDelta[axis];
+	}
+	return MISS;
+}
+
+void VoxelQueries::raycastPacket(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const {
+#ifdef __AVX2__
+	// The walks of 8 rays side by side, every iteration moves each of them to its next cell
+	alignas(32) float tMaxX[8], tMaxY[8], tMaxZ[8];
+	alignas(32) float tDeltaX[8], tDeltaY[8], tDeltaZ[8];
+	alignas(32) float t[8], maxDistance[8], tNext[8];
+	alignas(32) int cellX[8], cellY[8], cellZ[8];
+	alignas(32) int stepX[8], stepY[8], stepZ[8];
+	alignas(32) int chunkX[8], chunkY[8], chunkZ[8];
+	alignas(32) int64_t chunkAddress[8]; // Of each lane's chunk densities, 0 when it isn't loaded
+
+	unsigned int active = 0;
+	for (unsigned int lane = 0; lane < 8; lane++) {
+		RayWalk walk;
+		if (lane < count) {
+			beginWalk(rays[lane], walk);
+			hits[lane] = MISS;
+			maxDistance[lane] = rays[lane].maxDistance;
+			if (walk.t <= maxDistance[lane]) active |= 1u << lane;
+		}
+		else {
+			// Padding, never active
+			beginWalk({ glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), 0.0f }, walk);
+			maxDistance[lane] = -1.0f;
+		}
+
+		tMaxX[lane] = walk.tMax.x;
+		tMaxY[lane] = walk.tMax.y;
+		tMaxZ[lane] = walk.tMax.z;
+		tDeltaX[lane] = walk.tDelta.x;
+		tDeltaY[lane] = walk.tDelta.y;
+		tDeltaZ[lane] = walk.tDelta.z;
+		t[lane] = walk.t;
+		cellX[lane] = walk.cell.x;
+		cellY[lane] = walk.cell.y;
+		cellZ[lane] = walk.cell.z;
+		stepX[lane] = walk.step.x;
+		stepY[lane] = walk.step.y;
+		stepZ[lane] = walk.step.z;
+		chunkX[lane] = chunkY[lane] = chunkZ[lane] = std::numeric_limits<int>::min();
+		chunkAddress[lane] = 0;
+	}
+
+	const __m256 iso = _mm256_set1_ps(isoLevel);
+	const __m256 inverseChunkSize = _mm256_set1_ps(1.0f / CHUNK_SIZE);
+	const __m256i chunkSize = _mm256_set1_epi32(CHUNK_SIZE);
+	// sampleIndex() offsets of the corners from corner 0
+	const int cornerOffsets[8] = { 0, CHUNK_SAMPLES, CHUNK_SAMPLES * CHUNK_SAMPLES, CHUNK_SAMPLES + CHUNK_SAMPLES * CHUNK_SAMPLES, 1, 1 + CHUNK_SAMPLES, 1 + CHUNK_SAMPLES * CHUNK_SAMPLES, 1 + CHUNK_SAMPLES + CHUNK_SAMPLES * CHUNK_SAMPLES };
+
+	while (active != 0) {
+		// Chunk of each lane's cell as floor((cell + 0.5) / CHUNK_SIZE), the same as floorDivide() within millions of cells of the origin
+		const __m256i cellsX = _mm256_load_si256(reinterpret_cast<const __m256i*>(cellX));
+		const __m256i cellsY = _mm256_load_si256(reinterpret_cast<const __m256i*>(cellY));
+		const __m256i cellsZ = _mm256_load_si256(reinterpret_cast<const __m256i*>(cellZ));
+		const auto toChunk = [&](const __m256i cells) {
+			return _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(cells), _mm256_set1_ps(0.5f)), inverseChunkSize)));
+		};
+		const __m256i chunksX = toChunk(cellsX);
+		const __m256i chunksY = toChunk(cellsY);
+		const __m256i chunksZ = toChunk(cellsZ);
+
+		// Lanes that walked into another chunk look it up, the others keep theirs
+		const __m256i sameChunk = _mm256_and_si256(_mm256_and_si256(
+			_mm256_cmpeq_epi32(chunksX, _mm256_load_si256(reinterpret_cast<const __m256i*>(chunkX))),
+			_mm256_cmpeq_epi32(chunksY, _mm256_load_si256(reinterpret_cast<const __m256i*>(chunkY)))),
+			_mm256_cmpeq_epi32(chunksZ, _mm256_load_si256(reinterpret_cast<const __m256i*>(chunkZ))));
+		unsigned int changed = ~_mm256_movemask_ps(_mm256_castsi256_ps(sameChunk)) & active;
+		if (changed != 0) {
+			_mm256_store_si256(reinterpret_cast<__m256i*>(chunkX), chunksX);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(chunkY), chunksY);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(chunkZ), chunksZ);
+			for (unsigned int lane = 0; lane < 8; lane++) {
+				if (!(changed & (1u << lane))) continue;
+				const auto found = chunks.find(packChunkPosition(glm::ivec3(chunkX[lane], chunkY[lane], chunkZ[lane])));
+				chunkAddress[lane] = found != chunks.end() ? reinterpret_cast<int64_t>(found->second->densities.data()) : 0;
+			}
+		}
+
+		unsigned int loaded = active;
+		for (unsigned int lane = 0; lane < 8; lane++) {
+			if (chunkAddress[lane] == 0) loaded &= ~(1u << lane);
+		}
+
+		// Corners of each lane's cell gathered straight from the chunk grids, missing chunks are air
+		const __m256i localX = _mm256_sub_epi32(cellsX, _mm256_mullo_epi32(chunksX, chunkSize));
+		const __m256i localY = _mm256_sub_epi32(cellsY, _mm256_mullo_epi32(chunksY, chunkSize));
+		const __m256i localZ = _mm256_sub_epi32(cellsZ, _mm256_mullo_epi32(chunksZ, chunkSize));
+		const __m256i baseIndex = _mm256_add_epi32(_mm256_add_epi32(localZ, _mm256_mullo_epi32(localX, _mm256_set1_epi32(CHUNK_SAMPLES))), _mm256_mullo_epi32(localY, _mm256_set1_epi32(CHUNK_SAMPLES * CHUNK_SAMPLES)));
+
+		const __m256i loadedMask = _mm256_cmpgt_epi32(_mm256_and_si256(_mm256_set1_epi32(loaded), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), _mm256_setzero_si256());
+		const __m128 lowMask = _mm_castsi128_ps(_mm256_castsi256_si128(loadedMask));
+		const __m128 highMask = _mm_castsi128_ps(_mm256_extracti128_si256(loadedMask, 1));
+		const __m256i lowAddresses = _mm256_load_si256(reinterpret_cast<const __m256i*>(chunkAddress));
+		const __m256i highAddresses = _mm256_load_si256(reinterpret_cast<const __m256i*>(chunkAddress + 4));
+
+		__m256 corners[8];
+		__m256 maxCorner = _mm256_setzero_ps();
+		for (unsigned int corner = 0; corner < 8; corner++) {
+			const __m256i index = _mm256_slli_epi32(_mm256_add_epi32(baseIndex, _mm256_set1_epi32(cornerOffsets[corner])), 2);
+			const __m256i lowIndex = _mm256_add_epi64(lowAddresses, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(index)));
+			const __m256i highIndex = _mm256_add_epi64(highAddresses, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(index, 1)));
+			const __m128 low = _mm256_mask_i64gather_ps(_mm_setzero_ps(), nullptr, lowIndex, lowMask, 1);
+			const __m128 high = _mm256_mask_i64gather_ps(_mm_setzero_ps(), nullptr, highIndex, highMask, 1);
+			corners[corner] = _mm256_set_m128(high, low);
+			maxCorner = corner == 0 ? corners[0] : _mm256_max_ps(maxCorner, corners[corner]);
+		}
+		const unsigned int candidates = _mm256_movemask_ps(_mm256_cmp_ps(maxCorner, iso, _CMP_GE_OQ)) & loaded;
+
+		// Same axis choice as getNextAxis
+		const __m256 x = _mm256_load_ps(tMaxX);
+		const __m256 y = _mm256_load_ps(tMaxY);
+		const __m256 z = _mm256_load_ps(tMaxZ);
+		const __m256 stepOnX = _mm256_and_ps(_mm256_cmp_ps(x, y, _CMP_LE_OQ), _mm256_cmp_ps(x, z, _CMP_LE_OQ));
+		const __m256 stepOnY = _mm256_andnot_ps(stepOnX, _mm256_cmp_ps(y, z, _CMP_LE_OQ));
+		const __m256 stepOnZ = _mm256_andnot_ps(_mm256_or_ps(stepOnX, stepOnY), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+		const __m256 next = _mm256_blendv_ps(_mm256_blendv_ps(z, y, stepOnY), x, stepOnX);
+		_mm256_store_ps(tNext, next);
+
+		// Surface solving is rare and branchy, one lane at a time
+		for (unsigned int lane = 0; lane < 8; lane++) {
+			if (!(candidates & (1u << lane))) continue;
+
+			float laneCorners[8];
+			for (unsigned int corner = 0; corner < 8; corner++) {
+				alignas(32) float values[8];
+				_mm256_store_ps(values, corners[corner]);
+				laneCorners[corner] = values[lane];
+			}
+			const float tExit = std::min(tNext[lane], maxDistance[lane]);
+			if (hitCell(rays[lane], glm::ivec3(cellX[lane], cellY[lane], cellZ[lane]), laneCorners, t[lane], tExit, hits[lane])) {
+				active &= ~(1u << lane);
+			}
+		}
+
+		_mm256_store_ps(t, next);
+		_mm256_store_ps(tMaxX, _mm256_add_ps(x, _mm256_and_ps(_mm256_load_ps(tDeltaX), stepOnX)));
+		_mm256_store_ps(tMaxY, _mm256_add_ps(y, _mm256_and_ps(_mm256_load_ps(tDeltaY), stepOnY)));
+		_mm256_store_ps(tMaxZ, _mm256_add_ps(z, _mm256_and_ps(_mm256_load_ps(tDeltaZ), stepOnZ)));
+		_mm256_store_si256(reinterpret_cast<__m256i*>(cellX), _mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(cellX)), _mm256_and_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(stepX)), _mm256_castps_si256(stepOnX))));
+		_mm256_store_si256(reinterpret_cast<__m256i*>(cellY), _mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(cellY)), _mm256_and_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(stepY)), _mm256_castps_si256(stepOnY))));
+		_mm256_store_si256(reinterpret_cast<__m256i*>(cellZ), _mm256_add_epi32(_mm256_load_si256(reinterpret_cast<const __m256i*>(cellZ)), _mm256_and_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(stepZ)), _mm256_castps_si256(stepOnZ))));
+
+		active &= _mm256_movemask_ps(_mm256_cmp_ps(next, _mm256_load_ps(maxDistance), _CMP_LE_OQ));
+	}
+#else
+	for (unsigned int lane = 0; lane < count; lane++) {
+		hits[lane] = raycast(rays[lane]);
+	}
+#endif
+}
+
+void VoxelQueries::raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const {
+	for (unsigned int first = 0; first < count; first += 8) {
+		raycastPacket(rays + first, hits + first, std::min(8u, count - first));
+	}
+}
+
+void VoxelQueries::raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, WorkerPool* workerPool) const {
+	const unsigned int tasks = (count + RAYS_PER_TASK - 1) / RAYS_PER_TASK;
+	workerPool->parallelFor(tasks, [this, rays, hits, count](const unsigned int task) {
+		const unsigned int first = task * RAYS_PER_TASK;
+		raycast(rays + first, hits + first, std::min(RAYS_PER_TASK, count - first));
+	});
+}
+
+// Ray against a box, entry and exit distances clamped to the ray's start
+static bool intersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boxMin, const glm::vec3& boxMax, float& tEnter, float& tExit) {
+	const glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+	const glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+	const glm::vec3 tNear = glm::min(t0, t1);
+	const glm::vec3 tFar = glm::max(t0, t1);
+
+	tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	tExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	return tEnter <= tExit;
+}
+
+static float getBoxDistance(const glm::vec3& position, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+	return glm::length(position - glm::clamp(position, boxMin, boxMax));
+}
+
+struct SweepState {
+	const VoxelRay* ray;
+	glm::vec3 inverseDirection;
+	float radius;
+	float isoLevel;
+
+	float best; // Earliest contact so far, starts at the ray's max distance
+	bool hit;
+	glm::vec3 contactBoxMin;
+	glm::vec3 contactBoxMax;
+};
+
+// The distance to a box along the sweep is convex, its minimum is found first and the contact is then before it
+static void sweepSolidBox(SweepState& sweep, const glm::vec3& boxMin, const glm::vec3& boxMax, float tStart, float tEnd) {
+	const VoxelRay& ray = *sweep.ray;
+	const auto gap = [&](const float t) {
+		return getBoxDistance(ray.origin + ray.direction * t, boxMin, boxMax) - sweep.radius;
+	};
+
+	float contact;
+	if (gap(tStart) <= 0) {
+		contact = tStart;
+	}
+	else {
+		const float ratio = 0.618034f;
+		float low = tStart;
+		float high = tEnd;
+		for (unsigned int iteration = 0; iteration < SEARCH_ITERATIONS; iteration++) {
+			const float a = high - (high - low) * ratio;
+			const float b = low + (high - low) * ratio;
+			if (gap(a) <= gap(b)) {
+				high = b;
+			}
+			else {
+				low = a;
+			}
+		}
+		const float closest = (low + high) * 0.5f;
+		if (gap(closest) > 0) return;
+
+		low = tStart;
+		high = closest;
+		for (unsigned int iteration = 0; iteration < ROOT_ITERATIONS; iteration++) {
+			const float middle = (low + high) * 0.5f;
+			if (gap(middle) <= 0) {
+				high = middle;
+			}
+			else {
+				low = middle;
+			}
+		}
+		contact = high;
+	}
+
+	if (contact < sweep.best) {
+		sweep.best = contact;
+		sweep.hit = true;
+		sweep.contactBoxMin = boxMin;
+		sweep.contactBoxMax = boxMax;
+	}
+}
+
+// values are the field at the box's corners, inside the box it stays between their min and max
+static void sweepCellBox(SweepState& sweep, const float* values, const glm::vec3& boxMin, const float boxSize, const unsigned int depth) {
+	float minValue = values[0];
+	float maxValue = values[0];
+	for (unsigned int corner = 1; corner < 8; corner++) {
+		minValue = std::min(minValue, values[corner]);
+		maxValue = std::max(maxValue, values[corner]);
+	}
+	if (maxValue < sweep.isoLevel) return;
+
+	// Earliest the sphere can touch the box: the ray against the box grown by the radius
+	const glm::vec3 boxMax = boxMin + glm::vec3(boxSize);
+	float tEnter, tExit;
+	if (!intersectBox(sweep.ray->origin, sweep.inverseDirection, boxMin - glm::vec3(sweep.radius), boxMax + glm::vec3(sweep.radius), tEnter, tExit)) return;
+	if (tEnter > sweep.best) return;
+
+	// Fully solid, or as small as boxes get
+	if (minValue >= sweep.isoLevel || depth == SWEEP_SUBDIVISIONS) {
+		sweepSolidBox(sweep, boxMin, boxMax, tEnter, std::min(tExit, sweep.best));
+		return;
+	}
+
+	// The field at the 27 corners of the 8 children
+	float grid[27];
+	for (unsigned int z = 0; z < 3; z++) {
+		for (unsigned int y = 0; y < 3; y++) {
+			for (unsigned int x = 0; x < 3; x++) {
+				grid[x + y * 3 + z * 9] = trilinear(values, glm::vec3(x, y, z) * 0.5f);
+			}
+		}
+	}
+
+	const float half = boxSize * 0.5f;
+	for (unsigned int child = 0; child < 8; child++) {
+		const unsigned int childX = child & 1;
+		const unsigned int childY = (child >> 1) & 1;
+		const unsigned int childZ = child >> 2;
+
+		float childValues[8];
+		for (unsigned int corner = 0; corner < 8; corner++) {
+			childValues[corner] = grid[(childX + (corner & 1)) + (childY + ((corner >> 1) & 1)) * 3 + (childZ + (corner >> 2)) * 9];
+		}
+		sweepCellBox(sweep, childValues, boxMin + glm::vec3(childX, childY, childZ) * half, half, depth + 1);
+	}
+}
+
+VoxelHit VoxelQueries::sphereSweep(const VoxelRay& ray, const float radius) const {
+	SweepState sweep;
+	sweep.ray = &ray;
+	for (int axis = 0; axis < 3; axis++) {
+		// No infinities, 0 * infinity would be NaN for boxes touching the origin
+		const float direction = ray.direction[axis];
+		sweep.inverseDirection[axis] = 1.0f / (std::fabs(direction) > 1e-20f ? direction : 1e-20f);
+	}
+	sweep.radius = radius;
+	sweep.isoLevel = isoLevel;
+	sweep.best = ray.maxDistance;
+	sweep.hit = false;
+
+	// While the center is in a cell, the sphere can only touch the cells this close to it
+	const int reach = static_cast<int>(std::ceil(radius));
+
+	RayWalk walk;
+	beginWalk(ray, walk);
+
+	ChunkCache cache = { NO_CHUNK, nullptr };
+	float corners[8];
+	bool hasPrevious = false;
+	glm::ivec3 previousCell;
+
+	while (walk.t <= sweep.best) {
+		for (int y = walk.cell.y - reach; y <= walk.cell.y + reach; y++) {
+			for (int x = walk.cell.x - reach; x <= walk.cell.x + reach; x++) {
+				for (int z = walk.cell.z - reach; z <= walk.cell.z + reach; z++) {
+					const glm::ivec3 cell(x, y, z);
+
+					// Already tested around the previous cell
+					if (hasPrevious) {
+						const glm::ivec3 delta = glm::abs(cell - previousCell);
+						if (std::max(delta.x, std::max(delta.y, delta.z)) <= reach) continue;
+					}
+
+					if (!loadCell(cell, cache, corners)) continue;
+					sweepCellBox(sweep, corners, glm::vec3(cell), 1.0f, 0);
+				}
+			}
+		}
+
+		hasPrevious = true;
+		previousCell = walk.cell;
+
+		const int axis = getNextAxis(walk.tMax);
+		walk.t = walk.tMax[axis];
+		walk.cell[axis] += walk.step[axis];
+		walk.tMax[axis] += walk.tDelta[axis];
+	}
+
+	if (!sweep.hit) return MISS;
+
+	VoxelHit hit;
+	hit.distance = sweep.best;
+	hit.position = ray.origin + ray.direction * sweep.best;
+
+	const glm::vec3 away = hit.position - glm::clamp(hit.position, sweep.contactBoxMin, sweep.contactBoxMax);
+	const float awayLength = glm::length(away);
+	hit.normal = awayLength > 1e-6f ? away * (1.0f / awayLength) : ray.direction * -1.0f;
+	return hit;
+}
+
+void VoxelQueries::sphereSweep(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, const float radius, WorkerPool* workerPool) const {
+	const unsigned int tasks = (count + SWEEPS_PER_TASK - 1) / SWEEPS_PER_TASK;
+	workerPool->parallelFor(tasks, [this, rays, hits, count, radius](const unsigned int task) {
+		const unsigned int first = task * SWEEPS_PER_TASK;
+		const unsigned int end = std::min(first + SWEEPS_PER_TASK, count);
+		for (unsigned int i = first; i < end; i++) {
+			hits[i] = sphereSweep(rays[i], radius);
+		}
+	});
+}
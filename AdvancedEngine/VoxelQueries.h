@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "WorkerPool.h"
+#include "VoxelBuffer.h"
+
+struct VoxelRay {
+	glm::vec3 origin;
+	glm::vec3 direction; // Normalized
+	float maxDistance;
+};
+
+struct VoxelHit {
+	float distance; // Along the ray, negative when nothing was hit
+	glm::vec3 position; // On the surface for raycasts, the sphere's center for sweeps
+	glm::vec3 normal; // Towards the air
+
+	bool isHit() const { return distance >= 0.0f; }
+};
+
+/*
+Raycasts and sphere sweeps straight against chunk densities, no physics bodies involved.
+
+The densities are trilinearly interpolated between samples, and the surface is where that field crosses
+the iso level. Rays walk the cells with a 3D DDA, skip the cells whose corners are all air, and solve
+the field along the ray in the others, which is a cubic. Sweeps walk the same way and test the sphere
+against the solid part of the cells around it, subdividing partly solid cells down to SWEEP_TOLERANCE.
+A ray or sweep starting inside the terrain hits at distance 0.
+
+Batches of rays go 8 at a time with AVX2, and can be split across the workers. Every ray gets the same
+result whichever way it was cast. Chunks that weren't added are air. Queries may run on any number of
+threads, but not during setChunk().
+*/
+class VoxelQueries {
+public:
+	VoxelQueries(const float isoLevel);
+
+	void setChunk(const glm::ivec3& chunkPosition, const std::shared_ptr<const VoxelBuffer>& voxels); // Shared, nullptr removes the chunk
+
+	VoxelHit raycast(const VoxelRay& ray) const;
+	void raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const; // On the calling thread
+	void raycast(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, WorkerPool* workerPool) const;
+
+	VoxelHit sphereSweep(const VoxelRay& ray, const float radius) const;
+	void sphereSweep(const VoxelRay* rays, VoxelHit* hits, const unsigned int count, const float radius, WorkerPool* workerPool) const;
+
+	unsigned int getChunkCount() const;
+
+	float isoLevel;
+
+	static const float SWEEP_TOLERANCE; // Sweeps may stop up to this much before touching the surface
+
+private:
+	// The chunk of the last cell loaded, consecutive cells of a ray are mostly in the same one
+	struct ChunkCache {
+		uint64_t key;
+		const float* densities;
+	};
+
+	bool loadCell(const glm::ivec3& cell, ChunkCache& cache, float* corners) const; // False when the chunk isn't there
+	bool hitCell(const VoxelRay& ray, const glm::ivec3& cell, const float* corners, const float tEnter, const float tExit, VoxelHit& hit) const;
+	void raycastPacket(const VoxelRay* rays, VoxelHit* hits, const unsigned int count) const; // Up to 8 rays
+
+	std::unordered_map<uint64_t, std::shared_ptr<const VoxelBuffer>> chunks; // By packed chunk position
+};
@@ -23,7 +23,7 @@ void frameback_size_callback(GLFWwindow* window, int width, int height) {
 
 // Class
 
-Window::Window(const WindowConfig& config) : window(nullptr) {
+Window::Window(const WindowConfig& config) : window(nullptr), headless(config.headless) {
 
 	windowWidth = config.width;
 	windowHeight = config.height;
@@ -58,6 +58,10 @@ void Window::initializeWindow(const WindowConfig& config) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, config.GLmajorVersion);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, config.GLminorVersion);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if (config.headless) {
+		// Still needs a window for the context, it's just never shown
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 
 
 	// Create the window
@@ -101,6 +105,10 @@ int Window::getKeyPressed(int key) {
 	return glfwGetKey(window, key);
 }
 
+int Window::getMouseButtonPressed(int button) {
+	return glfwGetMouseButton(window, button);
+}
+
 void Window::setWindowTitle(const char* title) {
 	glfwSetWindowTitle(window, title);
 }
\ No newline at end of file
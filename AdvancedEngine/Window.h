@@ -11,6 +11,7 @@ struct WindowConfig {
 	const char* title;
 	unsigned int GLmajorVersion;
 	unsigned int GLminorVersion;
+	bool headless = false; // No visible window, render to an offscreen framebuffer. A hidden GLFW window still provides the context
 };
 
 class Window {
@@ -31,10 +32,12 @@ public:
 	std::function<void()> onResize;
 
 	int getKeyPressed(int key);
+	int getMouseButtonPressed(int button);
 
 	void setWindowTitle(const char* title);
 
 	GLFWwindow* window;
+	bool headless;
 
 private:
 
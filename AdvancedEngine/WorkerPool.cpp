@@ -0,0 +1,97 @@
+#include "WorkerPool.h"
+#include "Profiler.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(const unsigned int threadCount) : stopping(false) {
+	const unsigned int count = std::max(1u, threadCount);
+	threads.reserve(count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		threads.emplace_back(&WorkerPool::workerLoop, this, i);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push(std::move(task));
+	}
+	condition.notify_one();
+}
+
+void WorkerPool::parallelFor(const unsigned int count, const std::function<void(unsigned int)>& task) {
+	if (count == 0) return;
+
+	// Shared with helper tasks that may only start after this call returned
+	struct ParallelForState {
+		std::function<void(unsigned int)> task;
+		unsigned int count;
+		std::atomic<unsigned int> nextIndex;
+		std::atomic<unsigned int> finished;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+	state->task = task;
+	state->count = count;
+	state->nextIndex = 0;
+	state->finished = 0;
+
+	auto runIndices = [](ParallelForState& state) {
+		while (true) {
+			const unsigned int index = state.nextIndex.fetch_add(1);
+			if (index >= state.count) return;
+
+			state.task(index);
+
+			if (state.finished.fetch_add(1) + 1 == state.count) {
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.condition.notify_all();
+			}
+		}
+	};
+
+	const unsigned int helpers = std::min(count - 1, static_cast<unsigned int>(threads.size()));
+	for (unsigned int i = 0; i < helpers; i++) {
+		submit([state, runIndices]() { runIndices(*state); });
+	}
+
+	runIndices(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->condition.wait(lock, [&state] { return state->finished.load() == state->count; });
+}
+
+unsigned int WorkerPool::getThreadCount() const {
+	return threads.size();
+}
+
+void WorkerPool::workerLoop(const unsigned int index) {
+	Profiler::setThreadName("Worker " + std::to_string(index));
+
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (stopping) return;
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+A fixed set of threads running queued tasks in submission order.
+Tasks must not touch OpenGL, the context only lives on the main thread.
+Destroying the pool drops the tasks that haven't started and waits for the running ones.
+*/
+class WorkerPool {
+public:
+	WorkerPool(const unsigned int threadCount);
+	~WorkerPool();
+
+	void submit(std::function<void()> task);
+
+	// Runs task(0) .. task(count - 1) on the workers and the calling thread, returns once all of them are done.
+	// The caller takes part, so it finishes even while the workers are busy with long tasks.
+	void parallelFor(const unsigned int count, const std::function<void(unsigned int)>& task);
+
+	unsigned int getThreadCount() const;
+
+private:
+	void workerLoop(const unsigned int index);
+
+	std::vector<std::thread> threads;
+	std::queue<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+};
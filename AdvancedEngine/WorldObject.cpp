@@ -29,9 +29,7 @@ void WorldObject::render() {
 
 	//mesh->prepareUniforms(camera);
 
-	int modelMatrixLoc = mesh->material->getUniformLocation("uModelMatrix");
-
-	glUniformMatrix4fv(modelMatrixLoc, 1, GL_FALSE, glm::value_ptr(modelMatrix));
+	glUniformMatrix4fv(mesh->material->modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 
 	mesh->render();
 }
\ No newline at end of file
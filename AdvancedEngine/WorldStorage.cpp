@@ -0,0 +1,164 @@
+#include "WorldStorage.h"
+#include "Profiler.h"
+#include "Settings.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+// Saves wait this long for more saves of the same chunks before they are written
+const std::chrono::milliseconds WRITE_DELAY(1000);
+
+// Floor division, chunk -1 is in region -1 and not region 0
+static int floorDivide(const int value, const int divisor) {
+	return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+
+static glm::ivec3 getRegionPosition(const glm::ivec3& chunkPosition) {
+	return glm::ivec3(floorDivide(chunkPosition.x, REGION_SIZE), floorDivide(chunkPosition.y, REGION_SIZE), floorDivide(chunkPosition.z, REGION_SIZE));
+}
+
+static unsigned int getChunkIndex(const glm::ivec3& chunkPosition, const glm::ivec3& regionPosition) {
+	return RegionFile::getChunkIndex(chunkPosition - regionPosition * static_cast<int>(REGION_SIZE));
+}
+
+WorldStorage::WorldStorage(const std::string& directory) : chunksLoaded(0), chunksSaved(0), bytesSaved(0), directory(directory), writing(false), flushRequests(0), stopping(false) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) {
+		std::cout << "Could not create the world directory " << directory << ": " << error.message() << std::endl;
+	}
+
+	writerThread = std::thread(&WorldStorage::writerLoop, this);
+}
+
+WorldStorage::~WorldStorage() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+	writerThread.join();
+
+	for (const auto& [key, region] : regions) {
+		delete region;
+	}
+}
+
+RegionFile* WorldStorage::getRegion(const glm::ivec3& regionPosition) {
+	std::lock_guard<std::mutex> lock(regionsMutex);
+
+	const uint64_t key = packChunkPosition(regionPosition);
+	const auto found = regions.find(key);
+	if (found != regions.end()) return found->second;
+
+	char fileName[64];
+	std::snprintf(fileName, sizeof(fileName), "r.%d.%d.%d.region", regionPosition.x, regionPosition.y, regionPosition.z);
+
+	RegionFile* region = new RegionFile((std::filesystem::path(directory) / fileName).string());
+	regions[key] = region;
+	return region;
+}
+
+bool WorldStorage::loadChunk(const glm::ivec3& chunkPosition, TerrainDelta& delta) {
+	PROFILE_ZONE("Load chunk edits");
+
+	std::vector<unsigned char> payload;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		const uint64_t key = packChunkPosition(chunkPosition);
+		const auto queued = queue.find(key);
+		const auto written = batch.find(key);
+		if (queued != queue.end()) {
+			payload = queued->second.payload;
+		}
+		else if (written != batch.end()) {
+			payload = written->second.payload;
+		}
+	}
+
+	if (payload.empty()) {
+		const glm::ivec3 regionPosition = getRegionPosition(chunkPosition);
+		if (!getRegion(regionPosition)->readChunk(getChunkIndex(chunkPosition, regionPosition), payload)) return false;
+	}
+
+	if (!delta.deserialize(payload.data(), payload.size())) {
+		std::cout << "Edits of chunk " << chunkPosition.x << ", " << chunkPosition.y << ", " << chunkPosition.z << " are corrupt and were dropped" << std::endl;
+		return false;
+	}
+
+	chunksLoaded++;
+	return true;
+}
+
+void WorldStorage::saveChunk(const glm::ivec3& chunkPosition, const TerrainDelta& delta) {
+	std::vector<unsigned char> payload;
+	{
+		PROFILE_ZONE("Serialize chunk edits");
+		payload = delta.serialize();
+	}
+	if (payload.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue[packChunkPosition(chunkPosition)] = { chunkPosition, std::move(payload) };
+	}
+	queueCondition.notify_one();
+}
+
+void WorldStorage::flush() {
+	std::unique_lock<std::mutex> lock(queueMutex);
+	flushRequests++;
+	queueCondition.notify_one();
+	flushedCondition.wait(lock, [this] { return queue.empty() && !writing; });
+	flushRequests--;
+}
+
+void WorldStorage::writerLoop() {
+	Profiler::setThreadName("World storage");
+
+	std::vector<RegionFile*> touchedRegions;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return !queue.empty() || stopping; });
+			if (queue.empty()) return; // Stopping with nothing left to write
+
+			queueCondition.wait_for(lock, WRITE_DELAY, [this] { return stopping || flushRequests > 0; });
+
+			// Everything queued so far is one batch, each touched region is flushed once
+			batch.swap(queue);
+			writing = true;
+		}
+
+		{
+			PROFILE_ZONE("Write chunks");
+
+			for (const auto& [key, chunk] : batch) {
+				const glm::ivec3 regionPosition = getRegionPosition(chunk.chunkPosition);
+				RegionFile* region = getRegion(regionPosition);
+				if (!region->appendChunk(getChunkIndex(chunk.chunkPosition, regionPosition), chunk.payload)) continue;
+
+				chunksSaved++;
+				bytesSaved += chunk.payload.size();
+				if (std::find(touchedRegions.begin(), touchedRegions.end(), region) == touchedRegions.end()) {
+					touchedRegions.push_back(region);
+				}
+			}
+
+			for (RegionFile* region : touchedRegions) {
+				region->commit();
+			}
+		}
+		touchedRegions.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			batch.clear();
+			writing = false;
+		}
+		flushedCondition.notify_all();
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "RegionFile.h"
+#include "TerrainDelta.h"
+
+/*
+Saved terrain edits, one RegionFile per 16x16x16 chunks in a directory.
+
+loadChunk() and saveChunk() are safe on any thread. Saving serializes on the calling thread and
+queues the payload; a background thread appends the queue to the region files in batches. A batch
+waits a moment before it is written so a chunk saved every frame while the player digs is written
+once, and loadChunk() also returns what is still queued.
+*/
+class WorldStorage {
+public:
+	WorldStorage(const std::string& directory);
+	~WorldStorage(); // Writes everything still queued
+
+	bool loadChunk(const glm::ivec3& chunkPosition, TerrainDelta& delta); // False when the chunk was never edited
+	void saveChunk(const glm::ivec3& chunkPosition, const TerrainDelta& delta);
+	void flush(); // Writes the queue now and blocks until it is done
+
+	std::atomic<unsigned int> chunksLoaded;
+	std::atomic<unsigned int> chunksSaved;
+	std::atomic<uint64_t> bytesSaved; // Compressed
+
+private:
+	struct PendingChunk {
+		glm::ivec3 chunkPosition;
+		std::vector<unsigned char> payload;
+	};
+
+	RegionFile* getRegion(const glm::ivec3& regionPosition);
+	void writerLoop();
+
+	std::string directory;
+
+	std::mutex regionsMutex;
+	std::unordered_map<uint64_t, RegionFile*> regions;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::condition_variable flushedCondition;
+	std::unordered_map<uint64_t, PendingChunk> queue; // By packed chunk position, a newer save replaces the queued one
+	std::unordered_map<uint64_t, PendingChunk> batch; // Being written, still readable until its region files are committed
+	bool writing;
+	unsigned int flushRequests;
+	bool stopping;
+	std::thread writerThread;
+};